@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "baseline.h"
+#include "main.h"
+#include "../common.h"
+
+#define RESULT_FILE_MAGIC "# nperf result 1"
+
+/* Result file is a short text file with "key value" lines: test parameters
+ * followed by one "result" line per iteration.
+ */
+int baseline_save(const char *path, const struct client_config *config,
+		  const double *results, unsigned int n)
+{
+	unsigned int i;
+	FILE *f;
+	int ret;
+
+	f = fopen(path, "w");
+	if (!f) {
+		ret = -errno;
+		perror("failed to create result file");
+		return ret;
+	}
+	fprintf(f, "%s\n", RESULT_FILE_MAGIC);
+	fprintf(f, "test %s\n", test_mode_names[config->test_mode]);
+	fprintf(f, "msg_size %u\n", config->msg_size);
+	if (config->resp_size)
+		fprintf(f, "resp_size %u\n", config->resp_size);
+	fprintf(f, "threads %u\n", config->n_threads);
+	fprintf(f, "test_length %u\n", config->test_length);
+	for (i = 0; i < n; i++)
+		fprintf(f, "result %.15g\n", results[i]);
+
+	ret = ferror(f) ? -EIO : 0;
+	if (fclose(f) && !ret)
+		ret = -errno;
+	if (ret < 0)
+		fprintf(stderr, "failed to write result file '%s'\n", path);
+	return ret;
+}
+
+int baseline_load(const char *path, struct baseline *base)
+{
+	char line[256], key[32];
+	unsigned int lineno = 0;
+	char value[32];
+	FILE *f;
+	int ret = 0;
+
+	memset(base, '\0', sizeof(*base));
+	f = fopen(path, "r");
+	if (!f) {
+		ret = -errno;
+		perror("failed to open baseline file");
+		return ret;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		if (lineno == 1 && strncmp(line, RESULT_FILE_MAGIC,
+					   strlen(RESULT_FILE_MAGIC))) {
+			fprintf(stderr, "'%s' is not an nperf result file\n",
+				path);
+			ret = -EINVAL;
+			break;
+		}
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%31s %31s", key, value) != 2) {
+			ret = -EINVAL;
+			break;
+		}
+		if (!strcmp(key, "test")) {
+			snprintf(base->test, sizeof(base->test), "%s", value);
+		} else if (!strcmp(key, "msg_size")) {
+			base->msg_size = strtoul(value, NULL, 10);
+		} else if (!strcmp(key, "resp_size")) {
+			base->resp_size = strtoul(value, NULL, 10);
+		} else if (!strcmp(key, "threads")) {
+			base->n_threads = strtoul(value, NULL, 10);
+		} else if (!strcmp(key, "test_length")) {
+			base->test_length = strtoul(value, NULL, 10);
+		} else if (!strcmp(key, "result")) {
+			double result = strtod(value, NULL);
+
+			base->n++;
+			base->sum += result;
+			base->sum_sqr += result * result;
+		}
+		/* unknown keys are ignored */
+	}
+	fclose(f);
+	if (!ret && !base->n) {
+		fprintf(stderr, "no results in baseline file '%s'\n", path);
+		ret = -EINVAL;
+	}
+	if (ret == -EINVAL && lineno > 1)
+		fprintf(stderr, "invalid baseline file '%s' (line %u)\n", path,
+			lineno);
+	return ret;
+}
+
+/* comparison still makes sense sometimes, only warn */
+void baseline_check_config(const struct baseline *base,
+			   const struct client_config *config)
+{
+	if (strcmp(base->test, test_mode_names[config->test_mode]) ||
+	    base->msg_size != config->msg_size ||
+	    base->resp_size != config->resp_size ||
+	    base->n_threads != config->n_threads ||
+	    base->test_length != config->test_length)
+		fprintf(stderr,
+			"warning: baseline test parameters differ (%s, message size %u, threads %u, length %u)\n",
+			base->test, base->msg_size, base->n_threads,
+			base->test_length);
+}
+
+void baseline_compare(const struct baseline *base, double sum,
+		      double sum_sqr, unsigned int n,
+		      enum confid_level level, struct baseline_cmp *cmp)
+{
+	memset(cmp, '\0', sizeof(*cmp));
+	cmp->base_avg = base->sum / base->n;
+	cmp->cur_avg = sum / n;
+	cmp->change = cmp->base_avg ? cmp->cur_avg / cmp->base_avg - 1 : 0;
+	cmp->status = welch_test(sum, sum_sqr, n, base->sum, base->sum_sqr,
+				 base->n, level, &cmp->welch);
+}
+
+/* both throughput and transaction rate are "higher is better" */
+const char *baseline_verdict(const struct baseline_cmp *cmp)
+{
+	if (cmp->status < 0)
+		return "not enough iterations";
+	switch (cmp->welch.sign) {
+	case 1:
+		return "faster";
+	case -1:
+		return "slower";
+	default:
+		return "no significant change";
+	}
+}
+
+void baseline_print(const struct baseline *base,
+		    const struct baseline_cmp *cmp,
+		    const struct client_config *config)
+{
+	fputs("baseline ", stdout);
+	print_rate(cmp->base_avg, &config->print_opts);
+	printf(" (%u iterations), current ", base->n);
+	print_rate(cmp->cur_avg, &config->print_opts);
+	printf(", change %+.1lf%%\n", 100.0 * cmp->change);
+	if (cmp->status < 0)
+		printf("result: %s (Welch's t-test needs at least 2 iterations in both runs)\n",
+		       baseline_verdict(cmp));
+	else
+		printf("result: %s at %u%% (t = %.3lf, critical %.3lf, df %.1lf)\n",
+		       baseline_verdict(cmp),
+		       confid_level_output(config->confid_level),
+		       cmp->welch.t, cmp->welch.crit, cmp->welch.dof);
+}
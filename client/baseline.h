@@ -0,0 +1,42 @@
+#ifndef __NPERF_CLIENT_BASELINE_H
+#define __NPERF_CLIENT_BASELINE_H
+
+#include "../estimate.h"
+
+struct client_config;
+
+/* results of an earlier run loaded from a result file */
+struct baseline {
+	char		test[32];
+	unsigned int	msg_size;
+	unsigned int	resp_size;	/* 0 = msg_size */
+	unsigned int	n_threads;
+	unsigned int	test_length;
+	unsigned int	n;
+	double		sum;
+	double		sum_sqr;
+};
+
+struct baseline_cmp {
+	double			base_avg;
+	double			cur_avg;
+	double			change;		/* relative */
+	struct welch_result	welch;
+	int			status;		/* 0 or -EINVAL if not enough
+						 * iterations to test */
+};
+
+int baseline_save(const char *path, const struct client_config *config,
+		  const double *results, unsigned int n);
+int baseline_load(const char *path, struct baseline *base);
+void baseline_check_config(const struct baseline *base,
+			   const struct client_config *config);
+void baseline_compare(const struct baseline *base, double sum,
+		      double sum_sqr, unsigned int n,
+		      enum confid_level level, struct baseline_cmp *cmp);
+const char *baseline_verdict(const struct baseline_cmp *cmp);
+void baseline_print(const struct baseline *base,
+		    const struct baseline_cmp *cmp,
+		    const struct client_config *config);
+
+#endif /* __NPERF_CLIENT_BASELINE_H */
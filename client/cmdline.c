@@ -4,13 +4,20 @@
 #include <errno.h>
 #include <getopt.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
 
 #include "cmdline.h"
 #include "main.h"
+#include "coord.h"
 #include "../common.h"
+#include "../verify.h"
 
 #define MAX_THREADS	16384
 #define MAX_ITERATIONS	INT_MAX
+#define DEFAULT_SLO_PCT 99.0
+#define DEFAULT_CONVERGE_INTERVAL 200	/* ms */
 
 enum verb_level {
 	VERB_RESULT,
@@ -41,17 +48,42 @@ static const char * verb_level_names[] = {
 enum {
 	LOPT_EXACT = UCHAR_MAX + 1,
 	LOPT_BINARY,
+	LOPT_ACCEPT_THREADS,
+	LOPT_CPU_STEERING,
+	LOPT_CONNECT_CONCURRENCY,
+	LOPT_CONNECT_RETRIES,
+	LOPT_PERF_COUNTERS,
+	LOPT_TCP_INFO,
+	LOPT_SAVE,
+	LOPT_BASELINE,
+	LOPT_CONVERGE,
+	LOPT_ROBUST,
+	LOPT_LATENCY,
+	LOPT_SLO,
+	LOPT_RESP_SIZE,
+	LOPT_MSG_DIST,
+	LOPT_VERIFY,
+	LOPT_SERVICE,
+	LOPT_RATE,
+	LOPT_PACING,
+	LOPT_CC,
+	LOPT_SERVER_CC,
+	LOPT_COORDINATOR,
+	LOPT_COORDINATE,
 };
 
-const char *opts = "hH:i:I:l:m:M:p:s:S:t:nv:";
+const char *opts = "hcH:i:I:j:l:m:M:O:p:s:S:t:nv:";
 const struct option long_opts[] = {
 	{ .name = "help",				.val = 'h' },
+	{ .name = "cpu",				.val = 'c' },
 	{ .name = "host",		.has_arg = 1,	.val = 'H' },
 	{ .name = "iterate",		.has_arg = 1,	.val = 'i' },
 	{ .name = "confidence",		.has_arg = 1,	.val = 'I' },
+	{ .name = "json",		.has_arg = 1,	.val = 'j' },
 	{ .name = "seconds",		.has_arg = 1,	.val = 'l' },
 	{ .name = "msg-size",		.has_arg = 1,	.val = 'm' },
 	{ .name = "threads",		.has_arg = 1,	.val = 'M' },
+	{ .name = "sockopt",		.has_arg = 1,	.val = 'O' },
 	{ .name = "port",		.has_arg = 1,	.val = 'p' },
 	{ .name = "rcvbuf-size",	.has_arg = 1,	.val = 's' },
 	{ .name = "sndbuf-size",	.has_arg = 1,	.val = 'S' },
@@ -60,6 +92,28 @@ const struct option long_opts[] = {
 	{ .name = "verbose",		.has_arg = 1,	.val = 'v' },
 	{ .name = "binary",				.val = LOPT_BINARY },
 	{ .name = "exact",				.val = LOPT_EXACT },
+	{ .name = "accept-threads",	.has_arg = 1,	.val = LOPT_ACCEPT_THREADS },
+	{ .name = "cpu-steering",			.val = LOPT_CPU_STEERING },
+	{ .name = "connect-concurrency", .has_arg = 1,	.val = LOPT_CONNECT_CONCURRENCY },
+	{ .name = "connect-retries",	.has_arg = 1,	.val = LOPT_CONNECT_RETRIES },
+	{ .name = "perf-counters",			.val = LOPT_PERF_COUNTERS },
+	{ .name = "tcp-info",		.has_arg = 1,	.val = LOPT_TCP_INFO },
+	{ .name = "save",		.has_arg = 1,	.val = LOPT_SAVE },
+	{ .name = "baseline",		.has_arg = 1,	.val = LOPT_BASELINE },
+	{ .name = "converge",		.has_arg = 1,	.val = LOPT_CONVERGE },
+	{ .name = "robust",				.val = LOPT_ROBUST },
+	{ .name = "latency",				.val = LOPT_LATENCY },
+	{ .name = "slo",		.has_arg = 1,	.val = LOPT_SLO },
+	{ .name = "resp-size",		.has_arg = 1,	.val = LOPT_RESP_SIZE },
+	{ .name = "msg-dist",		.has_arg = 1,	.val = LOPT_MSG_DIST },
+	{ .name = "verify",				.val = LOPT_VERIFY },
+	{ .name = "service",		.has_arg = 1,	.val = LOPT_SERVICE },
+	{ .name = "rate",		.has_arg = 1,	.val = LOPT_RATE },
+	{ .name = "pacing",		.has_arg = 1,	.val = LOPT_PACING },
+	{ .name = "cc",			.has_arg = 1,	.val = LOPT_CC },
+	{ .name = "server-cc",		.has_arg = 1,	.val = LOPT_SERVER_CC },
+	{ .name = "coordinator",	.has_arg = 1,	.val = LOPT_COORDINATOR },
+	{ .name = "coordinate",		.has_arg = 1,	.val = LOPT_COORDINATE },
 	{}
 };
 
@@ -78,21 +132,43 @@ static const char *help_text = "\n"
 "Options:\n"
 "  -h,--help\n"
 "      Display this help text.\n"
-"  -H,--host <host>\n"
-"      Server to run test against (hostname, IPv4 or IPv6 address).\n"
+"  -c,--cpu\n"
+"      Show CPU utilization of client and server (system wide and per\n"
+"      thread) and service demand, i.e. CPU time in microseconds per KB\n"
+"      (TCP_STREAM) or per transaction (TCP_RR).\n"
+"  -H,--host <host>[,<host>...]\n"
+"      Server to run test against (hostname, IPv4 or IPv6 address). With\n"
+"      several servers (comma separated or repeated option), threads are\n"
+"      spread over them round robin, all connections start and stop at\n"
+"      the same time and per server results are shown with the aggregate.\n"
+"      Server side counters (CPU, network) are summed over all servers.\n"
 "  -i,--iterate <num>[,<num>]\n"
 "      Number of test iterations (default 1). If two values are provided,\n"
 "      they are minimum and maximum number of iterations to achieve the\n"
 "      confidence interval width (see -I option).\n"
 "  -I,--confidence <num>[,<float>]\n"
-"      Confidence level for displayed confidence intervals (default 95%).\n"
+"      Confidence level for displayed confidence intervals (default 95%,\n"
+"      only 95 and 99 are supported unless --robust is used).\n"
 "      Optional second argument is confidence interval width (default 10%).\n"
+"  -j,--json <file>\n"
+"      Write configuration and results of all iterations, including per\n"
+"      thread counters of both sides, in JSON format to <file> as they\n"
+"      are collected. If <file> is \"-\", JSON is written to standard\n"
+"      output instead of the text output. Kernel network counters are\n"
+"      only included if requested by -v (bit 64).\n"
 "  -l,--seconds <num>\n"
-"      Length of one iteration in seconds.\n"
+"      Length of one iteration in seconds (maximum with --converge).\n"
 "  -m,--msg-size <size>\n"
 "      Message length in bytes (default depends on test).\n"
 "  -M,--threads <num>\n"
 "      Number of threads (parallel connections) to open (default 1).\n"
+"  -O,--sockopt [client:|server:]<level>:<option>=<value>\n"
+"      Set an integer socket option on data sockets of the client and/or\n"
+"      the server (both by default), can be repeated. Level is socket, tcp,\n"
+"      ip, ipv6 or a number, option a name (e.g. TCP_NOTSENT_LOWAT,\n"
+"      SO_PRIORITY, IP_TOS) or a number. Server sets options after accept.\n"
+"      Effective values read back with getsockopt() on the first\n"
+"      connection are shown.\n"
 "  -p,--port <port>\n"
 "      Server port to connect to (default 12543).\n"
 "  -s,--rcvbuf-size <size>\n"
@@ -111,6 +187,113 @@ static const char *help_text = "\n"
 "      Power of 2 multiples for human readable output (default power of 10)\n"
 "  --exact  \n"
 "      Show unsimplified (exact) values in results (default human readable)\n"
+"  --accept-threads <num>\n"
+"      Number of server accept threads, each with its own SO_REUSEPORT\n"
+"      listener (default 1, 0 means one per server CPU).\n"
+"  --cpu-steering\n"
+"      Use one server accept thread per CPU and steer each connection to\n"
+"      the thread bound to the CPU which received it (implies\n"
+"      --accept-threads 0).\n"
+"  --connect-concurrency <num>\n"
+"      Maximum number of connection attempts in progress at the same time\n"
+"      (default 0, i.e. no limit).\n"
+"  --connect-retries <num>\n"
+"      Number of retries (with exponential backoff) of a failed connection\n"
+"      attempt (default 3).\n"
+"  --perf-counters\n"
+"      Count CPU cycles, instructions, cache misses, context switches, CPU\n"
+"      migrations and task clock of each client and server worker thread\n"
+"      (perf_event_open), show them and their values per KB or transaction.\n"
+"      Counters not available (e.g. hardware ones in a VM) are omitted.\n"
+"  --tcp-info <ms>\n"
+"      Sample TCP_INFO (srtt, cwnd, retransmits, pacing and delivery rate)\n"
+"      of all test connections on both sides every <ms> milliseconds and\n"
+"      at the end of the test, show final values and sample averages\n"
+"      (0 means final sample only).\n"
+"  --converge <pct>[,<ms>]\n"
+"      End each iteration as soon as the confidence interval (at level\n"
+"      of -I) of throughput measured over <ms> long intervals (default\n"
+"      200) is within +/- <pct> percent of its mean. The first intervals\n"
+"      are ignored and at least 10 are needed, -l is the maximum length.\n"
+"  --robust\n"
+"      Show median, median absolute deviation and bootstrap confidence\n"
+"      interval of the median of iteration results and flag outlier\n"
+"      iterations (modified z-score above 3.5). The confidence target\n"
+"      (-I) then applies to the bootstrap interval which allows any\n"
+"      confidence level, not only 95 and 99. The bootstrap interval is\n"
+"      too narrow with few samples, so the t interval (at 95 or 99) is\n"
+"      used for the target until 10 iterations are done.\n"
+"  --msg-dist <dist>\n"
+"      Draw size of each message (request in TCP_RR) from a distribution:\n"
+"        uniform:<min>-<max>          uniform between <min> and <max>\n"
+"        exp:<mean>[,<max>]           exponential, optionally truncated\n"
+"        bimodal:<size1>,<size2>,<pct> <size1> with probability <pct>%,\n"
+"                                     <size2> otherwise\n"
+"        cdf:<file>                   empirical, lines \"<size> <cum. prob.>\"\n"
+"      Both ends generate the same sequence of sizes from a shared seed,\n"
+"      mean message size is shown with the result.\n"
+"  --rate <size>[,total]\n"
+"      Limit TCP_STREAM send rate to <size> bytes per second per connection\n"
+"      or, with \",total\", in aggregate (split evenly between connections).\n"
+"      Achieved rate (total and slowest/fastest connection relative to the\n"
+"      target) and mean and standard deviation (jitter) of the interval\n"
+"      between sends are shown.\n"
+"  --pacing user|kernel\n"
+"      Enforce --rate by a token bucket in client worker threads (user,\n"
+"      default) or by the kernel (SO_MAX_PACING_RATE socket option).\n"
+"  --cc <algo>[,<algo>...]\n"
+"      Set TCP congestion control algorithm (TCP_CONGESTION) of client\n"
+"      sockets. With more entries, threads are assigned to them round robin\n"
+"      (e.g. \"cubic,bbr\" or \"cubic,bbr,bbr\" for a 1:2 ratio) and the\n"
+"      throughput of each algorithm and its share of the total is shown.\n"
+"      A single algorithm is also used by the server unless --server-cc\n"
+"      is given.\n"
+"  --server-cc <algo>\n"
+"      Set congestion control algorithm of server sockets (matters for\n"
+"      TCP_RR replies).\n"
+"  --service <type>:<arg>\n"
+"      Emulate server processing of each TCP_RR request before replying:\n"
+"        spin:<us>              busy loop for <us> microseconds\n"
+"        exp:<us>               busy loop, exponentially distributed time\n"
+"        uniform:<min>-<max>    busy loop, uniformly distributed time\n"
+"        touch:<size>           write one byte per cache line of a <size>\n"
+"                               bytes long per thread buffer\n"
+"      Requested and achieved (measured by server) service time is shown.\n"
+"  --verify\n"
+"      Fill messages with a pseudorandom pattern, put a sequence number and\n"
+"      CRC32C (SSE4.2 accelerated where available) into each message and\n"
+"      check them on receive. Mismatches are counted per thread, time spent\n"
+"      checksumming is shown as a share of worker time (i.e. throughput\n"
+"      cost). Messages shorter than 12 bytes are not verified.\n"
+"  --resp-size <size>\n"
+"      Size of server replies in TCP_RR test (default: same as -m).\n"
+"  --latency\n"
+"      Measure latency of each transaction (TCP_RR only) and show its\n"
+"      distribution over all iterations.\n"
+"  --slo <us>[,<pct>]\n"
+"      Search for the highest load (number of threads, at most -M) at\n"
+"      which <pct> percentile (default 99) of transaction latency is not\n"
+"      above <us> microseconds. Thread count is doubled until the target\n"
+"      is missed, then bisected; each point is tested as set by -i/-I/-l.\n"
+"      Implies --latency, TCP_RR only.\n"
+"  --save <file>\n"
+"      Save test parameters and per iteration results to <file> for use\n"
+"      as a baseline in a later run.\n"
+"  --baseline <file>\n"
+"      Compare results with a run saved with --save and report whether\n"
+"      this run is significantly faster or slower (Welch's t-test at the\n"
+"      confidence level of -I, both runs need at least 2 iterations).\n"
+"  --coordinator <clients>[,<port>]\n"
+"      Do not run a test, coordinate <clients> instances of nperf started\n"
+"      with --coordinate instead (listening on <port>, default 12544). All\n"
+"      clients are started and stopped at the same time so that they load\n"
+"      their servers over an identical window of -l seconds; the aggregate\n"
+"      result of each iteration is shown, -i/-I apply to the whole run.\n"
+"  --coordinate <host>[,<port>]\n"
+"      Run the test in lockstep with other clients, driven by the\n"
+"      coordinator on <host>. Iteration count and test length are set by\n"
+"      the coordinator; parameter sweeps, --slo and --converge are not\n"
+"      available.\n"
 "\n"
 "  Option arguments shown as <size> above accept a numeric value, optionally\n"
 "  followed by a suffix k/m/g/t/K/M/G/T. Lower case variants mean powers of\n"
@@ -121,6 +304,7 @@ static const char *help_text = "\n"
 "  TCP_STREAM  client sends data to server as fast as possible, no replies\n"
 "              default message size is 1MB\n"
 "  TCP_RR      client sends one message, server replies with one message, ...\n"
+"              (of --resp-size bytes if set)\n"
 "              default message size is 1B\n"
 "\n"
 "Verbosity mask bits:\n"
@@ -128,12 +312,25 @@ static const char *help_text = "\n"
 "  2   One line summary of each iteration.\n"
 "  4   Per thread summary of each iteration (one line per thread).\n"
 "  8   Raw counter values (Rx/Tx, messages/syscalls/bytes, client/server).\n"
+"  16  Connection establishment statistics (latency, retries).\n"
+"  32  Performance counters (with --perf-counters).\n"
+"  64  Non-zero changes of kernel network counters (/proc/net/snmp,\n"
+"      /proc/net/netstat, /proc/net/dev) on both sides.\n"
+"  128 TCP_INFO samples of test connections (with --tcp-info).\n"
+"\n"
+"Parameter sweep:\n"
+"  Options -m, -M, -s, -S and -t accept a comma separated list of values.\n"
+"  Except -t, values can also be ranges: \"a-b\" (a, 2a, 4a, ... up to b),\n"
+"  \"a-b+step\" and \"a-b*factor\". Tests are run for all combinations of\n"
+"  listed values over one control connection and a table of results is\n"
+"  shown (use -v to see the output of each test as well, -j for JSON).\n"
 "\n"
 "Verbosity levels:\n"
 "  result  Overall result only (1).\n"
 "  iter    ... + iteration summary (3).\n"
 "  thread  ... + per thread summary (7).\n"
-"  all     ... + raw counter data (15).\n"
+"  all     ... + raw counter, connection, perf, kernel counter and\n"
+"          TCP_INFO data (255).\n"
 "  raw     Raw data only (8).\n"
 "\n";
 
@@ -149,10 +346,324 @@ static int name_lookup(const char *name, const char *const names[],
 	return -ENOENT;
 }
 
+unsigned int default_msg_size(unsigned int test_mode)
+{
+	switch(test_mode) {
+	case MODE_TCP_STREAM:
+		return 1U << 20; /* 1 MB */
+	case MODE_TCP_RR:
+		return 1U;
+	default:
+		return 0;
+	}
+}
+
+static int sweep_add(const char *name, struct sweep_list *list,
+		     unsigned long val)
+{
+	if (list->n >= SWEEP_MAX_VALUES) {
+		fprintf(stderr, "too many values of %s (max %u)\n", name,
+			SWEEP_MAX_VALUES);
+		return -EINVAL;
+	}
+	list->vals[list->n++] = val;
+	return 0;
+}
+
+/* Comma separated list of values or ranges "a-b" (a, 2a, 4a, ... up to b),
+ * "a-b+step" (arithmetic) and "a-b*factor" (geometric).
+ */
+static int parse_sweep_list(const char *name, const char *str,
+			    unsigned long min_val, unsigned long max_val,
+			    struct sweep_list *list)
+{
+	char buff[1024];
+	char *item, *save;
+	int ret;
+
+	list->n = 0;
+	if (strlen(str) >= sizeof(buff)) {
+		fprintf(stderr, "list of %s too long\n", name);
+		return -EINVAL;
+	}
+	strcpy(buff, str);
+	for (item = strtok_r(buff, ",", &save); item;
+	     item = strtok_r(NULL, ",", &save)) {
+		unsigned long first, last, step = 2, val;
+		bool mult = true;
+		char *hi, *op;
+
+		hi = strchr(item, '-');
+		if (hi)
+			*hi++ = '\0';
+		ret = parse_ulong_range(name, item, &first, min_val, max_val);
+		if (ret < 0)
+			return ret;
+		if (!hi) {
+			ret = sweep_add(name, list, first);
+			if (ret < 0)
+				return ret;
+			continue;
+		}
+
+		op = strpbrk(hi, "+*");
+		if (op) {
+			mult = (*op == '*');
+			*op++ = '\0';
+			ret = parse_ulong_range("range step", op, &step,
+						mult ? 2 : 1, max_val);
+			if (ret < 0)
+				return ret;
+		}
+		ret = parse_ulong_range(name, hi, &last, first, max_val);
+		if (ret < 0)
+			return ret;
+		if (mult && !first) {
+			fprintf(stderr, "geometric range of %s cannot start at 0\n",
+				name);
+			return -EINVAL;
+		}
+		for (val = first; val <= last; ) {
+			ret = sweep_add(name, list, val);
+			if (ret < 0)
+				return ret;
+			if (mult ? (val > last / step) : (val > last - step))
+				break;
+			val = mult ? val * step : val + step;
+		}
+	}
+	if (!list->n) {
+		fprintf(stderr, "empty list of %s\n", name);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int parse_mode_list(const char *str, struct sweep_list *list)
+{
+	char buff[256];
+	char *item, *save;
+	int ret;
+
+	list->n = 0;
+	if (strlen(str) >= sizeof(buff)) {
+		fputs("list of tests too long\n", stderr);
+		return -EINVAL;
+	}
+	strcpy(buff, str);
+	for (item = strtok_r(buff, ",", &save); item;
+	     item = strtok_r(NULL, ",", &save)) {
+		ret = name_lookup(item, test_mode_names, MODE_COUNT);
+		if (ret < 0) {
+			fprintf(stderr, "invalid test '%s'\n", item);
+			return -EINVAL;
+		}
+		ret = sweep_add("tests", list, ret);
+		if (ret < 0)
+			return ret;
+	}
+	if (!list->n) {
+		fputs("empty list of tests\n", stderr);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int parse_cc_name(const char *str, size_t len, char *name)
+{
+	if (!len || len >= CC_NAME_MAX) {
+		fprintf(stderr, "invalid congestion control algorithm '%.*s'\n",
+			(int)len, str);
+		return -EINVAL;
+	}
+	memcpy(name, str, len);
+	name[len] = '\0';
+
+	return 0;
+}
+
+/* comma separated list, may be given more than once */
+static int parse_hosts(const char *spec, struct client_config *config)
+{
+	struct server_target *srv;
+	const char *p = spec;
+	size_t len;
+
+	while (true) {
+		len = strcspn(p, ",");
+		if (!len) {
+			fprintf(stderr, "invalid host list '%s'\n", spec);
+			return -EINVAL;
+		}
+		if (config->n_servers >= MAX_SERVERS) {
+			fprintf(stderr, "too many servers (max %u)\n",
+				MAX_SERVERS);
+			return -EINVAL;
+		}
+		srv = &config->servers[config->n_servers];
+		srv->host = strndup(p, len);
+		if (!srv->host)
+			return -ENOMEM;
+		config->n_servers++;
+		if (!p[len])
+			break;
+		p += len + 1;
+	}
+
+	return 0;
+}
+
+/* [client:|server:]<level>:<option>=<value>, both ends by default */
+static int parse_sockopt(const char *spec, struct client_config *config)
+{
+	struct sockopt_req *req;
+	const char *arg = spec;
+
+	if (config->n_sockopts >= SOCKOPT_MAX) {
+		fprintf(stderr, "too many socket options (max %u)\n",
+			SOCKOPT_MAX);
+		return -EINVAL;
+	}
+	req = &config->sockopts[config->n_sockopts];
+	req->spec = spec;
+	req->client = req->server = true;
+	if (!strncmp(arg, "client:", 7)) {
+		req->server = false;
+		arg += 7;
+	} else if (!strncmp(arg, "server:", 7)) {
+		req->client = false;
+		arg += 7;
+	}
+	if (sockopt_parse(arg, &req->opt) < 0)
+		return -EINVAL;
+	config->n_sockopts++;
+
+	return 0;
+}
+
+/* comma separated list of algorithms, repeated names share one group */
+static int parse_cc_list(const char *spec, struct client_config *config)
+{
+	char name[CC_NAME_MAX];
+	const char *p = spec;
+	unsigned int i;
+	size_t len;
+	int ret;
+
+	config->n_cc_groups = config->n_cc_slots = 0;
+	while (true) {
+		len = strcspn(p, ",");
+		ret = parse_cc_name(p, len, name);
+		if (ret < 0)
+			return ret;
+		if (config->n_cc_slots >= CC_MAX_SLOTS) {
+			fprintf(stderr, "too many congestion control entries (max %u)\n",
+				CC_MAX_SLOTS);
+			return -EINVAL;
+		}
+		for (i = 0; i < config->n_cc_groups; i++)
+			if (!strcmp(config->cc_groups[i].name, name))
+				break;
+		if (i == config->n_cc_groups) {
+			strcpy(config->cc_groups[i].name, name);
+			config->n_cc_groups++;
+		}
+		config->cc_slots[config->n_cc_slots++] = i;
+		if (!p[len])
+			break;
+		p += len + 1;
+	}
+	config->cc_spec = spec;
+
+	return 0;
+}
+
+/* service time in microseconds to nanoseconds sent to server */
+static int parse_service_usec(const char *name, const char *str, double *usec,
+			      char delimiter, const char **next)
+{
+	return parse_double_range_delim(name, str, usec, 0.0,
+					UINT32_MAX / 1000.0, delimiter, next);
+}
+
+/* spin:<us>, exp:<us>, uniform:<min>-<max> or touch:<size> */
+static int parse_service(const char *spec, struct client_config *config)
+{
+	const char *arg = strchr(spec, ':');
+	double usec1, usec2;
+	unsigned long size;
+	char type[16];
+	int ret;
+
+	if (!arg || arg - spec >= (int)sizeof(type))
+		goto err;
+	memcpy(type, spec, arg - spec);
+	type[arg - spec] = '\0';
+	arg++;
+	ret = name_lookup(type, service_type_names, SERVICE_COUNT);
+	if (ret <= SERVICE_NONE)
+		goto err;
+	config->service_type = ret;
+	config->service_spec = spec;
+	config->service_arg2 = 0;
+
+	switch (config->service_type) {
+	case SERVICE_SPIN:
+	case SERVICE_EXP:
+		ret = parse_service_usec("service time", arg, &usec1, '\0',
+					 NULL);
+		if (ret < 0)
+			return ret;
+		config->service_arg1 = usec1 * 1000;
+		break;
+	case SERVICE_UNIFORM:
+		ret = parse_service_usec("minimum service time", arg, &usec1,
+					 '-', &arg);
+		if (ret < 0)
+			return ret;
+		if (*arg != '-')
+			goto err;
+		ret = parse_service_usec("maximum service time", arg + 1,
+					 &usec2, '\0', NULL);
+		if (ret < 0)
+			return ret;
+		if (usec2 < usec1)
+			goto err;
+		config->service_arg1 = usec1 * 1000;
+		config->service_arg2 = usec2 * 1000;
+		break;
+	case SERVICE_TOUCH:
+		ret = parse_ulong_range("memory size", arg, &size, 1,
+					1UL << 30);
+		if (ret < 0)
+			return ret;
+		config->service_arg1 = size;
+		break;
+	}
+
+	return 0;
+err:
+	fprintf(stderr, "invalid service time '%s'\n", spec);
+	return -EINVAL;
+}
+
+/* single value lists are not a sweep, just set the parameter */
+static bool sweep_setup(const struct sweep_list *list, unsigned int *val)
+{
+	if (list->n == 1)
+		*val = list->vals[0];
+	return list->n > 1;
+}
+
 int parse_cmdline(int argc, char *argv[], struct client_config *config)
 {
 	unsigned long val, val2;
+	bool server_cc_set = false;
 	const char *arg;
+	char *comma;
+	unsigned int i;
 	double dval;
 	int ret;
 	int c;
@@ -162,8 +673,13 @@ int parse_cmdline(int argc, char *argv[], struct client_config *config)
 		case 'h':
 			fputs(help_text, stdout);
 			exit(0);
+		case 'c':
+			config->show_cpu = true;
+			break;
 		case 'H':
-			config->server_host = optarg;
+			ret = parse_hosts(optarg, config);
+			if (ret < 0)
+				return ret;
 			break;
 		case 'i':
 			ret = parse_ulong_range_delim("iterations", optarg,
@@ -187,12 +703,14 @@ int parse_cmdline(int argc, char *argv[], struct client_config *config)
 						      &val, 0, 100, ',', &arg);
 			if (ret < 0)
 				return -EINVAL;
-			ret = confid_level_input(val);
-			if (ret < 0) {
-				fprintf(stderr, "only confidence level 95 or 99 are supported\n");
+			if (val < 1 || val > 99) {
+				fprintf(stderr, "confidence level must be between 1 and 99\n");
 				return -EINVAL;
 			}
-			config->confid_level = ret;
+			config->confid_pct = val;
+			ret = confid_level_input(val);
+			if (ret >= 0)
+				config->confid_level = ret;
 			if (!*arg)
 				break;
 			ret = parse_double_range("confidence", ++arg, &dval,
@@ -202,6 +720,9 @@ int parse_cmdline(int argc, char *argv[], struct client_config *config)
 			config->confid_target = dval;
 			config->confid_target_set = true;
 			break;
+		case 'j':
+			config->json_path = optarg;
+			break;
 		case 'l':
 			ret = parse_ulong_range("test length", optarg, &val,
 						0, UINT_MAX);
@@ -210,18 +731,18 @@ int parse_cmdline(int argc, char *argv[], struct client_config *config)
 			config->test_length = val;
 			break;
 		case 'm':
-			ret = parse_ulong_range("message size", optarg, &val,
-						0, INT_MAX);
+			ret = parse_sweep_list("message size", optarg, 0,
+					       INT_MAX,
+					       &config->sweep_msg_sizes);
 			if (ret < 0)
 				return -EINVAL;
-			config->msg_size = val;
 			break;
 		case 'M':
-			ret = parse_ulong_range("thread count", optarg, &val,
-						1, MAX_THREADS);
+			ret = parse_sweep_list("thread count", optarg, 1,
+					       MAX_THREADS,
+					       &config->sweep_threads);
 			if (ret < 0)
 				return -EINVAL;
-			config->n_threads = val;
 			break;
 		case 'n':
 			config->tcp_nodelay = true;
@@ -234,26 +755,23 @@ int parse_cmdline(int argc, char *argv[], struct client_config *config)
 			config->ctrl_port = val;
 			break;
 		case 's':
-			ret = parse_ulong_range("receive buffer size", optarg,
-						&val, 0, INT_MAX);
+			ret = parse_sweep_list("receive buffer size", optarg,
+					       0, INT_MAX,
+					       &config->sweep_rcvbufs);
 			if (ret < 0)
 				return -EINVAL;
-			config->rcvbuf_size = val;
 			break;
 		case 'S':
-			ret = parse_ulong_range("send buffer size", optarg,
-						&val, 0, INT_MAX);
+			ret = parse_sweep_list("send buffer size", optarg,
+					       0, INT_MAX,
+					       &config->sweep_sndbufs);
 			if (ret < 0)
 				return -EINVAL;
-			config->sndbuf_size = val;
 			break;
 		case 't':
-			ret = name_lookup(optarg, test_mode_names, MODE_COUNT);
-			if (ret < 0) {
-				fprintf(stderr, "invalid test '%s'\n", optarg);
+			ret = parse_mode_list(optarg, &config->sweep_modes);
+			if (ret < 0)
 				return -EINVAL;
-			}
-			config->test_mode = ret;
 			break;
 		case 'v':
 			ret = name_lookup(optarg, verb_level_names, __VERB_CNT);
@@ -276,6 +794,174 @@ int parse_cmdline(int argc, char *argv[], struct client_config *config)
 		case LOPT_EXACT:
 			config->print_opts.exact = true;
 			break;
+		case LOPT_ACCEPT_THREADS:
+			ret = parse_ulong_range("accept threads", optarg, &val,
+						0, MAX_THREADS);
+			if (ret < 0)
+				return -EINVAL;
+			config->accept_threads = val;
+			break;
+		case LOPT_CPU_STEERING:
+			config->cpu_steering = true;
+			break;
+		case LOPT_CONNECT_CONCURRENCY:
+			ret = parse_ulong_range("connect concurrency", optarg,
+						&val, 0, MAX_THREADS);
+			if (ret < 0)
+				return -EINVAL;
+			config->connect_concurrency = val;
+			break;
+		case LOPT_PERF_COUNTERS:
+			config->perf_counters = true;
+			break;
+		case LOPT_TCP_INFO:
+			ret = parse_ulong_range("TCP_INFO interval", optarg,
+						&val, 0, INT_MAX);
+			if (ret < 0)
+				return -EINVAL;
+			config->tcp_info = true;
+			config->tcp_info_interval = val;
+			break;
+		case LOPT_CONVERGE:
+			ret = parse_double_range_delim("convergence", optarg,
+						       &dval, 1e-3, 100.0, ',',
+						       &arg);
+			if (ret < 0)
+				return -EINVAL;
+			config->converge = dval / 100.0;
+			config->converge_interval = DEFAULT_CONVERGE_INTERVAL;
+			if (!*arg)
+				break;
+			ret = parse_ulong_range("convergence interval", ++arg,
+						&val, 10, 60000);
+			if (ret < 0)
+				return -EINVAL;
+			config->converge_interval = val;
+			break;
+		case LOPT_ROBUST:
+			config->robust = true;
+			break;
+		case LOPT_LATENCY:
+			config->latency = true;
+			break;
+		case LOPT_RESP_SIZE:
+			ret = parse_ulong_range("response size", optarg, &val,
+						1, INT_MAX);
+			if (ret < 0)
+				return -EINVAL;
+			config->resp_size = val;
+			break;
+		case LOPT_RATE:
+			ret = parse_ulong_range_delim("rate", optarg, &val, 1,
+						      ULONG_MAX, ',', &arg);
+			if (ret < 0)
+				return -EINVAL;
+			config->pace_rate = val;
+			config->pace_total = false;
+			if (!*arg)
+				break;
+			if (strcmp(arg + 1, "total")) {
+				fprintf(stderr, "invalid rate '%s'\n", optarg);
+				return -EINVAL;
+			}
+			config->pace_total = true;
+			break;
+		case LOPT_PACING:
+			if (!strcmp(optarg, "kernel")) {
+				config->pace_kernel = true;
+			} else if (!strcmp(optarg, "user")) {
+				config->pace_kernel = false;
+			} else {
+				fprintf(stderr, "invalid pacing '%s'\n", optarg);
+				return -EINVAL;
+			}
+			break;
+		case 'O':
+			ret = parse_sockopt(optarg, config);
+			if (ret < 0)
+				return -EINVAL;
+			break;
+		case LOPT_CC:
+			ret = parse_cc_list(optarg, config);
+			if (ret < 0)
+				return -EINVAL;
+			break;
+		case LOPT_SERVER_CC:
+			ret = parse_cc_name(optarg, strlen(optarg),
+					    config->server_cc);
+			if (ret < 0)
+				return -EINVAL;
+			server_cc_set = true;
+			break;
+		case LOPT_SERVICE:
+			ret = parse_service(optarg, config);
+			if (ret < 0)
+				return -EINVAL;
+			break;
+		case LOPT_VERIFY:
+			config->verify = true;
+			break;
+		case LOPT_MSG_DIST:
+			config->msg_dist_spec = optarg;
+			break;
+		case LOPT_SLO:
+			ret = parse_double_range_delim("latency SLO", optarg,
+						       &dval, 1.0, 1e9, ',',
+						       &arg);
+			if (ret < 0)
+				return -EINVAL;
+			config->slo_usec = dval;
+			config->slo_pct = DEFAULT_SLO_PCT;
+			if (!*arg)
+				break;
+			ret = parse_double_range("SLO percentile", ++arg,
+						 &dval, 1.0, 99.9999);
+			if (ret < 0)
+				return -EINVAL;
+			config->slo_pct = dval;
+			break;
+		case LOPT_SAVE:
+			config->save_path = optarg;
+			break;
+		case LOPT_BASELINE:
+			config->baseline_path = optarg;
+			break;
+		case LOPT_COORDINATOR:
+			ret = parse_ulong_range_delim("coordinated clients",
+						      optarg, &val, 1,
+						      MAX_COORD_CLIENTS, ',',
+						      &arg);
+			if (ret < 0)
+				return -EINVAL;
+			config->coord_clients = val;
+			if (!*arg)
+				break;
+			ret = parse_ulong_range("coordinator port", ++arg,
+						&val, 1, USHRT_MAX);
+			if (ret < 0)
+				return -EINVAL;
+			config->coord_port = val;
+			break;
+		case LOPT_COORDINATE:
+			comma = strchr(optarg, ',');
+			if (comma) {
+				*comma = '\0';
+				ret = parse_ulong_range("coordinator port",
+							comma + 1, &val, 1,
+							USHRT_MAX);
+				if (ret < 0)
+					return -EINVAL;
+				config->coord_port = val;
+			}
+			config->coord_host = optarg;
+			break;
+		case LOPT_CONNECT_RETRIES:
+			ret = parse_ulong_range("connect retries", optarg,
+						&val, 0, UINT_MAX);
+			if (ret < 0)
+				return -EINVAL;
+			config->connect_retries = val;
+			break;
 		case '?':
 			fputs("\nUsage:", stdout);
 			fputs(help_text, stdout);
@@ -286,6 +972,97 @@ int parse_cmdline(int argc, char *argv[], struct client_config *config)
 		}
 	}
 
+	if (config->cpu_steering)
+		config->accept_threads = 0;
+	if (!config->n_servers) {
+		ret = parse_hosts("localhost", config);
+		if (ret < 0)
+			return ret;
+	}
+	for (i = 0; i < config->n_servers; i++)
+		config->servers[i].ctrl_sd = -1;
+
+	config->sweep |= sweep_setup(&config->sweep_modes, &config->test_mode);
+	config->sweep |= sweep_setup(&config->sweep_msg_sizes,
+				     &config->msg_size);
+	config->sweep |= sweep_setup(&config->sweep_threads,
+				     &config->n_threads);
+	config->sweep |= sweep_setup(&config->sweep_rcvbufs,
+				     &config->rcvbuf_size);
+	config->sweep |= sweep_setup(&config->sweep_sndbufs,
+				     &config->sndbuf_size);
+	if (config->n_threads < config->n_servers && !config->sweep) {
+		fprintf(stderr, "at least one thread per server is needed (%u servers)\n",
+			config->n_servers);
+		return -EINVAL;
+	}
+	if (config->sweep && (config->save_path || config->baseline_path)) {
+		fputs("--save and --baseline cannot be used with a parameter sweep\n",
+		      stderr);
+		return -EINVAL;
+	}
+	if (config->slo_usec > 0) {
+		if (config->sweep || config->save_path ||
+		    config->baseline_path) {
+			fputs("--slo cannot be used with a parameter sweep, --save or --baseline\n",
+			      stderr);
+			return -EINVAL;
+		}
+		config->latency = true;
+	}
+	if (config->coord_clients &&
+	    (config->coord_host || config->sweep || config->slo_usec > 0 ||
+	     config->save_path || config->baseline_path || config->json_path)) {
+		fputs("--coordinator cannot be used with --coordinate, a parameter sweep,\n"
+		      "--slo, --save, --baseline or -j\n", stderr);
+		return -EINVAL;
+	}
+	if (config->coord_host &&
+	    (config->sweep || config->slo_usec > 0 || config->converge > 0)) {
+		fputs("--coordinate cannot be used with a parameter sweep, --slo\n"
+		      "or --converge\n", stderr);
+		return -EINVAL;
+	}
+	if (config->msg_dist_spec) {
+		if (config->sweep_msg_sizes.n) {
+			fputs("--msg-dist cannot be combined with -m\n", stderr);
+			return -EINVAL;
+		}
+		ret = msgdist_parse(config->msg_dist_spec, &config->msg_dist);
+		if (ret < 0)
+			return -EINVAL;
+		config->msg_size = msgdist_max(&config->msg_dist);
+		config->size_seed = time(NULL) ^ getpid();
+	}
+	if (config->n_cc_groups == 1 && !server_cc_set)
+		strcpy(config->server_cc, config->cc_groups[0].name);
+	if (config->resp_size && !config->sweep &&
+	    config->test_mode != MODE_TCP_RR) {
+		fputs("response size only applies to TCP_RR test\n", stderr);
+		return -EINVAL;
+	}
+	if (config->pace_rate && !config->sweep &&
+	    config->test_mode != MODE_TCP_STREAM) {
+		fputs("rate limit only applies to TCP_STREAM test\n", stderr);
+		return -EINVAL;
+	}
+	if (config->service_type != SERVICE_NONE && !config->sweep &&
+	    config->test_mode != MODE_TCP_RR) {
+		fputs("service time emulation only applies to TCP_RR test\n",
+		      stderr);
+		return -EINVAL;
+	}
+	if (config->latency && !config->sweep &&
+	    config->test_mode != MODE_TCP_RR) {
+		fputs("latency can be only measured in TCP_RR test\n", stderr);
+		return -EINVAL;
+	}
+	if (confid_level_input(config->confid_pct) < 0 && !config->robust) {
+		fputs("only confidence level 95 or 99 are supported without --robust\n",
+		      stderr);
+		return -EINVAL;
+	}
+
 	if (config->confid_target_set && (config->min_iter < 3)) {
 		fputs("Use of confidence target requires at least 3 iterations (use -i option).\n",
 		      stderr);
@@ -298,22 +1075,30 @@ int parse_cmdline(int argc, char *argv[], struct client_config *config)
 	}
 
 	if (!config->msg_size) {
-		switch(config->test_mode) {
-		case MODE_TCP_STREAM:
-			config->msg_size = 1U << 20; /* 1 MB */
-			break;
-		case MODE_TCP_RR:
-			config->msg_size = 1U;
-			break;
-		default:
+		config->msg_size = default_msg_size(config->test_mode);
+		if (!config->msg_size) {
 			fprintf(stderr, "test mode %u not supported\n",
 				config->test_mode);
 			return -EINVAL;
 		}
 	}
 
+	if (config->verify && !config->msg_dist.n &&
+	    (config->msg_size < VERIFY_MIN_SIZE ||
+	     (config->resp_size && config->resp_size < VERIFY_MIN_SIZE))) {
+		fprintf(stderr, "--verify needs messages of at least %u bytes\n",
+			VERIFY_MIN_SIZE);
+		return -EINVAL;
+	}
+
 	if (config->stats_mask == UINT_MAX) {
-		if (config->max_iter == 1) {
+		if (config->sweep || config->slo_usec > 0) {
+			/* only the table of results */
+			config->stats_mask = 0;
+		} else if (config->coord_clients) {
+			/* per client results */
+			config->stats_mask = verb_levels[VERB_THREAD];
+		} else if (config->max_iter == 1) {
 			if (config->n_threads == 1)
 				config->stats_mask = verb_levels[VERB_RESULT];
 			else
@@ -323,6 +1108,17 @@ int parse_cmdline(int argc, char *argv[], struct client_config *config)
 		}
 	}
 
+	if (config->perf_counters)
+		config->stats_mask |= STATS_F_PERF;
+	if (config->tcp_info)
+		config->stats_mask |= STATS_F_TCPINFO;
+	/* only collected on request, JSON output includes them then */
+	config->net_counters = config->stats_mask & STATS_F_NET;
+	if (config->json_path && !strcmp(config->json_path, "-")) {
+		config->quiet = true;
+		config->stats_mask = 0;
+	}
+
 	print_opts_setup(&config->print_opts, config->test_mode);
 
 	return 0;
@@ -4,5 +4,6 @@
 struct client_config;
 
 int parse_cmdline(int argc, char *argv[], struct client_config *config);
+unsigned int default_msg_size(unsigned int test_mode);
 
 #endif /* __NPERF_CLIENT_CMDLINE_H */
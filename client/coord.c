@@ -0,0 +1,720 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "coord.h"
+#include "main.h"
+#include "../common.h"
+#include "../ctrlmsg.h"
+
+/* Several nperf processes (coordinated clients) can load the same servers
+ * over an identical time window: each client sets up its test as usual and
+ * reports to the coordinator once its data connections are established.
+ * When all clients are ready, the coordinator releases them at once, ends
+ * the test after -l seconds, collects their counters and decides whether
+ * another iteration is needed. Clients keep reporting their own results,
+ * the coordinator reports the aggregate.
+ */
+
+struct coord_client {
+	int			sd;
+	char			name[NI_MAXHOST];
+	unsigned int		n_threads;
+	struct ctrl_msg		msg;
+	struct xfer_stats	client_xfer;
+	struct xfer_stats	server_xfer;
+	struct cpu_usage	client_cpu;
+	struct cpu_usage	server_cpu;
+	double			elapsed;
+	double			result;
+};
+
+struct coordinator {
+	struct client_config	*config;
+	struct coord_client	*clients;
+	unsigned int		n_clients;
+	unsigned int		n_threads;	/* all clients */
+	double			window;		/* last iteration */
+	struct xfer_stats	client_xfer;	/* last iteration, all clients */
+	struct xfer_stats	server_xfer;
+	struct cpu_result	cpu;
+	struct fairness		fairness;	/* among clients */
+};
+
+/* coordinated client side */
+
+static int coord_connect(struct client_config *config)
+{
+	struct addrinfo hints = {
+		.ai_family	= AF_UNSPEC,
+		.ai_socktype	= SOCK_STREAM,
+		.ai_protocol	= IPPROTO_TCP,
+	};
+	struct addrinfo *results, *result;
+	char port[8];
+	int ret, sd = -1;
+
+	snprintf(port, sizeof(port), "%hu", config->coord_port);
+	ret = getaddrinfo(config->coord_host, port, &hints, &results);
+	if (ret) {
+		fprintf(stderr, "coordinator '%s' lookup failed: %s\n",
+			config->coord_host, gai_strerror(ret));
+		return -ENOENT;
+	}
+	ret = -ENOENT;
+	for (result = results; result; result = result->ai_next) {
+		sd = socket(result->ai_family, SOCK_STREAM, IPPROTO_TCP);
+		if (sd < 0) {
+			ret = -errno;
+			continue;
+		}
+		if (connect(sd, result->ai_addr, result->ai_addrlen) == 0) {
+			ret = 0;
+			break;
+		}
+		ret = -errno;
+		close(sd);
+	}
+	freeaddrinfo(results);
+	if (ret < 0) {
+		fprintf(stderr, "failed to connect to coordinator '%s': %s\n",
+			config->coord_host, strerror(-ret));
+		return ret;
+	}
+
+	config->coord_sd = sd;
+	return 0;
+}
+
+/* attributes of the message are left in config->coord_msg */
+static int coord_recv(struct client_config *config, enum ctrl_msg_type type)
+{
+	struct ctrl_msg *msg = &config->coord_msg;
+	int ret;
+
+	ret = ctrl_msg_recv(config->coord_sd, msg);
+	if (ret == 0 && ctrl_msg_type(msg) != type)
+		ret = -EPROTO;
+	if (ret == -ENOTCONN)
+		fputs("coordinator closed connection\n", stderr);
+	else if (ret < 0)
+		fprintf(stderr, "failed to receive message from coordinator: %s\n",
+			strerror(-ret));
+
+	return ret;
+}
+
+static int coord_send(struct client_config *config)
+{
+	int ret;
+
+	ret = ctrl_msg_send(config->coord_sd, &config->coord_msg);
+	if (ret < 0)
+		fprintf(stderr, "failed to send message to coordinator: %s\n",
+			strerror(-ret));
+	return ret;
+}
+
+/* Waits until all clients have joined. The coordinator decides how many
+ * iterations are run and how long they are, local -i, -I and -l are
+ * ignored.
+ */
+int coord_join(struct client_config *config)
+{
+	struct ctrl_msg *msg = &config->coord_msg;
+	const struct ctrl_attr *attr;
+	uint32_t iterations = 0;
+	uint32_t test_length = 0;
+	struct ctrl_attr_iter it;
+	int ret;
+
+	ret = coord_connect(config);
+	if (ret < 0)
+		return ret;
+	ctrl_msg_init(msg, CTRL_MSG_COORD_JOIN, 0);
+	ctrl_put_u32(msg, CA_MODE, 0, config->test_mode);
+	ctrl_put_u32(msg, CA_THREADS, 0, config->n_threads);
+	ctrl_put_u32(msg, CA_MSG_SIZE, 0, config->msg_size);
+	ret = coord_send(config);
+	if (ret < 0)
+		return ret;
+	ret = coord_recv(config, CTRL_MSG_COORD_JOIN);
+	if (ret < 0)
+		return ret;
+
+	ctrl_iter_msg(&it, msg);
+	while ((attr = ctrl_iter_next(&it))) {
+		switch (ctrl_attr_type(attr)) {
+		case CA_COORD_ITERATIONS:
+			ctrl_attr_u32(attr, &iterations);
+			break;
+		case CA_COORD_TEST_LENGTH:
+			ctrl_attr_u32(attr, &test_length);
+			break;
+		}
+	}
+	if (it.error || !iterations)
+		return -EPROTO;
+	if (test_length)
+		config->test_length = test_length;
+	config->min_iter = 1;
+	config->max_iter = iterations;
+	config->confid_target_set = false;
+
+	return 0;
+}
+
+/* data connections are established, wait for the common start */
+int coord_ready(struct client_config *config)
+{
+	int ret;
+
+	ctrl_msg_init(&config->coord_msg, CTRL_MSG_COORD_READY,
+		      config->test_id);
+	ret = coord_send(config);
+	if (ret < 0)
+		return ret;
+	return coord_recv(config, CTRL_MSG_COORD_GO);
+}
+
+int coord_wait_stop(struct client_config *config)
+{
+	return coord_recv(config, CTRL_MSG_COORD_STOP);
+}
+
+static void coord_put_cpu(struct ctrl_msg *msg, uint16_t type,
+			  const struct cpu_usage *usage)
+{
+	struct ctrl_cpu_usage cpu = {
+		.n_cpus		= htonl(usage->n_cpus),
+		.busy_usec	= hton64(usage->busy_usec),
+		.total_usec	= hton64(usage->total_usec),
+	};
+
+	ctrl_put(msg, type, 0, &cpu, sizeof(cpu));
+}
+
+int coord_send_result(struct client_config *config,
+		      const struct xfer_stats *sum_client,
+		      const struct xfer_stats *sum_server)
+{
+	struct ctrl_msg *msg = &config->coord_msg;
+	struct xfer_stats xfer;
+
+	ctrl_msg_init(msg, CTRL_MSG_COORD_RESULT, config->test_id);
+	ctrl_put_u64(msg, CA_COORD_ELAPSED_USEC, 0, config->elapsed * 1E6);
+	xfer_stats_hton(sum_client, &xfer);
+	ctrl_put(msg, CA_COORD_CLIENT_XFER, 0, &xfer, sizeof(xfer));
+	xfer_stats_hton(sum_server, &xfer);
+	ctrl_put(msg, CA_COORD_SERVER_XFER, 0, &xfer, sizeof(xfer));
+	coord_put_cpu(msg, CA_COORD_CLIENT_CPU, &config->cpu_usage);
+	coord_put_cpu(msg, CA_COORD_SERVER_CPU, &config->server_cpu_usage);
+
+	return coord_send(config);
+}
+
+int coord_next(struct client_config *config, bool *more)
+{
+	const struct ctrl_attr *attr;
+	struct ctrl_attr_iter it;
+	int ret;
+
+	ret = coord_recv(config, CTRL_MSG_COORD_NEXT);
+	if (ret < 0)
+		return ret;
+	*more = true;
+	ctrl_iter_msg(&it, &config->coord_msg);
+	while ((attr = ctrl_iter_next(&it)))
+		if (ctrl_attr_type(attr) == CA_COORD_DONE)
+			*more = false;
+
+	return it.error;
+}
+
+void coord_close(struct client_config *config)
+{
+	if (config->coord_sd >= 0)
+		close(config->coord_sd);
+	config->coord_sd = -1;
+	ctrl_msg_free(&config->coord_msg);
+}
+
+/* coordinator side */
+
+static int coord_listen(uint16_t port, unsigned int backlog)
+{
+	union sockaddr_any addr = {
+		.sa6 = {
+			.sin6_family	= AF_INET6,
+			.sin6_port	= htons(port),
+			.sin6_addr	= IN6ADDR_ANY_INIT,
+		}
+	};
+	int val;
+	int ret;
+	int sd;
+
+	sd = socket(PF_INET6, SOCK_STREAM, IPPROTO_TCP);
+	if (sd < 0) {
+		ret = -errno;
+		perror("socket");
+		return ret;
+	}
+	val = 0;
+	ret = setsockopt(sd, SOL_IPV6, IPV6_V6ONLY, &val, sizeof(val));
+	if (ret < 0) {
+		ret = -errno;
+		perror("setsockopt(IPV6_V6ONLY)");
+		goto err;
+	}
+	val = 1;
+	ret = setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
+	if (ret < 0) {
+		ret = -errno;
+		perror("setsockopt(SO_REUSEADDR)");
+		goto err;
+	}
+	ret = bind(sd, &addr.sa, sizeof(addr.sa6));
+	if (ret < 0) {
+		ret = -errno;
+		perror("bind");
+		goto err;
+	}
+	ret = listen(sd, backlog);
+	if (ret < 0) {
+		ret = -errno;
+		perror("listen");
+		goto err;
+	}
+
+	return sd;
+err:
+	close(sd);
+	return ret;
+}
+
+/* all clients must run the same test for the sum to make sense */
+static int coord_accept(struct coordinator *co, int listen_sd)
+{
+	struct client_config *config = co->config;
+	struct coord_client *c = &co->clients[co->n_clients];
+	uint32_t mode = MODE_COUNT, n_threads = 0, msg_size = 0;
+	const struct ctrl_attr *attr;
+	union sockaddr_any addr;
+	struct ctrl_attr_iter it;
+	socklen_t addr_len;
+	int ret;
+
+	addr_len = sizeof(addr);
+	c->sd = accept(listen_sd, &addr.sa, &addr_len);
+	if (c->sd < 0) {
+		ret = -errno;
+		perror("accept");
+		return ret;
+	}
+	co->n_clients++;
+	if (getnameinfo(&addr.sa, addr_len, c->name, sizeof(c->name), NULL,
+			0, NI_NUMERICHOST))
+		strcpy(c->name, "?");
+
+	ret = ctrl_msg_recv(c->sd, &c->msg);
+	if (ret == 0 && ctrl_msg_type(&c->msg) != CTRL_MSG_COORD_JOIN)
+		ret = -EPROTO;
+	if (ret < 0) {
+		fprintf(stderr, "client %s failed to join\n", c->name);
+		return ret;
+	}
+	ctrl_iter_msg(&it, &c->msg);
+	while ((attr = ctrl_iter_next(&it))) {
+		switch (ctrl_attr_type(attr)) {
+		case CA_MODE:
+			ctrl_attr_u32(attr, &mode);
+			break;
+		case CA_THREADS:
+			ctrl_attr_u32(attr, &n_threads);
+			break;
+		case CA_MSG_SIZE:
+			ctrl_attr_u32(attr, &msg_size);
+			break;
+		}
+	}
+	if (it.error || mode >= MODE_COUNT || !n_threads) {
+		fprintf(stderr, "client %s sent invalid join request\n",
+			c->name);
+		return -EPROTO;
+	}
+	if (co->n_clients == 1) {
+		config->test_mode = mode;
+		config->msg_size = msg_size;
+	} else if (mode != config->test_mode) {
+		fprintf(stderr, "client %s runs %s, other clients %s\n",
+			c->name, test_mode_names[mode],
+			test_mode_names[config->test_mode]);
+		return -EINVAL;
+	} else if (msg_size != config->msg_size) {
+		fprintf(stderr, "warning: client %s uses message size %u, first client %u\n",
+			c->name, msg_size, config->msg_size);
+	}
+	c->n_threads = n_threads;
+	co->n_threads += n_threads;
+
+	return 0;
+}
+
+static int coord_send_all(struct coordinator *co, enum ctrl_msg_type type,
+			  unsigned int iter, bool done)
+{
+	struct coord_client *c;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < co->n_clients; i++) {
+		c = &co->clients[i];
+		ctrl_msg_init(&c->msg, type, iter);
+		if (type == CTRL_MSG_COORD_JOIN) {
+			ctrl_put_u32(&c->msg, CA_COORD_ITERATIONS, 0,
+				     co->config->max_iter);
+			ctrl_put_u32(&c->msg, CA_COORD_TEST_LENGTH, 0,
+				     co->config->test_length);
+		}
+		if (done)
+			ctrl_put_flag(&c->msg, CA_COORD_DONE, 0);
+		ret = ctrl_msg_send(c->sd, &c->msg);
+		if (ret < 0) {
+			fprintf(stderr, "failed to send message to client %s: %s\n",
+				c->name, strerror(-ret));
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static void coord_get_cpu(const struct ctrl_attr *attr,
+			  struct cpu_usage *usage)
+{
+	struct ctrl_cpu_usage cpu;
+
+	if (ctrl_attr_struct(attr, &cpu, sizeof(cpu)) < 0)
+		return;
+	usage->n_cpus = ntohl(cpu.n_cpus);
+	usage->busy_usec = ntoh64(cpu.busy_usec);
+	usage->total_usec = ntoh64(cpu.total_usec);
+}
+
+static void coord_parse_result(struct coord_client *c)
+{
+	const struct ctrl_attr *attr;
+	struct ctrl_attr_iter it;
+	struct xfer_stats xfer;
+	uint64_t usec;
+
+	xfer_stats_reset(&c->client_xfer);
+	xfer_stats_reset(&c->server_xfer);
+	memset(&c->client_cpu, '\0', sizeof(c->client_cpu));
+	memset(&c->server_cpu, '\0', sizeof(c->server_cpu));
+	c->elapsed = 0.0;
+	ctrl_iter_msg(&it, &c->msg);
+	while ((attr = ctrl_iter_next(&it))) {
+		switch (ctrl_attr_type(attr)) {
+		case CA_COORD_ELAPSED_USEC:
+			if (ctrl_attr_u64(attr, &usec) == 0)
+				c->elapsed = 1E-6 * usec;
+			break;
+		case CA_COORD_CLIENT_XFER:
+			if (ctrl_attr_struct(attr, &xfer, sizeof(xfer)) == 0)
+				xfer_stats_ntoh(&xfer, &c->client_xfer);
+			break;
+		case CA_COORD_SERVER_XFER:
+			if (ctrl_attr_struct(attr, &xfer, sizeof(xfer)) == 0)
+				xfer_stats_ntoh(&xfer, &c->server_xfer);
+			break;
+		case CA_COORD_CLIENT_CPU:
+			coord_get_cpu(attr, &c->client_cpu);
+			break;
+		case CA_COORD_SERVER_CPU:
+			coord_get_cpu(attr, &c->server_cpu);
+			break;
+		}
+	}
+}
+
+/* a client which fails or quits aborts the whole run */
+static int coord_recv_all(struct coordinator *co, enum ctrl_msg_type type)
+{
+	struct coord_client *c;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < co->n_clients; i++) {
+		c = &co->clients[i];
+		ret = ctrl_msg_recv(c->sd, &c->msg);
+		if (ret == 0 && ctrl_msg_type(&c->msg) != type)
+			ret = -EPROTO;
+		if (ret < 0) {
+			fprintf(stderr, "client %s failed: %s\n", c->name,
+				ret == -ENOTCONN ? "connection closed" :
+						   strerror(-ret));
+			return ret;
+		}
+		if (type == CTRL_MSG_COORD_RESULT)
+			coord_parse_result(c);
+	}
+
+	return 0;
+}
+
+/* Client results are computed from their own elapsed time; server CPU
+ * usage is summed per client so servers shared by several clients count
+ * more than once.
+ */
+static double coord_collect(struct coordinator *co)
+{
+	struct client_config *config = co->config;
+	struct cpu_usage client_cpu = {}, server_cpu = {};
+	double sum = 0.0, sum_sqr = 0.0;
+	struct coord_client *c;
+	unsigned int i;
+
+	xfer_stats_reset(&co->client_xfer);
+	xfer_stats_reset(&co->server_xfer);
+	for (i = 0; i < co->n_clients; i++) {
+		c = &co->clients[i];
+		c->result = c->elapsed > 0 ?
+			    xfer_stats_result(&c->client_xfer, &c->server_xfer,
+					      config->test_mode, c->elapsed) :
+			    0.0;
+		sum += c->result;
+		sum_sqr += c->result * c->result;
+		fairness_add(&co->fairness, i, c->result);
+		xfer_stats_add(&co->client_xfer, &c->client_xfer);
+		xfer_stats_add(&co->server_xfer, &c->server_xfer);
+		client_cpu.busy_usec += c->client_cpu.busy_usec;
+		client_cpu.total_usec += c->client_cpu.total_usec;
+		server_cpu.busy_usec += c->server_cpu.busy_usec;
+		server_cpu.total_usec += c->server_cpu.total_usec;
+	}
+	fairness_finish(&co->fairness, sum, sum_sqr, co->n_clients);
+
+	co->cpu.client_util = cpu_usage_util(&client_cpu);
+	co->cpu.server_util = cpu_usage_util(&server_cpu);
+	co->cpu.client_sdem = service_demand(client_cpu.busy_usec,
+					     &co->client_xfer, &co->server_xfer,
+					     config->test_mode);
+	co->cpu.server_sdem = service_demand(server_cpu.busy_usec,
+					     &co->client_xfer, &co->server_xfer,
+					     config->test_mode);
+	return sum;
+}
+
+static void coord_print_clients(const struct coordinator *co)
+{
+	const struct client_config *config = co->config;
+	const struct coord_client *c;
+	unsigned int i;
+
+	if (config->stats_mask & STATS_F_RAW) {
+		xfer_stats_raw_header("client");
+		for (i = 0; i < co->n_clients; i++)
+			xfer_stats_print_raw(&co->clients[i].client_xfer, i);
+		xfer_stats_print_raw(&co->client_xfer, XFER_STATS_TOTAL);
+		putchar('\n');
+		xfer_stats_raw_header("server");
+		for (i = 0; i < co->n_clients; i++)
+			xfer_stats_print_raw(&co->clients[i].server_xfer, i);
+		xfer_stats_print_raw(&co->server_xfer, XFER_STATS_TOTAL);
+		putchar('\n');
+	}
+	if (!(config->stats_mask & STATS_F_THREAD))
+		return;
+	printf("window %.3lf s\n", co->window);
+	for (i = 0; i < co->n_clients; i++) {
+		c = &co->clients[i];
+		printf("client %-3u %-20s %4u threads ", i, c->name,
+		       c->n_threads);
+		print_rate(c->result, &config->print_opts);
+		printf(", elapsed %.3lf s\n", c->elapsed);
+	}
+	putchar('\n');
+}
+
+/* release all clients at once, end the test after test_length seconds */
+static int coord_iteration(struct coordinator *co, unsigned int iter,
+			   double *result)
+{
+	struct timespec ts0, ts1, end;
+	int ret;
+
+	ret = coord_recv_all(co, CTRL_MSG_COORD_READY);
+	if (ret < 0)
+		return ret;
+	clock_gettime(CLOCK_MONOTONIC, &ts0);
+	ret = coord_send_all(co, CTRL_MSG_COORD_GO, iter, false);
+	if (ret < 0)
+		return ret;
+	end = ts0;
+	end.tv_sec += co->config->test_length;
+	do
+		ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &end,
+				      NULL);
+	while (ret == EINTR);
+	ret = coord_send_all(co, CTRL_MSG_COORD_STOP, iter, false);
+	if (ret < 0)
+		return ret;
+	clock_gettime(CLOCK_MONOTONIC, &ts1);
+	co->window = timespec_diff(&ts0, &ts1);
+
+	ret = coord_recv_all(co, CTRL_MSG_COORD_RESULT);
+	if (ret < 0)
+		return ret;
+	*result = coord_collect(co);
+	coord_print_clients(co);
+
+	return 0;
+}
+
+static void coord_print_header(const struct coordinator *co)
+{
+	const struct client_config *config = co->config;
+
+	printf("coordinator: port %hu, clients: %u, threads: %u\n",
+	       config->coord_port, co->n_clients, co->n_threads);
+	if (config->min_iter < config->max_iter)
+		printf("iterations: %u-%u", config->min_iter,
+		       config->max_iter);
+	else
+		printf("iterations: %u", config->min_iter);
+	printf(", test length: %u\n", config->test_length);
+	printf("test: %s\n\n", test_mode_names[config->test_mode]);
+}
+
+static int coord_run(struct coordinator *co)
+{
+	struct client_config *config = co->config;
+	unsigned int stats_mask = config->stats_mask;
+	double confid_target_hw, confid_ival_hw = HUGE_VAL;
+	bool show_fair = co->n_clients > 1;
+	struct cpu_result cpu_sum = {};
+	double sum = 0.0, sum_sqr = 0.0;
+	unsigned int n_iter = 0;
+	double result;
+	bool done;
+	int ret;
+
+	confid_target_hw = 0.999 * config->confid_target / 200.0;
+	for (n_iter = 0; n_iter < config->max_iter; ) {
+		if (stats_mask & (STATS_F_THREAD | STATS_F_RAW))
+			printf("iteration %u\n", n_iter + 1);
+		ret = coord_iteration(co, n_iter + 1, &result);
+		if (ret < 0)
+			return ret;
+		n_iter++;
+		sum += result;
+		sum_sqr += result * result;
+		cpu_sum.client_util += co->cpu.client_util;
+		cpu_sum.server_util += co->cpu.server_util;
+		cpu_sum.client_sdem += co->cpu.client_sdem;
+		cpu_sum.server_sdem += co->cpu.server_sdem;
+		if (n_iter > 1)
+			confid_ival_hw = confid_interval(sum, sum_sqr, n_iter,
+							 config->confid_level) /
+					 (sum / n_iter);
+		if (stats_mask & STATS_F_ITER) {
+			print_iter_result(n_iter, n_iter, result, sum, sum_sqr,
+					  config->confid_level,
+					  config->show_cpu ? &co->cpu : NULL,
+					  show_fair ? &co->fairness : NULL,
+					  &config->print_opts);
+			if (stats_mask & (STATS_F_THREAD | STATS_F_RAW))
+				putchar('\n');
+		}
+		fflush(stdout);
+
+		done = n_iter >= config->max_iter ||
+		       (config->confid_target_set &&
+			n_iter >= config->min_iter &&
+			confid_ival_hw <= confid_target_hw);
+		ret = coord_send_all(co, CTRL_MSG_COORD_NEXT, n_iter, done);
+		if (ret < 0)
+			return ret;
+		if (done)
+			break;
+	}
+
+	if (config->confid_target_set &&
+	    (n_iter < 2 || 200.0 * confid_ival_hw > config->confid_target))
+		fprintf(stderr,
+			"*** Failed to reach confidence target.\n"
+			"*** Confidence interval width is %.4lg%% (+/- %.4lg%%), requested %.4lg%%.\n"
+			"*** The result is not reliable enough.\n",
+			200.0 * confid_ival_hw, 100.0 * confid_ival_hw,
+			config->confid_target);
+	if (stats_mask & STATS_F_TOTAL) {
+		cpu_sum.client_util /= n_iter;
+		cpu_sum.server_util /= n_iter;
+		cpu_sum.client_sdem /= n_iter;
+		cpu_sum.server_sdem /= n_iter;
+		print_iter_result(XFER_STATS_TOTAL, n_iter, 0.0, sum, sum_sqr,
+				  config->confid_level,
+				  config->show_cpu ? &cpu_sum : NULL, NULL,
+				  &config->print_opts);
+	}
+
+	return 0;
+}
+
+/* Run as coordinator: wait for the requested number of clients, then drive
+ * their iterations. Returns when all iterations are done or any client
+ * fails; closing the connections makes the remaining clients quit.
+ */
+int coord_main(struct client_config *config)
+{
+	struct coordinator co = {
+		.config		= config,
+	};
+	unsigned int i;
+	int listen_sd;
+	int ret;
+
+	ret = ignore_signal(SIGPIPE);
+	if (ret < 0)
+		return ret;
+	co.clients = calloc(config->coord_clients, sizeof(co.clients[0]));
+	if (!co.clients)
+		return -ENOMEM;
+	listen_sd = coord_listen(config->coord_port, config->coord_clients);
+	if (listen_sd < 0) {
+		ret = listen_sd;
+		goto out;
+	}
+	while (co.n_clients < config->coord_clients) {
+		ret = coord_accept(&co, listen_sd);
+		if (ret < 0)
+			break;
+	}
+	close(listen_sd);
+	if (ret < 0)
+		goto out;
+
+	print_opts_setup(&config->print_opts, config->test_mode);
+	if (!config->quiet)
+		coord_print_header(&co);
+	ret = coord_send_all(&co, CTRL_MSG_COORD_JOIN, 0, false);
+	if (ret == 0)
+		ret = coord_run(&co);
+out:
+	for (i = 0; i < co.n_clients; i++) {
+		close(co.clients[i].sd);
+		ctrl_msg_free(&co.clients[i].msg);
+	}
+	free(co.clients);
+	return ret;
+}
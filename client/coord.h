@@ -0,0 +1,26 @@
+#ifndef __NPERF_CLIENT_COORD_H
+#define __NPERF_CLIENT_COORD_H
+
+#include <stdbool.h>
+
+#include "../stats.h"
+
+#define DEFAULT_COORD_PORT 12544
+#define MAX_COORD_CLIENTS 256
+
+struct client_config;
+
+/* coordinator side (nperf --coordinator) */
+int coord_main(struct client_config *config);
+
+/* coordinated client side (nperf --coordinate) */
+int coord_join(struct client_config *config);
+int coord_ready(struct client_config *config);
+int coord_wait_stop(struct client_config *config);
+int coord_send_result(struct client_config *config,
+		      const struct xfer_stats *sum_client,
+		      const struct xfer_stats *sum_server);
+int coord_next(struct client_config *config, bool *more);
+void coord_close(struct client_config *config);
+
+#endif /* __NPERF_CLIENT_COORD_H */
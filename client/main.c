@@ -20,8 +20,17 @@
 #include "main.h"
 #include "worker.h"
 #include "cmdline.h"
+#include "coord.h"
+#include "../json.h"
+#include "../verify.h"
+
+#define CONVERGE_WARMUP		2	/* intervals ignored at test start */
+#define CONVERGE_MIN_SAMPLES	10
+#define ROBUST_MIN_SAMPLES	10	/* t interval below */
 
 double *iter_results;
+struct cpu_result *iter_cpu;
+struct fairness *iter_fairness;
 
 struct client_config client_config = {
 	.ctrl_port	= DEFAULT_PORT,
@@ -30,10 +39,15 @@ struct client_config client_config = {
 	.min_iter	= 1,
 	.max_iter	= 1,
 	.n_threads	= 1,
+	.accept_threads	= 1,
+	.connect_retries = 3,
+	.confid_pct	= 95,
 	.stats_mask	= UINT_MAX,
 	.tcp_nodelay	= false,
+	.coord_port	= DEFAULT_COORD_PORT,
+	.coord_sd	= -1,
 };
-union sockaddr_any server_addr;
+static struct json_writer json;
 
 /* USR1 signal is sent by control thread to all workers when the test interval
  * is over. No handler is needed but we need to clear SA_RESTART flag so that
@@ -66,45 +80,255 @@ static int client_init(void)
 	return ignore_signal(SIGPIPE);
 }
 
-static int ctrl_send_start(struct client_config *config)
+static unsigned int server_sockopt_count(const struct client_config *config)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < config->n_sockopts; i++)
+		n += config->sockopts[i].server;
+	return n;
+}
+
+/* threads are assigned to servers round robin */
+static unsigned int thread_server(const struct client_config *config,
+				  unsigned int i)
+{
+	return i % config->n_servers;
+}
+
+static bool server_cap(const struct server_target *srv, enum ctrl_cap cap)
+{
+	return srv->caps & (1ULL << cap);
+}
+
+/* Optional feature the server cannot provide is only left out on that
+ * server, client side values are still collected.
+ */
+static void drop_metric(const struct server_target *srv, bool enabled,
+			enum ctrl_cap cap)
+{
+	if (!enabled || server_cap(srv, cap))
+		return;
+	fprintf(stderr, "warning: server %s does not support %s, server values unavailable\n",
+		srv->host, ctrl_cap_names[cap]);
+}
+
+/* server side values of a metric are shown only if all servers have them */
+static bool servers_cap(const struct client_config *config, enum ctrl_cap cap)
+{
+	unsigned int i;
+
+	for (i = 0; i < config->n_servers; i++)
+		if (!server_cap(&config->servers[i], cap))
+			return false;
+	return true;
+}
+
+/* Features changing what the test does cannot be left out silently. */
+static int ctrl_check_caps(struct client_config *config,
+			   const struct server_target *srv)
+{
+	uint64_t needed = 0;
+	uint64_t missing;
+	unsigned int i;
+
+	drop_metric(srv, config->cpu_steering, CTRL_CAP_CPU_STEERING);
+	drop_metric(srv, config->perf_counters, CTRL_CAP_PERF_COUNTERS);
+	drop_metric(srv, config->tcp_info, CTRL_CAP_TCP_INFO);
+	drop_metric(srv, config->net_counters, CTRL_CAP_NET_COUNTERS);
+
+	if (config->resp_size)
+		needed |= 1ULL << CTRL_CAP_RESP_SIZE;
+	if (config->msg_dist.n)
+		needed |= 1ULL << CTRL_CAP_MSG_DIST;
+	if (config->verify)
+		needed |= 1ULL << CTRL_CAP_VERIFY;
+	if (config->service_type != SERVICE_NONE)
+		needed |= 1ULL << CTRL_CAP_SERVICE;
+	if (config->server_cc[0])
+		needed |= 1ULL << CTRL_CAP_CONGESTION;
+	if (server_sockopt_count(config))
+		needed |= 1ULL << CTRL_CAP_SOCKOPT;
+	missing = needed & ~srv->caps;
+	if (!missing)
+		return 0;
+	for (i = 0; i < CTRL_CAP_COUNT; i++)
+		if (missing & (1ULL << i))
+			fprintf(stderr, "server %s does not support %s\n",
+				srv->host, ctrl_cap_names[i]);
+	return -EOPNOTSUPP;
+}
+
+static int ctrl_hello(struct client_config *config, struct server_target *srv)
+{
+	struct ctrl_msg *msg = &srv->msg;
+	const struct ctrl_attr *attr;
+	struct ctrl_attr_iter it;
+	int ret;
+
+	ctrl_msg_init(msg, CTRL_MSG_HELLO, 0);
+	ctrl_put_u64(msg, CA_CAPS, 0, CTRL_CAPS_ALL);
+	ret = ctrl_msg_send(srv->ctrl_sd, msg);
+	if (ret < 0)
+		return ret;
+	ret = ctrl_msg_recv(srv->ctrl_sd, msg);
+	if (ret == -ENOTCONN || ret == -EINVAL || ret == -ECONNRESET) {
+		fprintf(stderr, "server %s closed control connection "
+			"(incompatible protocol version?)\n",
+			srv->host);
+		return -EPROTO;
+	}
+	if (ret < 0)
+		return ret;
+	if (ctrl_msg_type(msg) != CTRL_MSG_HELLO)
+		return -EPROTO;
+
+	srv->caps = 0;
+	ctrl_iter_msg(&it, msg);
+	while ((attr = ctrl_iter_next(&it)))
+		if (ctrl_attr_type(attr) == CA_CAPS)
+			ctrl_attr_u64(attr, &srv->caps);
+	if (it.error)
+		return it.error;
+
+	return ctrl_check_caps(config, srv);
+}
+
+static void ctrl_put_service(struct ctrl_msg *msg,
+			     const struct client_config *config)
 {
-	struct client_ctrl_msg msg = {
-		.length		= htonl(sizeof(msg)),
-		.version	= htonl(CTRL_VERSION),
-		.test_id	= htonl(1),
-		.mode		= htonl(config->test_mode),
-		.n_threads	= htonl(config->n_threads),
-		.msg_size	= htonl(config->msg_size),
-		.tcp_nodelay	= !!config->tcp_nodelay,
+	struct ctrl_service svc = {
+		.type	= htonl(config->service_type),
+		.arg1	= htonl(config->service_arg1),
+		.arg2	= htonl(config->service_arg2),
 	};
+
+	ctrl_put(msg, CA_SERVICE, CTRL_ATTR_F_MANDATORY, &svc, sizeof(svc));
+}
+
+static void ctrl_put_sockopts(struct ctrl_msg *msg,
+			      const struct client_config *config)
+{
+	struct sockopt opt;
+	unsigned int i;
+
+	for (i = 0; i < config->n_sockopts; i++) {
+		if (!config->sockopts[i].server)
+			continue;
+		sockopt_hton(&config->sockopts[i].opt, &opt, 1);
+		ctrl_put(msg, CA_SOCKOPT, CTRL_ATTR_F_MANDATORY, &opt,
+			 sizeof(opt));
+	}
+}
+
+/* Only enabled features are sent; those the test depends on are flagged
+ * mandatory so that a server not knowing them refuses the test.
+ */
+static int ctrl_send_start(struct client_config *config,
+			   struct server_target *srv)
+{
+	const uint16_t mand = CTRL_ATTR_F_MANDATORY;
+	struct ctrl_msg *msg = &srv->msg;
+
+	ctrl_msg_init(msg, CTRL_MSG_TEST, config->test_id);
+	ctrl_put_u32(msg, CA_MODE, mand, config->test_mode);
+	ctrl_put_u32(msg, CA_THREADS, mand, srv->n_threads);
+	ctrl_put_u32(msg, CA_MSG_SIZE, mand, config->msg_size);
+	/* 0 (one listener per CPU) must be explicit, absent means one */
+	if (config->accept_threads != 1)
+		ctrl_put_u32(msg, CA_ACCEPT_THREADS, 0,
+			     config->accept_threads);
+	if (config->tcp_nodelay)
+		ctrl_put_flag(msg, CA_TCP_NODELAY, mand);
+	if (config->cpu_steering && server_cap(srv, CTRL_CAP_CPU_STEERING))
+		ctrl_put_flag(msg, CA_CPU_STEERING, 0);
+	if (config->perf_counters && server_cap(srv, CTRL_CAP_PERF_COUNTERS))
+		ctrl_put_flag(msg, CA_PERF_COUNTERS, 0);
+	if (config->tcp_info && server_cap(srv, CTRL_CAP_TCP_INFO))
+		ctrl_put_u32(msg, CA_TCP_INFO, 0, config->tcp_info_interval);
+	if (config->net_counters && server_cap(srv, CTRL_CAP_NET_COUNTERS))
+		ctrl_put_flag(msg, CA_NET_COUNTERS, 0);
+	if (config->resp_size)
+		ctrl_put_u32(msg, CA_RESP_SIZE, mand, config->resp_size);
+	if (config->msg_dist.n) {
+		struct msgdist_segment segs[config->msg_dist.n];
+
+		msgdist_hton(&config->msg_dist, segs);
+		ctrl_put(msg, CA_MSG_DIST, mand, segs, sizeof(segs));
+		ctrl_put_u32(msg, CA_SIZE_SEED, mand, config->size_seed);
+	}
+	if (config->verify)
+		ctrl_put_flag(msg, CA_VERIFY, mand);
+	if (config->service_type != SERVICE_NONE)
+		ctrl_put_service(msg, config);
+	if (config->server_cc[0])
+		ctrl_put_string(msg, CA_CONGESTION, mand, config->server_cc);
+	ctrl_put_sockopts(msg, config);
+
+	return ctrl_msg_send(srv->ctrl_sd, msg);
+}
+
+/* receive a reply to current test, attributes are left in srv->msg */
+static int ctrl_recv_reply(const struct client_config *config,
+			   struct server_target *srv, enum ctrl_msg_type type)
+{
+	struct ctrl_msg *msg = &srv->msg;
 	int ret;
 
-	ret = ctrl_send_msg(config->ctrl_sd, &msg, sizeof(msg));
+	ret = ctrl_msg_recv(srv->ctrl_sd, msg);
 	if (ret < 0)
 		return ret;
+	if (ctrl_msg_type(msg) != type ||
+	    ctrl_msg_test_id(msg) != config->test_id)
+		return -EPROTO;
 
 	return 0;
 }
 
-static int ctrl_recv_start(struct client_config *config)
+static int ctrl_recv_start(struct client_config *config,
+			   struct server_target *srv)
 {
-	struct server_start_msg msg;
+	unsigned int status = CTRL_STATUS_COUNT;
+	const struct ctrl_attr *attr;
+	struct ctrl_attr_iter it;
+	uint32_t port = 0;
 	int ret;
 
-	ret = ctrl_recv_msg(config->ctrl_sd, &msg, sizeof(msg));
+	ret = ctrl_recv_reply(config, srv, CTRL_MSG_START);
 	if (ret < 0)
 		return ret;
+	ctrl_iter_msg(&it, &srv->msg);
+	while ((attr = ctrl_iter_next(&it))) {
+		switch (ctrl_attr_type(attr)) {
+		case CA_STATUS:
+			ctrl_attr_u32(attr, &status);
+			break;
+		case CA_PORT:
+			ctrl_attr_u32(attr, &port);
+			break;
+		}
+	}
+	if (it.error)
+		return it.error;
+	if (status != CTRL_STATUS_OK) {
+		fprintf(stderr, "server %s refused the test: %s\n",
+			srv->host, (status < CTRL_STATUS_COUNT) ?
+				ctrl_status_names[status] : "unknown reason");
+		return -EBUSY;
+	}
+	if (!port || port > UINT16_MAX)
+		return -EPROTO;
 
-	config->test_port = ntohs(msg.port);
-	memcpy(&test_addr, &server_addr, sizeof(test_addr));
-	ret = sockaddr_set_port(&test_addr, config->test_port);
+	memcpy(&srv->test_addr, &srv->ctrl_addr, sizeof(srv->test_addr));
+	ret = sockaddr_set_port(&srv->test_addr, port);
 	if (ret < 0)
 		return ret;
 
 	return 0;
 }
 
-static int ctrl_connect_with_lookup(struct client_config *config)
+static int ctrl_connect_with_lookup(struct client_config *config,
+				    struct server_target *srv)
 {
 	struct addrinfo hints = {
 		.ai_flags	= 0,
@@ -117,10 +341,10 @@ static int ctrl_connect_with_lookup(struct client_config *config)
 	struct addrinfo *result;
 	int ret;
 
-	ret = getaddrinfo(config->server_host, NULL, &hints, &results);
+	ret = getaddrinfo(srv->host, NULL, &hints, &results);
 	if (ret) {
 		fprintf(stderr, "host '%s' lookup failed: %s\n",
-			config->server_host, gai_strerror(ret));
+			srv->host, gai_strerror(ret));
 		return -ENOENT;
 	}
 
@@ -145,62 +369,113 @@ static int ctrl_connect_with_lookup(struct client_config *config)
 	if (ret < 0) {
 		freeaddrinfo(results);
 		fprintf(stderr, "failed to connect to '%s'\n",
-			config->server_host);
+			srv->host);
 		return ret;
 	}
 
-	config->ctrl_sd = sd;
-	memcpy(&server_addr, result->ai_addr,  result->ai_addrlen);
+	srv->ctrl_sd = sd;
+	memcpy(&srv->ctrl_addr, result->ai_addr,  result->ai_addrlen);
 	freeaddrinfo(results);
 	return 0;
 }
 
-static int ctrl_connect_fast(struct client_config *config)
+static int ctrl_connect_fast(struct server_target *srv)
 {
 	socklen_t addr_len;
 	int ret, sd;
 
-	sd = socket(server_addr.sa.sa_family, SOCK_STREAM, IPPROTO_TCP);
+	sd = socket(srv->ctrl_addr.sa.sa_family, SOCK_STREAM, IPPROTO_TCP);
 	if (sd < 0)
 		return -errno;
-	ret = sockaddr_length(&server_addr);
+	ret = sockaddr_length(&srv->ctrl_addr);
 	if (ret < 0)
 		goto err;
 	addr_len = ret;
-	ret = connect(sd, &server_addr.sa, addr_len);
+	ret = connect(sd, &srv->ctrl_addr.sa, addr_len);
 	if (ret < 0) {
 		ret = -errno;
 		goto err;
 	}
 
-	config->ctrl_sd = sd;
+	srv->ctrl_sd = sd;
 	return 0;
 err:
 	close(sd);
 	return ret;
 }
 
+/* closing any control connection aborts the test on that server */
 static void ctrl_close(struct client_config *config)
 {
-	close(config->ctrl_sd);
+	struct server_target *srv;
+	unsigned int i;
+
+	for (i = 0; i < config->n_servers; i++) {
+		srv = &config->servers[i];
+		if (srv->ctrl_sd < 0)
+			continue;
+		close(srv->ctrl_sd);
+		srv->ctrl_sd = -1;
+	}
+}
+
+/* Control connections are shared by all tests (iterations), they are only
+ * opened again if a previous test failed.
+ */
+static int ctrl_connect(struct client_config *config)
+{
+	struct server_target *srv;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < config->n_servers; i++) {
+		srv = &config->servers[i];
+		if (srv->ctrl_sd >= 0)
+			continue;
+		if (srv->ctrl_addr.sa.sa_family)
+			ret = ctrl_connect_fast(srv);
+		else
+			ret = ctrl_connect_with_lookup(config, srv);
+		if (ret < 0)
+			return ret;
+		ret = ctrl_hello(config, srv);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
 }
 
+/* All servers are asked before any answer is awaited so that their setup
+ * runs in parallel.
+ */
 static int ctrl_initialize(struct client_config *config)
 {
+	unsigned int n_servers = config->n_servers;
+	unsigned int i;
 	int ret;
 
-	if (server_addr.sa.sa_family)
-		ret = ctrl_connect_fast(config);
-	else
-		ret = ctrl_connect_with_lookup(config);
-	if (ret < 0)
-		return ret;
-	ret = ctrl_send_start(config);
-	if (ret < 0)
-		return ret;
-	ret = ctrl_recv_start(config);
+	if (config->n_threads < n_servers) {
+		fprintf(stderr, "%u threads cannot be spread over %u servers\n",
+			config->n_threads, n_servers);
+		return -EINVAL;
+	}
+	ret = ctrl_connect(config);
 	if (ret < 0)
 		return ret;
+	config->test_id++;
+	for (i = 0; i < n_servers; i++) {
+		config->servers[i].n_threads = config->n_threads / n_servers +
+					       (i < config->n_threads % n_servers);
+		ret = ctrl_send_start(config, &config->servers[i]);
+		if (ret < 0)
+			return ret;
+	}
+	for (i = 0; i < n_servers; i++) {
+		ret = ctrl_recv_start(config, &config->servers[i]);
+		if (ret < 0)
+			return ret;
+	}
 
 	return 0;
 }
@@ -213,7 +488,9 @@ static int alloc_buffers(struct client_config *config)
 	page_size = sysconf(_SC_PAGESIZE);
 	if (page_size < 0)
 		return -EFAULT;
-	config->buff_size = ROUND_UP(config->msg_size, page_size);
+	config->buff_size = ROUND_UP(config->msg_size > config->resp_size ?
+				     config->msg_size : config->resp_size,
+				     page_size);
 	config->buffers_size = config->n_threads * config->buff_size;
 	config->buffers_size +=
 		ROUND_UP(config->n_threads * sizeof(struct client_worker_data),
@@ -235,12 +512,31 @@ static int alloc_buffers(struct client_config *config)
 	return ret;
 }
 
+static uint64_t pace_conn_rate(const struct client_config *config)
+{
+	if (!config->pace_total)
+		return config->pace_rate;
+	return (config->pace_rate + config->n_threads - 1) / config->n_threads;
+}
+
+/* threads are assigned to --cc list entries round robin */
+static struct cc_group *cc_thread_group(struct client_config *config,
+					unsigned int i)
+{
+	if (!config->n_cc_slots)
+		return NULL;
+	return &config->cc_groups[config->cc_slots[i % config->n_cc_slots]];
+}
+
 static int prepare_buffers(struct client_config *config)
 {
+	struct cc_group *group;
 	unsigned int i;
 
 	memset(config->workers_data, '\0',
 	       config->n_threads * sizeof(struct client_worker_data));
+	for (i = 0; i < config->n_cc_groups; i++)
+		config->cc_groups[i].n_threads = 0;
 
 	for (i = 0; i < config->n_threads; i++) {
 		struct client_worker_data *wdata = &config->workers_data[i];
@@ -248,7 +544,22 @@ static int prepare_buffers(struct client_config *config)
 		wdata->id = i;
 		wdata->buff = config->buffers + i * config->buff_size;
 		wdata->msg_size = config->msg_size;
+		wdata->resp_size = config->resp_size;
+		wdata->msg_dist = config->msg_dist.n ? &config->msg_dist : NULL;
+		wdata->size_seed = config->size_seed;
+		wdata->verify = config->verify;
+		wdata->addr =
+			&config->servers[thread_server(config, i)].test_addr;
+		group = cc_thread_group(config, i);
+		if (group) {
+			wdata->congestion = group->name;
+			group->n_threads++;
+		}
+		wdata->pace_rate = pace_conn_rate(config);
+		wdata->pace_kernel = config->pace_kernel;
 		wdata->reply = (config->test_mode == MODE_TCP_RR);
+		wdata->perf = config->perf_counters;
+		wdata->latency = config->latency;
 	}
 
 	return 0;
@@ -287,6 +598,8 @@ static void kill_workers(struct client_config *config)
 
 	for (i = 0; i < config->n_threads; i++)
 		config->workers_data[i].test_finished = 1;
+	/* release workers still waiting for test start (if connect failed) */
+	wsync_set_state(&client_worker_sync, WS_RUN);
 	for (i = 0; i < config->n_threads; i++)
 		pthread_kill(config->workers_data[i].tid, SIGUSR1);
 	for (i = 0; i < config->n_threads; i++)
@@ -295,77 +608,384 @@ static void kill_workers(struct client_config *config)
 
 static int connect_workers(struct client_config *config)
 {
+	unsigned int n_failed = 0;
+	struct timespec ts0, ts1;
+	int err = 0;
+	unsigned int i;
+	int ret;
+
+	ret = clock_gettime(CLOCK_MONOTONIC, &ts0);
+	if (ret < 0)
+		return -errno;
 	wsync_reset_counter(&client_worker_sync);
 	wsync_set_state(&client_worker_sync, WS_CONNECT);
 	wsync_wait_for_counter(&client_worker_sync, config->n_threads);
+	ret = clock_gettime(CLOCK_MONOTONIC, &ts1);
+	if (ret < 0)
+		return -errno;
+
+	config->connect_time = (ts1.tv_sec - ts0.tv_sec) +
+			       1E-9 * (ts1.tv_nsec - ts0.tv_nsec);
+
+	for (i = 0; i < config->n_threads; i++) {
+		ret = config->workers_data[i].connect_status;
+		if (ret < 0) {
+			n_failed++;
+			err = ret;
+		}
+	}
+	if (n_failed) {
+		fprintf(stderr, "%u of %u connections failed: %s\n", n_failed,
+			config->n_threads, strerror(-err));
+		return err;
+	}
+
+	return 0;
+}
+
+/* Amount of work done by client workers so far: bytes sent (TCP_STREAM)
+ * or transactions completed (TCP_RR). Read while the workers are running.
+ */
+static uint64_t client_progress(struct client_config *config)
+{
+	uint64_t sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < config->n_threads; i++) {
+		struct xfer_stats *stats = &config->workers_data[i].stats;
+
+		if (config->workers_data[i].reply)
+			sum += __atomic_load_n(&stats->rx.msgs,
+					       __ATOMIC_RELAXED);
+		else
+			sum += __atomic_load_n(&stats->tx.bytes,
+					       __ATOMIC_RELAXED);
+	}
+
+	return sum;
+}
+
+/* per interval rates seen so far in current iteration */
+struct converge_state {
+	uint64_t	last;
+	struct timespec	last_ts;
+	unsigned int	seen;
+	unsigned int	n;
+	double		sum;
+	double		sum_sqr;
+};
+
+/* Add the rate over the last interval and check if confidence interval of
+ * the mean interval rate is narrow enough. First intervals are ignored
+ * (slow start, connections not all running yet).
+ */
+static bool converge_check(struct client_config *config,
+			   struct converge_state *cs)
+{
+	struct timespec now;
+	uint64_t progress;
+	double rate, dt;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	progress = client_progress(config);
+	dt = timespec_diff(&cs->last_ts, &now);
+	if (dt <= 0)
+		return false;
+	rate = (progress - cs->last) / dt;
+	cs->last = progress;
+	cs->last_ts = now;
+	if (++cs->seen <= CONVERGE_WARMUP)
+		return false;
+
+	cs->sum += rate;
+	cs->sum_sqr += rate * rate;
+	cs->n++;
+	if (cs->n < CONVERGE_MIN_SAMPLES || cs->sum <= 0)
+		return false;
+	return confid_interval(cs->sum, cs->sum_sqr, cs->n,
+			       config->confid_level) / (cs->sum / cs->n) <=
+	       config->converge;
+}
+
+/* Sleep until the end of the test, checking throughput convergence at
+ * requested intervals; the test ends as soon as the rate is stable.
+ */
+static int test_loop(struct client_config *config,
+		     const struct timespec *start)
+{
+	struct timespec next_conv = *start;
+	struct converge_state cs = { .last_ts = *start };
+	struct timespec end = *start, next;
+	int ret;
+
+	end.tv_sec += config->test_length;
+	timespec_add_msec(&next_conv, config->converge_interval);
+	for (;;) {
+		next = end;
+		if (timespec_cmp(&next_conv, &next) < 0)
+			next = next_conv;
+		do
+			ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+					      &next, NULL);
+		while (ret == EINTR);
+		if (ret)
+			return -ret;
+		if (timespec_cmp(&next, &end) >= 0)
+			break;
+
+		if (timespec_cmp(&next_conv, &next) <= 0) {
+			if (converge_check(config, &cs)) {
+				config->converged = true;
+				break;
+			}
+			timespec_add_msec(&next_conv, config->converge_interval);
+		}
+	}
 
 	return 0;
 }
 
 static int run_test(struct client_config *config)
 {
+	struct cpu_sample cpu0 = {}, cpu1 = {};
 	struct timespec ts0, ts1;
 	int ret;
 
+	cpu_sample_read(&cpu0);
+	config->net_delta.n = 0;
+	if (config->net_counters)
+		net_counters_read(&config->net_start);
 	wsync_reset_counter(&client_worker_sync);
 	wsync_set_state(&client_worker_sync, WS_RUN);
 
 	ret = clock_gettime(CLOCK_MONOTONIC, &ts0);
 	if (ret < 0)
 		return -errno;
-	ret = wsync_sleep(&client_worker_sync, config->test_length);
+	config->converged = false;
+	if (config->coord_sd >= 0)
+		ret = coord_wait_stop(config);
+	else if (config->converge > 0)
+		ret = test_loop(config, &ts0);
+	else
+		ret = wsync_sleep(&client_worker_sync, config->test_length);
 	if (ret < 0)
 		return ret;
 	kill_workers(&client_config);
 	ret = clock_gettime(CLOCK_MONOTONIC, &ts1);
 	if (ret < 0)
 		return -errno;
-
-	config->elapsed = (ts1.tv_sec - ts0.tv_sec) +
-			  1E-9 * (ts1.tv_nsec - ts0.tv_nsec);
+	cpu_sample_read(&cpu1);
+	cpu_usage_delta(&cpu0, &cpu1, &config->cpu_usage);
+	if (config->net_counters &&
+	    net_counters_read(&config->net_end) == 0)
+		net_counters_delta(&config->net_start, &config->net_end,
+				   &config->net_delta);
+
+	config->elapsed = timespec_diff(&ts0, &ts1);
 	return 0;
 }
 
-static int worker_by_port(struct client_config *config, uint16_t port)
+/* local ports are only unique among connections to one server */
+static int worker_by_port(struct client_config *config, unsigned int server,
+			  uint16_t port)
 {
 	unsigned int i;
 
-	for (i = 0; i < config->n_threads; i++)
+	for (i = server; i < config->n_threads; i += config->n_servers)
 		if (config->workers_data[i].client_port == port)
 			return i;
 
 	return -1;
 }
 
-static struct xfer_stats *recv_server_stats(struct client_config *config)
+/* counters of all servers are summed up by name */
+static int recv_net_counter(struct client_config *config,
+			    const struct ctrl_attr *attr, unsigned int hint)
 {
-	struct server_thread_info tinfo;
-	struct xfer_stats *server_stats;
-	struct server_end_msg msg;
-	unsigned int i;
+	struct net_counters *delta = &config->server_net_delta;
+	const struct net_counter *found;
+	struct net_counter cnt;
 	int ret;
 
-	server_stats = calloc(config->n_threads, sizeof(server_stats[0]));
-	if (!server_stats)
-		return NULL;
-	ret = ctrl_recv_msg(config->ctrl_sd, &msg, sizeof(msg));
-	if (ret < 0 || ntohl(msg.status) ||
-	    ntohl(msg.thread_length) != sizeof(tinfo) ||
-	    ntohl(msg.n_threads) != config->n_threads)
-		goto err;
+	if (ctrl_attr_struct(attr, &cnt, sizeof(cnt)) < 0)
+		return 0;
+	cnt.name[sizeof(cnt.name) - 1] = '\0';
+	cnt.value = ntoh64(cnt.value);
+	found = net_counters_find(delta, cnt.name, hint);
+	if (found) {
+		delta->counters[found - delta->counters].value += cnt.value;
+		return 0;
+	}
+	if (delta->n >= MAX_NET_COUNTERS)
+		return -EPROTO;
+	ret = net_counters_reserve(delta, delta->n + 1);
+	if (ret < 0)
+		return ret;
+	delta->counters[delta->n++] = cnt;
 
-	for (i = 0; i < config->n_threads; i++) {
-		int local_idx;
+	return 0;
+}
 
-		ret = recv_block(config->ctrl_sd, &tinfo, sizeof(tinfo));
-		if (ret < 0)
-			goto err;
-		local_idx = worker_by_port(config, ntohs(tinfo.client_port));
-		if (local_idx < 0)
-			goto err;
-		xfer_stats_ntoh(&tinfo.stats, &server_stats[local_idx]);
+/* index counts server side options in command line order */
+static void recv_sockopt_value(struct client_config *config,
+			       const struct ctrl_attr *attr)
+{
+	struct ctrl_sockopt_value val;
+	unsigned int i, index;
+
+	if (ctrl_attr_struct(attr, &val, sizeof(val)) < 0)
+		return;
+	index = ntohl(val.index);
+	for (i = 0; i < config->n_sockopts; i++) {
+		if (!config->sockopts[i].server)
+			continue;
+		if (!index--) {
+			config->sockopts[i].server_value = ntohl(val.value);
+			return;
+		}
+	}
+}
+
+/* Metrics of unexpected size (e.g. from a newer server) are left zero. */
+static int recv_server_thread(struct client_config *config,
+			      unsigned int server, const struct ctrl_attr *nest,
+			      struct server_thread_stats *server_stats)
+{
+	struct server_thread_stats st = {};
+	const struct ctrl_attr *attr;
+	struct tcpinfo_stats tcpinfo;
+	struct ctrl_service_stats svc;
+	struct ctrl_attr_iter it;
+	struct ctrl_verify verify;
+	struct perf_stats perf;
+	struct xfer_stats xfer;
+	uint32_t port = 0;
+	int idx;
+
+	ctrl_iter_nested(&it, nest);
+	while ((attr = ctrl_iter_next(&it))) {
+		switch (ctrl_attr_type(attr)) {
+		case CA_T_CLIENT_PORT:
+			ctrl_attr_u32(attr, &port);
+			break;
+		case CA_T_XFER:
+			if (ctrl_attr_struct(attr, &xfer, sizeof(xfer)) == 0)
+				xfer_stats_ntoh(&xfer, &st.xfer);
+			break;
+		case CA_T_CPU_USEC:
+			ctrl_attr_u64(attr, &st.cpu_usec);
+			break;
+		case CA_T_PERF:
+			if (ctrl_attr_struct(attr, &perf, sizeof(perf)) == 0)
+				perf_stats_ntoh(&perf, &st.perf);
+			break;
+		case CA_T_TCP_INFO:
+			if (ctrl_attr_struct(attr, &tcpinfo,
+					     sizeof(tcpinfo)) == 0)
+				tcpinfo_stats_ntoh(&tcpinfo, &st.tcpinfo);
+			break;
+		case CA_T_VERIFY:
+			if (ctrl_attr_struct(attr, &verify,
+					     sizeof(verify)) == 0) {
+				st.verify_errors = ntoh64(verify.errors);
+				st.verify_usec = ntoh64(verify.usec);
+			}
+			break;
+		case CA_T_SERVICE:
+			if (ctrl_attr_struct(attr, &svc, sizeof(svc)) == 0) {
+				st.service_count = ntoh64(svc.count);
+				st.service_nsec = ntoh64(svc.nsec);
+				st.service_max_nsec = ntoh64(svc.max_nsec);
+			}
+			break;
+		}
+	}
+	if (it.error)
+		return it.error;
+	idx = (port <= UINT16_MAX) ? worker_by_port(config, server, port) : -1;
+	if (idx < 0)
+		return -EPROTO;
+	server_stats[idx] = st;
+
+	return 0;
+}
+
+/* Results of one server: setup time is the slowest server's, CPU usage and
+ * network counters are summed over servers.
+ */
+static int recv_server_end(struct client_config *config, unsigned int server,
+			   struct server_thread_stats *server_stats)
+{
+	struct server_target *srv = &config->servers[server];
+	struct cpu_usage *cpu_usage = &config->server_cpu_usage;
+	unsigned int n_threads = 0, n_counters = 0;
+	const struct ctrl_attr *attr;
+	struct ctrl_cpu_usage cpu;
+	struct ctrl_attr_iter it;
+	uint32_t status = 0;
+	uint32_t setup_usec;
+	int ret;
+
+	ret = ctrl_recv_reply(config, srv, CTRL_MSG_END);
+	if (ret < 0)
+		return ret;
+	ctrl_iter_msg(&it, &srv->msg);
+	while (ret == 0 && (attr = ctrl_iter_next(&it))) {
+		switch (ctrl_attr_type(attr)) {
+		case CA_STATUS:
+			ret = ctrl_attr_u32(attr, &status);
+			break;
+		case CA_SETUP_USEC:
+			if (ctrl_attr_u32(attr, &setup_usec) == 0 &&
+			    1E-6 * setup_usec > config->server_setup_time)
+				config->server_setup_time = 1E-6 * setup_usec;
+			break;
+		case CA_CPU_USAGE:
+			if (ctrl_attr_struct(attr, &cpu, sizeof(cpu)) < 0)
+				break;
+			cpu_usage->n_cpus += ntohl(cpu.n_cpus);
+			cpu_usage->busy_usec += ntoh64(cpu.busy_usec);
+			cpu_usage->total_usec += ntoh64(cpu.total_usec);
+			break;
+		case CA_THREAD:
+			ret = recv_server_thread(config, server, attr,
+						 server_stats);
+			n_threads++;
+			break;
+		case CA_NET_COUNTER:
+			ret = recv_net_counter(config, attr, n_counters++);
+			break;
+		case CA_SOCKOPT_VALUE:
+			recv_sockopt_value(config, attr);
+			break;
+		}
 	}
+	if (ret == 0)
+		ret = it.error;
+	if (ret == 0 && (status || n_threads != srv->n_threads))
+		ret = -EPROTO;
+
+	return ret;
+}
 
+static struct server_thread_stats *
+recv_server_stats(struct client_config *config)
+{
+	struct server_thread_stats *server_stats;
+	unsigned int i;
+	int ret = 0;
+
+	server_stats = calloc(config->n_threads, sizeof(server_stats[0]));
+	if (!server_stats)
+		return NULL;
+	config->server_setup_time = 0.0;
+	memset(&config->server_cpu_usage, '\0',
+	       sizeof(config->server_cpu_usage));
+	config->server_net_delta.n = 0;
+	for (i = 0; i < config->n_servers && ret == 0; i++)
+		ret = recv_server_end(config, i, server_stats);
+	if (ret < 0)
+		goto err;
 
 	return server_stats;
 err:
@@ -374,79 +994,986 @@ err:
 	return NULL;
 }
 
-static int collect_stats(struct client_config *config, double *iter_result)
+/* non-zero counter differences on both sides, client ones first */
+static void print_net_counters(struct client_config *config)
 {
-	bool show_thread = config->stats_mask & STATS_F_THREAD;
-	bool show_raw = config->stats_mask & STATS_F_RAW;
-	unsigned int n_threads = config->n_threads;
-	unsigned int test_mode = config->test_mode;
-	struct xfer_stats sum_client, sum_server;
-	double result, sum_rslt, sum_rslt_sqr;
-	double elapsed = config->elapsed;
-	struct xfer_stats *server_stats;
+	const struct net_counters *client = &config->net_delta;
+	const struct net_counters *server = &config->server_net_delta;
+	const struct net_counter *cnt;
 	unsigned int i;
 
-	server_stats = recv_server_stats(config);
-	if (!server_stats)
-		return -EFAULT;
-	if (show_thread || show_raw)
-		printf("test time: %.3lf\n\n", elapsed);
-
-	/* raw stats */
-	xfer_stats_reset(&sum_client);
-	if (show_raw)
-		xfer_stats_raw_header("client");
-	for (i = 0; i < n_threads; i++) {
-		const struct xfer_stats *wstats =
-			&config->workers_data[i].stats;
-
-		if (show_raw)
-			xfer_stats_print_raw(wstats, i);
-		xfer_stats_add(&sum_client, wstats);
+	if (!client->n && !server->n)
+		return;
+	printf("%-40s %14s %14s\n", "network counters", "client", "server");
+	for (i = 0; i < client->n; i++) {
+		cnt = net_counters_find(server, client->counters[i].name, i);
+		printf("%-40s %14" PRId64, client->counters[i].name,
+		       client->counters[i].value);
+		if (cnt)
+			printf(" %14" PRId64 "\n", cnt->value);
+		else
+			printf(" %14s\n", "-");
 	}
-	if (show_raw) {
-		xfer_stats_print_raw(&sum_client, XFER_STATS_TOTAL);
-		putchar('\n');
+	for (i = 0; i < server->n; i++) {
+		if (net_counters_find(client, server->counters[i].name, i))
+			continue;
+		printf("%-40s %14s %14" PRId64 "\n", server->counters[i].name,
+		       "-", server->counters[i].value);
 	}
+	putchar('\n');
+}
 
-	xfer_stats_reset(&sum_server);
-	if (show_raw)
-		xfer_stats_raw_header("server");
-	for (i = 0; i < n_threads; i++) {
-		if (show_raw)
-			xfer_stats_print_raw(&server_stats[i], i);
-		xfer_stats_add(&sum_server, &server_stats[i]);
-	}
-	if (show_raw) {
-		xfer_stats_print_raw(&sum_server, XFER_STATS_TOTAL);
-		putchar('\n');
-	}
+static void print_connect_stats(struct client_config *config)
+{
+	unsigned int n_threads = config->n_threads;
+	unsigned int n_retried = 0;
+	uint64_t retries = 0;
+	double *latencies;
+	unsigned int i;
 
-	/* thread stats */
-	sum_rslt = sum_rslt_sqr = 0.0;
+	latencies = calloc(n_threads, sizeof(latencies[0]));
+	if (!latencies)
+		return;
 	for (i = 0; i < n_threads; i++) {
-		result = xfer_stats_result(&config->workers_data[i].stats,
-					   &server_stats[i], test_mode,
-					   elapsed);
-		sum_rslt += result;
-		sum_rslt_sqr += result * (double)result;
+		const struct client_worker_data *wdata =
+			&config->workers_data[i];
 
-		if (show_thread)
-			xfer_stats_print_thread(&config->workers_data[i].stats,
-						&server_stats[i], i, test_mode,
-						elapsed, &config->print_opts);
+		latencies[i] = wdata->connect_latency;
+		retries += wdata->connect_retries;
+		if (wdata->connect_retries)
+			n_retried++;
 	}
-	free(server_stats);
+	connect_stats_print(latencies, n_threads, retries, n_retried);
+	putchar('\n');
+	free(latencies);
+}
 
-	if (show_thread) {
+static void print_cpu_stats(struct client_config *config,
+			    const struct server_thread_stats *server_stats)
+{
+	uint64_t sum_client = 0, sum_server = 0;
+	unsigned int i;
+
+	for (i = 0; i < config->n_threads; i++) {
+		uint64_t client_usec = config->workers_data[i].cpu_usec;
+		uint64_t server_usec = server_stats[i].cpu_usec;
+
+		cpu_stats_print_thread(client_usec, server_usec, i,
+				       config->elapsed);
+		sum_client += client_usec;
+		sum_server += server_usec;
+	}
+	cpu_stats_print_thread(sum_client, sum_server, XFER_STATS_TOTAL,
+			       config->elapsed);
+	cpu_stats_print_system(&config->cpu_usage, &config->server_cpu_usage);
+	putchar('\n');
+}
+
+static void print_tcpinfo_stats(struct client_config *config,
+				const struct server_thread_stats *server_stats)
+{
+	struct tcpinfo_stats sum;
+	unsigned int i;
+
+	tcpinfo_stats_reset(&sum);
+	tcpinfo_stats_header("client");
+	for (i = 0; i < config->n_threads; i++) {
+		tcpinfo_stats_print(&config->workers_data[i].tcpinfo, i);
+		tcpinfo_stats_add(&sum, &config->workers_data[i].tcpinfo);
+	}
+	tcpinfo_stats_print(&sum, XFER_STATS_TOTAL);
+	putchar('\n');
+
+	if (!servers_cap(config, CTRL_CAP_TCP_INFO))
+		return;
+	tcpinfo_stats_reset(&sum);
+	tcpinfo_stats_header("server");
+	for (i = 0; i < config->n_threads; i++) {
+		tcpinfo_stats_print(&server_stats[i].tcpinfo, i);
+		tcpinfo_stats_add(&sum, &server_stats[i].tcpinfo);
+	}
+	tcpinfo_stats_print(&sum, XFER_STATS_TOTAL);
+	putchar('\n');
+}
+
+static void print_perf_stats(struct client_config *config,
+			     const struct server_thread_stats *server_stats,
+			     const struct xfer_stats *sum_client,
+			     const struct xfer_stats *sum_server)
+{
+	bool show_server = servers_cap(config, CTRL_CAP_PERF_COUNTERS);
+	struct perf_stats sum_cperf, sum_sperf;
+	unsigned int i;
+	double units;
+
+	perf_stats_reset(&sum_cperf, true);
+	perf_stats_header("client");
+	for (i = 0; i < config->n_threads; i++) {
+		const struct perf_stats *pstats =
+			&config->workers_data[i].perf_stats;
+
+		perf_stats_print(pstats, i);
+		perf_stats_add(&sum_cperf, pstats);
+	}
+	perf_stats_print(&sum_cperf, XFER_STATS_TOTAL);
+	putchar('\n');
+
+	if (show_server) {
+		perf_stats_reset(&sum_sperf, true);
+		perf_stats_header("server");
+		for (i = 0; i < config->n_threads; i++) {
+			perf_stats_print(&server_stats[i].perf, i);
+			perf_stats_add(&sum_sperf, &server_stats[i].perf);
+		}
+		perf_stats_print(&sum_sperf, XFER_STATS_TOTAL);
+		putchar('\n');
+	}
+
+	units = xfer_stats_units(sum_client, sum_server, config->test_mode);
+	perf_stats_print_per_unit("client", &sum_cperf, units,
+				  &config->print_opts);
+	if (show_server)
+		perf_stats_print_per_unit("server", &sum_sperf, units,
+					  &config->print_opts);
+	putchar('\n');
+}
+
+static void verify_result_setup(struct client_config *config,
+				const struct server_thread_stats *server_stats)
+{
+	struct verify_result *vr = &config->verify_iter;
+	struct verify_result *total = &config->verify_total;
+	unsigned int i;
+
+	memset(vr, '\0', sizeof(*vr));
+	for (i = 0; i < config->n_threads; i++) {
+		const struct client_worker_data *wdata =
+			&config->workers_data[i];
+
+		vr->client_errors += wdata->verify_errors;
+		vr->client_usec += wdata->verify_nsec / 1000;
+		vr->server_errors += server_stats[i].verify_errors;
+		vr->server_usec += server_stats[i].verify_usec;
+	}
+	vr->worker_usec = 1E6 * config->elapsed * config->n_threads;
+
+	total->client_errors += vr->client_errors;
+	total->server_errors += vr->server_errors;
+	total->client_usec += vr->client_usec;
+	total->server_usec += vr->server_usec;
+	total->worker_usec += vr->worker_usec;
+}
+
+/* Share of test time workers spent checksumming, i.e. throughput lost to
+ * verification if the test is bound by worker threads.
+ */
+static void print_verify_result(const char *label,
+				const struct verify_result *vr)
+{
+	double worker_usec = vr->worker_usec ? vr->worker_usec : 1;
+
+	printf("%-15s crc32c (%s), mismatches client %" PRIu64
+	       ", server %" PRIu64 "\n",
+	       label, crc32c_impl(), vr->client_errors, vr->server_errors);
+	printf("                checksum time client %.1lf ms (%.1lf%%), server %.1lf ms (%.1lf%%) of worker time\n",
+	       vr->client_usec / 1000.0, 100.0 * vr->client_usec / worker_usec,
+	       vr->server_usec / 1000.0, 100.0 * vr->server_usec / worker_usec);
+}
+
+/* per thread mismatches, only threads with any */
+static void print_verify_threads(struct client_config *config,
+				 const struct server_thread_stats *server_stats)
+{
+	unsigned int i;
+
+	for (i = 0; i < config->n_threads; i++) {
+		uint64_t client = config->workers_data[i].verify_errors;
+		uint64_t server = server_stats[i].verify_errors;
+
+		if (client || server)
+			printf("thread %-3u      mismatches client %" PRIu64
+			       ", server %" PRIu64 "\n", i, client, server);
+	}
+}
+
+/* requested mean service time in ns, 0 if not a time */
+static double service_mean_nsec(const struct client_config *config)
+{
+	switch (config->service_type) {
+	case SERVICE_SPIN:
+	case SERVICE_EXP:
+		return config->service_arg1;
+	case SERVICE_UNIFORM:
+		return (config->service_arg1 + (double)config->service_arg2) / 2;
+	default:
+		return 0.0;
+	}
+}
+
+static void print_service_time(const struct client_config *config,
+			       uint64_t count, uint64_t nsec, uint64_t max_nsec)
+{
+	double requested = service_mean_nsec(config);
+
+	printf("service time    %s", config->service_spec);
+	if (requested > 0)
+		printf(", requested mean %.2lf us", requested / 1000);
+	if (count)
+		printf(", achieved mean %.2lf us, max %.2lf us\n",
+		       (double)nsec / count / 1000, max_nsec / 1000.0);
+	else
+		fputs(", no requests\n", stdout);
+}
+
+static void json_service_time(const struct client_config *config,
+			      uint64_t count, uint64_t nsec, uint64_t max_nsec)
+{
+	json_object_start(&json, "service_time");
+	json_string(&json, "spec", config->service_spec);
+	if (service_mean_nsec(config) > 0)
+		json_double(&json, "requested_usec",
+			    service_mean_nsec(config) / 1000);
+	json_uint(&json, "requests", count);
+	if (count) {
+		json_double(&json, "avg_usec", (double)nsec / count / 1000);
+		json_double(&json, "max_usec", max_nsec / 1000.0);
+	}
+	json_object_end(&json);
+}
+
+static void pace_result_setup(struct client_config *config)
+{
+	double target = pace_conn_rate(config) * config->elapsed;
+	struct pace_result *pr = &config->pace_iter;
+	struct pace_result *sum = &config->pace_sum;
+	unsigned int i;
+
+	memset(pr, '\0', sizeof(*pr));
+	pr->elapsed = config->elapsed;
+	for (i = 0; i < config->n_threads; i++) {
+		const struct client_worker_data *wdata =
+			&config->workers_data[i];
+		double ratio = wdata->stats.tx.bytes / target;
+
+		pr->bytes += wdata->stats.tx.bytes;
+		if (!i || ratio < pr->min_ratio)
+			pr->min_ratio = ratio;
+		if (!i || ratio > pr->max_ratio)
+			pr->max_ratio = ratio;
+		pr->sends += wdata->pace_sends;
+		pr->ival_sum += wdata->pace_ival_sum;
+		pr->ival_sum_sqr += wdata->pace_ival_sum_sqr;
+	}
+
+	if (!sum->elapsed || pr->min_ratio < sum->min_ratio)
+		sum->min_ratio = pr->min_ratio;
+	if (!sum->elapsed || pr->max_ratio > sum->max_ratio)
+		sum->max_ratio = pr->max_ratio;
+	sum->bytes += pr->bytes;
+	sum->elapsed += pr->elapsed;
+	sum->sends += pr->sends;
+	sum->ival_sum += pr->ival_sum;
+	sum->ival_sum_sqr += pr->ival_sum_sqr;
+}
+
+static void print_pace_result(const struct client_config *config,
+			      const struct pace_result *pr)
+{
+	double target = (double)pace_conn_rate(config) * config->n_threads;
+	double achieved = pr->bytes / pr->elapsed;
+	struct print_options opts = config->print_opts;
+
+	fputs("pacing          target ", stdout);
+	print_rate(target, &opts);
+	printf(" (%s), achieved ", config->pace_kernel ? "kernel" : "user");
+	print_rate(achieved, &opts);
+	printf(" (%.1lf%%), threads %.1lf%% - %.1lf%%\n",
+	       100.0 * achieved / target, 100.0 * pr->min_ratio,
+	       100.0 * pr->max_ratio);
+	if (pr->sends > 1)
+		printf("                send interval mean %.1lf us, jitter (sdev) %.1lf us\n",
+		       pr->ival_sum / pr->sends / 1000,
+		       sdev_n1(pr->ival_sum, pr->ival_sum_sqr, pr->sends) /
+		       1000);
+}
+
+static void json_pace_result(const struct client_config *config,
+			     const struct pace_result *pr)
+{
+	json_object_start(&json, "pacing");
+	json_string(&json, "mode", config->pace_kernel ? "kernel" : "user");
+	json_uint(&json, "target_per_conn", pace_conn_rate(config));
+	json_double(&json, "achieved", pr->bytes / pr->elapsed);
+	json_double(&json, "thread_min_ratio", pr->min_ratio);
+	json_double(&json, "thread_max_ratio", pr->max_ratio);
+	if (pr->sends > 1) {
+		json_double(&json, "send_interval_usec",
+			    pr->ival_sum / pr->sends / 1000);
+		json_double(&json, "send_jitter_usec",
+			    sdev_n1(pr->ival_sum, pr->ival_sum_sqr,
+				    pr->sends) / 1000);
+	}
+	json_object_end(&json);
+}
+
+/* Throughput of each congestion control group and its share of the total;
+ * with n_iter > 0 averages over all iterations are shown.
+ */
+static void print_cc_result(const struct client_config *config,
+			    unsigned int n_iter)
+{
+	const struct print_options *opts = &config->print_opts;
+	double total = 0.0;
+	unsigned int i;
+
+	for (i = 0; i < config->n_cc_groups; i++)
+		total += n_iter ? config->cc_groups[i].result_sum :
+				  config->cc_groups[i].result;
+	for (i = 0; i < config->n_cc_groups; i++) {
+		const struct cc_group *group = &config->cc_groups[i];
+		double result = n_iter ? group->result_sum : group->result;
+
+		if (!group->n_threads)
+			continue;
+		printf("congestion      %-15s %4u threads ", group->name,
+		       group->n_threads);
+		print_rate(n_iter ? result / n_iter : result, opts);
+		printf(" share %5.1lf%% (fair %5.1lf%%)\n",
+		       total > 0 ? 100.0 * result / total : 0.0,
+		       100.0 * group->n_threads / config->n_threads);
+	}
+}
+
+static void json_cc_result(const struct client_config *config,
+			   unsigned int n_iter)
+{
+	double total = 0.0;
+	unsigned int i;
+
+	for (i = 0; i < config->n_cc_groups; i++)
+		total += n_iter ? config->cc_groups[i].result_sum :
+				  config->cc_groups[i].result;
+	json_array_start(&json, "congestion");
+	for (i = 0; i < config->n_cc_groups; i++) {
+		const struct cc_group *group = &config->cc_groups[i];
+		double result = n_iter ? group->result_sum : group->result;
+
+		if (!group->n_threads)
+			continue;
+		json_object_start(&json, NULL);
+		json_string(&json, "algorithm", group->name);
+		json_uint(&json, "threads", group->n_threads);
+		json_double(&json, "result", n_iter ? result / n_iter : result);
+		json_double(&json, "share", total > 0 ? result / total : 0.0);
+		json_object_end(&json);
+	}
+	json_array_end(&json);
+}
+
+/* Client side result of threads of each server, as print_cc_result(). */
+static void print_server_result(const struct client_config *config,
+				unsigned int n_iter)
+{
+	const struct print_options *opts = &config->print_opts;
+	double total = 0.0;
+	unsigned int i;
+
+	for (i = 0; i < config->n_servers; i++)
+		total += n_iter ? config->servers[i].result_sum :
+				  config->servers[i].result;
+	for (i = 0; i < config->n_servers; i++) {
+		const struct server_target *srv = &config->servers[i];
+		double result = n_iter ? srv->result_sum : srv->result;
+
+		printf("server          %-15s %4u threads ", srv->host,
+		       srv->n_threads);
+		print_rate(n_iter ? result / n_iter : result, opts);
+		printf(" share %5.1lf%%\n",
+		       total > 0 ? 100.0 * result / total : 0.0);
+	}
+}
+
+static void json_server_result(const struct client_config *config,
+			       unsigned int n_iter)
+{
+	double total = 0.0;
+	unsigned int i;
+
+	for (i = 0; i < config->n_servers; i++)
+		total += n_iter ? config->servers[i].result_sum :
+				  config->servers[i].result;
+	json_array_start(&json, "servers");
+	for (i = 0; i < config->n_servers; i++) {
+		const struct server_target *srv = &config->servers[i];
+		double result = n_iter ? srv->result_sum : srv->result;
+
+		json_object_start(&json, NULL);
+		json_string(&json, "host", srv->host);
+		json_uint(&json, "threads", srv->n_threads);
+		json_double(&json, "result", n_iter ? result / n_iter : result);
+		json_double(&json, "share", total > 0 ? result / total : 0.0);
+		json_object_end(&json);
+	}
+	json_array_end(&json);
+}
+
+static void json_fairness(const struct fairness *fair)
+{
+	json_object_start(&json, "fairness");
+	json_double(&json, "jain", fair->jain);
+	json_double(&json, "min", fair->min);
+	json_uint(&json, "min_thread", fair->min_thread);
+	json_double(&json, "max", fair->max);
+	json_uint(&json, "max_thread", fair->max_thread);
+	json_double(&json, "max_min_ratio", fairness_ratio(fair));
+	json_object_end(&json);
+}
+
+/* least squares slope of Jain's index over iterations */
+static double fairness_trend(unsigned int n_iter)
+{
+	double x_mean = (n_iter - 1) / 2.0;
+	double y_mean = 0.0, sxy = 0.0, sxx = 0.0;
+	unsigned int i;
+
+	if (n_iter < 2)
+		return 0.0;
+	for (i = 0; i < n_iter; i++)
+		y_mean += iter_fairness[i].jain;
+	y_mean /= n_iter;
+	for (i = 0; i < n_iter; i++) {
+		sxy += (i - x_mean) * (iter_fairness[i].jain - y_mean);
+		sxx += (i - x_mean) * (i - x_mean);
+	}
+
+	return sxy / sxx;
+}
+
+static unsigned int fairness_worst(unsigned int n_iter)
+{
+	unsigned int i, worst = 0;
+
+	for (i = 1; i < n_iter; i++)
+		if (iter_fairness[i].jain < iter_fairness[worst].jain)
+			worst = i;
+	return worst;
+}
+
+static void print_fairness_summary(const struct client_config *config,
+				   unsigned int n_iter)
+{
+	unsigned int worst = fairness_worst(n_iter);
+
+	printf("fairness        Jain's index avg %.4lf, worst %.4lf (iteration %u, max/min %.2lf)",
+	       config->result_jain, iter_fairness[worst].jain, worst + 1,
+	       fairness_ratio(&iter_fairness[worst]));
+	if (n_iter > 1)
+		printf(", trend %+.4lf/iteration", fairness_trend(n_iter));
+	putchar('\n');
+}
+
+static void json_fairness_summary(const struct client_config *config,
+				  unsigned int n_iter)
+{
+	unsigned int worst = fairness_worst(n_iter);
+	unsigned int i;
+
+	json_object_start(&json, "fairness");
+	json_double(&json, "jain_avg", config->result_jain);
+	json_double(&json, "jain_worst", iter_fairness[worst].jain);
+	json_uint(&json, "worst_iteration", worst + 1);
+	json_double(&json, "trend", fairness_trend(n_iter));
+	json_array_start(&json, "jain");
+	for (i = 0; i < n_iter; i++)
+		json_double(&json, NULL, iter_fairness[i].jain);
+	json_array_end(&json);
+	json_object_end(&json);
+}
+
+/* requested vs. effective (read back) values of -O options */
+static void print_sockopts(const struct client_config *config)
+{
+	const struct sockopt_req *req;
+	char name[64];
+	unsigned int i;
+
+	printf("%-32s %12s %12s %12s\n", "socket option", "requested",
+	       "client", "server");
+	for (i = 0; i < config->n_sockopts; i++) {
+		req = &config->sockopts[i];
+		sockopt_format(&req->opt, name, sizeof(name));
+		printf("%-32s %12d ", name, req->opt.value);
+		if (req->client)
+			printf("%12d ", req->client_value);
+		else
+			printf("%12s ", "-");
+		if (req->server)
+			printf("%12d\n", req->server_value);
+		else
+			printf("%12s\n", "-");
+	}
+}
+
+static void json_sockopts(const struct client_config *config)
+{
+	const struct sockopt_req *req;
+	char name[64];
+	unsigned int i;
+
+	json_array_start(&json, "sockopts");
+	for (i = 0; i < config->n_sockopts; i++) {
+		req = &config->sockopts[i];
+		sockopt_format(&req->opt, name, sizeof(name));
+		json_object_start(&json, NULL);
+		json_string(&json, "option", name);
+		json_int(&json, "requested", req->opt.value);
+		if (req->client)
+			json_int(&json, "client", req->client_value);
+		if (req->server)
+			json_int(&json, "server", req->server_value);
+		json_object_end(&json);
+	}
+	json_array_end(&json);
+}
+
+static void json_verify_result(const struct verify_result *vr)
+{
+	json_object_start(&json, "verify");
+	json_uint(&json, "client_errors", vr->client_errors);
+	json_uint(&json, "server_errors", vr->server_errors);
+	json_uint(&json, "client_checksum_us", vr->client_usec);
+	json_uint(&json, "server_checksum_us", vr->server_usec);
+	json_double(&json, "worker_us", vr->worker_usec);
+	json_object_end(&json);
+}
+
+static void cpu_result_setup(struct client_config *config,
+			     const struct xfer_stats *sum_client,
+			     const struct xfer_stats *sum_server)
+{
+	struct cpu_result *res = &config->cpu_result;
+
+	res->client_util = cpu_usage_util(&config->cpu_usage);
+	res->server_util = cpu_usage_util(&config->server_cpu_usage);
+	res->client_sdem = service_demand(config->cpu_usage.busy_usec,
+					  sum_client, sum_server,
+					  config->test_mode);
+	res->server_sdem = service_demand(config->server_cpu_usage.busy_usec,
+					  sum_client, sum_server,
+					  config->test_mode);
+}
+
+static void json_xfer_stats_1(const char *key,
+			      const struct xfer_stats_1 *stats)
+{
+	json_object_start(&json, key);
+	json_uint(&json, "calls", stats->calls);
+	json_uint(&json, "msgs", stats->msgs);
+	json_uint(&json, "bytes", stats->bytes);
+	json_object_end(&json);
+}
+
+static void json_xfer_stats(const char *key, const struct xfer_stats *stats)
+{
+	json_object_start(&json, key);
+	json_xfer_stats_1("recv", &stats->rx);
+	json_xfer_stats_1("send", &stats->tx);
+	json_object_end(&json);
+}
+
+static void json_perf_stats(const struct perf_stats *stats)
+{
+	unsigned int i;
+
+	json_object_start(&json, "perf");
+	for (i = 0; i < PERF_CNT_COUNT; i++)
+		if (stats->valid & (1U << i))
+			json_uint(&json, perf_counter_names[i],
+				  stats->counters[i]);
+	json_bool(&json, "user_only", stats->user_only);
+	json_object_end(&json);
+}
+
+static void json_tcpinfo_stats(const struct tcpinfo_stats *stats)
+{
+	if (!stats->valid)
+		return;
+	json_object_start(&json, "tcp_info");
+	json_uint(&json, "srtt_us", stats->srtt_usec);
+	json_uint(&json, "rttvar_us", stats->rttvar_usec);
+	json_uint(&json, "cwnd", stats->cwnd);
+	json_uint(&json, "total_retrans", stats->total_retrans);
+	if (stats->pacing_rate != TCPINFO_RATE_UNLIMITED)
+		json_uint(&json, "pacing_rate", stats->pacing_rate);
+	json_uint(&json, "delivery_rate", stats->delivery_rate);
+	json_uint(&json, "samples", stats->samples);
+	if (stats->samples) {
+		json_double(&json, "srtt_avg_us",
+			    (double)stats->srtt_sum / stats->samples);
+		json_uint(&json, "srtt_max_us", stats->srtt_max_usec);
+		json_double(&json, "cwnd_avg",
+			    (double)stats->cwnd_sum / stats->samples);
+		json_double(&json, "delivery_rate_avg",
+			    (double)stats->delivery_rate_sum / stats->samples);
+	}
+	json_object_end(&json);
+}
+
+static void json_net_counters(const char *key, const struct net_counters *set)
+{
+	unsigned int i;
+
+	json_object_start(&json, key);
+	for (i = 0; i < set->n; i++)
+		json_int(&json, set->counters[i].name, set->counters[i].value);
+	json_object_end(&json);
+}
+
+static void json_thread(struct client_config *config, unsigned int i,
+			const struct server_thread_stats *sstats,
+			double result)
+{
+	const struct client_worker_data *wdata = &config->workers_data[i];
+	const struct server_target *srv =
+		&config->servers[thread_server(config, i)];
+
+	json_object_start(&json, NULL);
+	json_uint(&json, "thread", i);
+	json_double(&json, "result", result);
+	if (wdata->congestion)
+		json_string(&json, "congestion", wdata->congestion);
+	json_object_start(&json, "client");
+	json_xfer_stats("xfer", &wdata->stats);
+	json_uint(&json, "cpu_us", wdata->cpu_usec);
+	json_double(&json, "connect_latency", wdata->connect_latency);
+	json_double(&json, "connect_attempt_latency",
+		    wdata->connect_attempt_latency);
+	json_uint(&json, "connect_retries", wdata->connect_retries);
+	if (config->perf_counters)
+		json_perf_stats(&wdata->perf_stats);
+	if (config->tcp_info)
+		json_tcpinfo_stats(&wdata->tcpinfo);
+	if (config->verify)
+		json_uint(&json, "verify_errors", wdata->verify_errors);
+	json_object_end(&json);
+	json_object_start(&json, "server");
+	json_xfer_stats("xfer", &sstats->xfer);
+	json_uint(&json, "cpu_us", sstats->cpu_usec);
+	if (config->perf_counters && server_cap(srv, CTRL_CAP_PERF_COUNTERS))
+		json_perf_stats(&sstats->perf);
+	if (config->tcp_info && server_cap(srv, CTRL_CAP_TCP_INFO))
+		json_tcpinfo_stats(&sstats->tcpinfo);
+	if (config->verify)
+		json_uint(&json, "verify_errors", sstats->verify_errors);
+	json_object_end(&json);
+	json_object_end(&json);
+}
+
+static void json_cpu_result(const struct cpu_result *cpu)
+{
+	json_object_start(&json, "cpu");
+	json_double(&json, "client_util", cpu->client_util);
+	json_double(&json, "server_util", cpu->server_util);
+	json_double(&json, "client_sdem", cpu->client_sdem);
+	json_double(&json, "server_sdem", cpu->server_sdem);
+	json_object_end(&json);
+}
+
+/* running average, deviation and confidence interval after n iterations */
+static void json_estimate(struct client_config *config, double sum,
+			  double sum_sqr, unsigned int n)
+{
+	double avg = sum / n;
+
+	json_double(&json, "avg", avg);
+	json_double(&json, "mdev", mdev_n(sum, sum_sqr, n));
+	if (n > 1) {
+		double confid = confid_interval(sum, sum_sqr, n,
+						config->confid_level);
+
+		json_double(&json, "confid_interval", confid);
+		json_double(&json, "confid_interval_rel", confid / avg);
+	}
+}
+
+static void json_baseline(const struct baseline *base,
+			  const struct baseline_cmp *cmp)
+{
+	json_object_start(&json, "baseline");
+	json_uint(&json, "iterations", base->n);
+	json_double(&json, "avg", cmp->base_avg);
+	json_double(&json, "change", cmp->change);
+	if (cmp->status == 0) {
+		json_double(&json, "t", cmp->welch.t);
+		json_double(&json, "t_crit", cmp->welch.crit);
+		json_double(&json, "dof", cmp->welch.dof);
+	}
+	json_string(&json, "verdict", baseline_verdict(cmp));
+	json_object_end(&json);
+}
+
+static void json_config(struct client_config *config)
+{
+	unsigned int i;
+
+	json_object_start(&json, "config");
+	json_string(&json, "server", config->servers[0].host);
+	if (config->n_servers > 1) {
+		json_array_start(&json, "servers");
+		for (i = 0; i < config->n_servers; i++)
+			json_string(&json, NULL,
+				    config->servers[i].host);
+		json_array_end(&json);
+	}
+	json_uint(&json, "port", config->ctrl_port);
+	json_string(&json, "test", test_mode_names[config->test_mode]);
+	json_string(&json, "unit", config->print_opts.unit == PRINT_UNIT_BYTE ?
+				   "B/s" : "tr/s");
+	json_uint(&json, "msg_size", config->msg_size);
+	if (config->msg_dist.n) {
+		json_string(&json, "msg_dist", config->msg_dist_spec);
+		json_double(&json, "msg_dist_mean",
+			    msgdist_mean(&config->msg_dist));
+	}
+	if (config->resp_size)
+		json_uint(&json, "resp_size", config->resp_size);
+	if (config->service_spec)
+		json_string(&json, "service", config->service_spec);
+	if (config->pace_rate) {
+		json_uint(&json, "pace_rate", config->pace_rate);
+		json_bool(&json, "pace_total", config->pace_total);
+		json_string(&json, "pacing",
+			    config->pace_kernel ? "kernel" : "user");
+	}
+	if (config->cc_spec)
+		json_string(&json, "congestion", config->cc_spec);
+	if (config->server_cc[0])
+		json_string(&json, "server_congestion", config->server_cc);
+	json_uint(&json, "threads", config->n_threads);
+	json_uint(&json, "test_length", config->test_length);
+	json_uint(&json, "min_iterations", config->min_iter);
+	json_uint(&json, "max_iterations", config->max_iter);
+	json_uint(&json, "confid_level", config->confid_pct);
+	json_bool(&json, "robust", config->robust);
+	if (config->confid_target_set)
+		json_double(&json, "confid_target", config->confid_target);
+	json_uint(&json, "rcvbuf_size", config->rcvbuf_size);
+	json_uint(&json, "sndbuf_size", config->sndbuf_size);
+	json_bool(&json, "tcp_nodelay", config->tcp_nodelay);
+	json_uint(&json, "accept_threads", config->accept_threads);
+	json_bool(&json, "cpu_steering", config->cpu_steering);
+	json_bool(&json, "perf_counters", config->perf_counters);
+	if (config->tcp_info)
+		json_uint(&json, "tcp_info_interval", config->tcp_info_interval);
+	if (config->converge > 0) {
+		json_double(&json, "converge", config->converge);
+		json_uint(&json, "converge_interval",
+			  config->converge_interval);
+	}
+	json_object_end(&json);
+}
+
+static int collect_stats(struct client_config *config, double *iter_result)
+{
+	bool show_thread = config->stats_mask & STATS_F_THREAD;
+	bool show_raw = config->stats_mask & STATS_F_RAW;
+	unsigned int n_threads = config->n_threads;
+	unsigned int test_mode = config->test_mode;
+	struct xfer_stats sum_client, sum_server;
+	double result, sum_rslt, sum_rslt_sqr;
+	double elapsed = config->elapsed;
+	struct server_thread_stats *server_stats;
+	unsigned int i;
+
+	server_stats = recv_server_stats(config);
+	if (!server_stats)
+		return -EFAULT;
+	if (show_thread || show_raw)
+		printf("test time: %.3lf%s, connection setup: client %.3lf, server %.3lf\n\n",
+		       elapsed, config->converged ? " (converged)" : "",
+		       config->connect_time, config->server_setup_time);
+	if (config->json_file) {
+		json_double(&json, "elapsed", elapsed);
+		json_bool(&json, "converged", config->converged);
+		json_double(&json, "connect_time", config->connect_time);
+		json_double(&json, "server_setup_time",
+			    config->server_setup_time);
+		json_array_start(&json, "threads");
+	}
+
+	/* raw stats */
+	xfer_stats_reset(&sum_client);
+	if (show_raw)
+		xfer_stats_raw_header("client");
+	for (i = 0; i < n_threads; i++) {
+		const struct xfer_stats *wstats =
+			&config->workers_data[i].stats;
+
+		if (show_raw)
+			xfer_stats_print_raw(wstats, i);
+		xfer_stats_add(&sum_client, wstats);
+	}
+	if (show_raw) {
+		xfer_stats_print_raw(&sum_client, XFER_STATS_TOTAL);
+		putchar('\n');
+	}
+
+	xfer_stats_reset(&sum_server);
+	if (show_raw)
+		xfer_stats_raw_header("server");
+	for (i = 0; i < n_threads; i++) {
+		if (show_raw)
+			xfer_stats_print_raw(&server_stats[i].xfer, i);
+		xfer_stats_add(&sum_server, &server_stats[i].xfer);
+	}
+	if (show_raw) {
+		xfer_stats_print_raw(&sum_server, XFER_STATS_TOTAL);
+		putchar('\n');
+	}
+	if (config->tcp_info && (config->stats_mask & STATS_F_TCPINFO))
+		print_tcpinfo_stats(config, server_stats);
+
+	if (config->stats_mask & STATS_F_CONNECT)
+		print_connect_stats(config);
+	if (config->stats_mask & STATS_F_NET)
+		print_net_counters(config);
+	if (config->perf_counters && (config->stats_mask & STATS_F_PERF))
+		print_perf_stats(config, server_stats, &sum_client,
+				 &sum_server);
+
+	/* thread stats */
+	sum_rslt = sum_rslt_sqr = 0.0;
+	for (i = 0; i < config->n_cc_groups; i++)
+		config->cc_groups[i].result = 0.0;
+	for (i = 0; i < config->n_servers; i++)
+		config->servers[i].result = 0.0;
+	for (i = 0; i < n_threads; i++) {
+		struct cc_group *group = cc_thread_group(config, i);
+
+		result = xfer_stats_result(&config->workers_data[i].stats,
+					   &server_stats[i].xfer, test_mode,
+					   elapsed);
+		sum_rslt += result;
+		sum_rslt_sqr += result * (double)result;
+		fairness_add(&config->fairness, i, result);
+		if (group)
+			group->result += result;
+		config->servers[thread_server(config, i)].result += result;
+
+		if (show_thread)
+			xfer_stats_print_thread(&config->workers_data[i].stats,
+						&server_stats[i].xfer, i,
+						test_mode, elapsed,
+						&config->print_opts);
+		if (config->json_file)
+			json_thread(config, i, &server_stats[i], result);
+		if (config->latency)
+			latency_hist_merge(&config->latency_hist,
+					   &config->workers_data[i].latency_hist);
+	}
+
+	fairness_finish(&config->fairness, sum_rslt, sum_rslt_sqr, n_threads);
+	if (show_thread) {
 		xfer_stats_print_thread(&sum_client, &sum_server,
 					XFER_STATS_TOTAL, test_mode, elapsed,
 					&config->print_opts);
 		xfer_stats_thread_footer(sum_rslt, sum_rslt_sqr, n_threads,
+					 &config->fairness,
 					 &config->print_opts);
 		putchar('\n');
+		if (config->show_cpu)
+			print_cpu_stats(config, server_stats);
+	}
+	for (i = 0; i < config->n_cc_groups; i++)
+		config->cc_groups[i].result_sum += config->cc_groups[i].result;
+	if (config->n_cc_groups > 1) {
+		if (show_thread || show_raw) {
+			print_cc_result(config, 0);
+			putchar('\n');
+		}
+		if (config->json_file)
+			json_cc_result(config, 0);
+	}
+	for (i = 0; i < config->n_servers; i++)
+		config->servers[i].result_sum += config->servers[i].result;
+	if (config->n_servers > 1) {
+		if (show_thread || show_raw) {
+			print_server_result(config, 0);
+			putchar('\n');
+		}
+		if (config->json_file)
+			json_server_result(config, 0);
+	}
+	if (config->service_type != SERVICE_NONE) {
+		uint64_t count = 0, nsec = 0, max_nsec = 0;
+
+		for (i = 0; i < n_threads; i++) {
+			count += server_stats[i].service_count;
+			nsec += server_stats[i].service_nsec;
+			if (server_stats[i].service_max_nsec > max_nsec)
+				max_nsec = server_stats[i].service_max_nsec;
+		}
+		config->service_count += count;
+		config->service_nsec += nsec;
+		if (max_nsec > config->service_max_nsec)
+			config->service_max_nsec = max_nsec;
+		if (show_thread || show_raw) {
+			print_service_time(config, count, nsec, max_nsec);
+			putchar('\n');
+		}
+		if (config->json_file)
+			json_service_time(config, count, nsec, max_nsec);
+	}
+	if (config->pace_rate) {
+		pace_result_setup(config);
+		if (show_thread || show_raw) {
+			print_pace_result(config, &config->pace_iter);
+			putchar('\n');
+		}
+		if (config->json_file)
+			json_pace_result(config, &config->pace_iter);
+	}
+	if (config->verify) {
+		verify_result_setup(config, server_stats);
+		if (show_thread || show_raw) {
+			print_verify_threads(config, server_stats);
+			print_verify_result("verification", &config->verify_iter);
+			putchar('\n');
+		}
 	}
+	free(server_stats);
+	cpu_result_setup(config, &sum_client, &sum_server);
 	*iter_result = sum_rslt;
+	config->dist_bytes += sum_client.tx.bytes;
+	config->dist_msgs += sum_client.tx.msgs;
+
+	if (config->json_file) {
+		json_array_end(&json);
+		json_object_start(&json, "total");
+		json_xfer_stats("client", &sum_client);
+		json_xfer_stats("server", &sum_server);
+		if (config->msg_dist.n && sum_client.tx.msgs)
+			json_double(&json, "mean_msg_size",
+				    (double)sum_client.tx.bytes /
+				    sum_client.tx.msgs);
+		json_double(&json, "thread_avg", sum_rslt / n_threads);
+		json_double(&json, "thread_mdev",
+			    mdev_n(sum_rslt, sum_rslt_sqr, n_threads));
+		json_fairness(&config->fairness);
+		json_object_end(&json);
+		json_cpu_result(&config->cpu_result);
+		if (config->verify)
+			json_verify_result(&config->verify_iter);
+		if (config->net_counters) {
+			json_object_start(&json, "net_counters");
+			json_net_counters("client", &config->net_delta);
+			json_net_counters("server",
+					  &config->server_net_delta);
+			json_object_end(&json);
+		}
+	}
+	if (config->coord_sd >= 0)
+		return coord_send_result(config, &sum_client, &sum_server);
 
 	return 0;
 }
@@ -457,7 +1984,7 @@ int one_iteration(struct client_config *config, double *iter_result)
 
 	ret = ctrl_initialize(config);
 	if (ret < 0)
-		goto err;
+		goto err_close;
 	ret = prepare_buffers(config);
 	if (ret < 0)
 		goto err_close;
@@ -467,29 +1994,135 @@ int one_iteration(struct client_config *config, double *iter_result)
 	ret = connect_workers(config);
 	if (ret < 0)
 		goto err_workers;
+	if (config->coord_sd >= 0) {
+		ret = coord_ready(config);
+		if (ret < 0)
+			goto err_workers;
+	}
 	ret = run_test(config);
 	if (ret < 0)
 		goto err_workers;
 
 	ret = collect_stats(config, iter_result);
-	ctrl_close(config);
+	if (ret < 0)
+		ctrl_close(config);
 	return ret;
 
 err_workers:
 	kill_workers(config);
 err_close:
 	ctrl_close(config);
-err:
-	return 2;
+	return ret;
+}
+
+/* relative half width of bootstrap confidence interval of the median */
+static double robust_ival_hw(struct client_config *config, unsigned int n)
+{
+	struct robust_stats rs;
+
+	if (robust_estimate(iter_results, n, config->confid_pct / 100.0,
+			    &rs) < 0 || rs.median <= 0)
+		return HUGE_VAL;
+	return (rs.ci_high - rs.ci_low) / 2 / rs.median;
+}
+
+static void print_robust_summary(struct client_config *config,
+				 const struct robust_stats *rs,
+				 unsigned int n_iter)
+{
+	bool first = true;
+	unsigned int i;
+
+	robust_stats_print(rs, config->confid_pct, &config->print_opts);
+	for (i = 0; i < n_iter; i++) {
+		if (!robust_outlier(rs, iter_results[i]))
+			continue;
+		fputs(first ? "outliers: iteration " : ", iteration ", stdout);
+		printf("%u (", i + 1);
+		print_rate(iter_results[i], &config->print_opts);
+		putchar(')');
+		first = false;
+	}
+	if (!first)
+		putchar('\n');
+}
+
+static void json_robust(struct client_config *config,
+			const struct robust_stats *rs, unsigned int n_iter)
+{
+	unsigned int i;
+
+	json_object_start(&json, "robust");
+	json_double(&json, "median", rs->median);
+	json_double(&json, "mad", rs->mad);
+	json_uint(&json, "confid_level", config->confid_pct);
+	json_double(&json, "confid_low", rs->ci_low);
+	json_double(&json, "confid_high", rs->ci_high);
+	json_array_start(&json, "outliers");
+	for (i = 0; i < n_iter; i++)
+		if (robust_outlier(rs, iter_results[i]))
+			json_uint(&json, NULL, i + 1);
+	json_array_end(&json);
+	json_object_end(&json);
+}
+
+static void json_latency(const struct latency_hist *hist)
+{
+	char name[24];
+	unsigned int i;
+
+	json_object_start(&json, "latency");
+	json_uint(&json, "samples", hist->n);
+	if (hist->n) {
+		json_double(&json, "min_usec", hist->min / 1000.0);
+		json_double(&json, "avg_usec",
+			    (double)hist->sum / hist->n / 1000.0);
+		json_double(&json, "max_usec", hist->max / 1000.0);
+		for (i = 0; i < LAT_N_PCTS; i++) {
+			snprintf(name, sizeof(name), "p%g_usec",
+				 latency_pcts[i]);
+			json_double(&json, name,
+				    latency_percentile(hist, latency_pcts[i]) /
+				    1000.0);
+		}
+	}
+	json_object_end(&json);
+}
+
+static void cpu_result_average(struct cpu_result *avg, unsigned int n)
+{
+	unsigned int i;
+
+	memset(avg, '\0', sizeof(*avg));
+	if (!n)
+		return;
+	for (i = 0; i < n; i++) {
+		avg->client_util += iter_cpu[i].client_util;
+		avg->server_util += iter_cpu[i].server_util;
+		avg->client_sdem += iter_cpu[i].client_sdem;
+		avg->server_sdem += iter_cpu[i].server_sdem;
+	}
+	avg->client_util /= n;
+	avg->server_util /= n;
+	avg->client_sdem /= n;
+	avg->server_sdem /= n;
 }
 
 int all_iterations(struct client_config *config)
 {
 	double confid_target_hw, confid_ival_hw;
+	bool show_fair = config->n_threads > 1;
+	bool show_cpu = config->show_cpu;
+	struct cpu_result cpu_avg;
 	unsigned int n_iter, iter;
 	unsigned int stats_mask;
 	bool confid_target_set;
+	struct baseline_cmp base_cmp;
+	struct robust_stats robust;
+	unsigned int json_depth;
+	bool have_robust;
 	double sum, sum_sqr;
+	double jain_sum = 0.0;
 	int ret = 0;
 
 	stats_mask = config->stats_mask;
@@ -499,32 +2132,77 @@ int all_iterations(struct client_config *config)
 
 	sum = sum_sqr = 0.0;
 	n_iter = 0;
+	latency_hist_reset(&config->latency_hist);
+	config->dist_bytes = config->dist_msgs = 0;
+	memset(&config->verify_total, '\0', sizeof(config->verify_total));
+	config->service_count = config->service_nsec = 0;
+	memset(&config->pace_sum, '\0', sizeof(config->pace_sum));
+	for (iter = 0; iter < config->n_cc_groups; iter++)
+		config->cc_groups[iter].result_sum = 0.0;
+	for (iter = 0; iter < config->n_servers; iter++)
+		config->servers[iter].result_sum = 0.0;
+	config->service_max_nsec = 0;
+	if (config->json_file)
+		json_array_start(&json, "iterations");
+	json_depth = json.depth;
 	for (iter = 0; iter < config->max_iter; iter++) {
 		double iter_result;
 
 		if (stats_mask & (STATS_F_THREAD | STATS_F_RAW))
 			printf("iteration %u\n", iter + 1);
+		if (config->json_file) {
+			json_object_start(&json, NULL);
+			json_uint(&json, "iteration", iter + 1);
+		}
 		ret = one_iteration(&client_config, &iter_result);
-		if (ret < 0)
+		if (ret < 0) {
+			if (config->json_file) {
+				json_close_to(&json, json_depth + 1);
+				json_string(&json, "error", strerror(-ret));
+				json_close_to(&json, json_depth);
+			}
 			break;
+		}
 		n_iter++;
 
 		iter_results[iter] = iter_result;
+		iter_cpu[iter] = config->cpu_result;
+		iter_fairness[iter] = config->fairness;
+		jain_sum += config->fairness.jain;
 		sum += iter_result;
 		sum_sqr += iter_result * iter_result;
-		if (iter > 0)
+		if (config->robust && iter + 1 >= ROBUST_MIN_SAMPLES)
+			confid_ival_hw = robust_ival_hw(config, iter + 1);
+		else if (iter > 0)
 			confid_ival_hw = confid_interval(sum, sum_sqr, iter + 1,
 							 config->confid_level) /
 					 (sum / (iter + 1));
+		if (config->json_file) {
+			json_double(&json, "result", iter_result);
+			json_estimate(config, sum, sum_sqr, iter + 1);
+			json_close_to(&json, json_depth);
+			fflush(config->json_file);
+		}
 		if (stats_mask & STATS_F_ITER) {
 			print_iter_result(iter + 1, iter + 1, iter_result,
 					  sum, sum_sqr, config->confid_level,
+					  show_cpu ? &iter_cpu[iter] : NULL,
+					  show_fair ? &iter_fairness[iter] : NULL,
 					  &config->print_opts);
 			if (stats_mask & (STATS_F_THREAD | STATS_F_RAW))
 				putchar('\n');
 		}
 		fflush(stdout);
 
+		/* coordinator decides whether to go on */
+		if (config->coord_sd >= 0) {
+			bool more;
+
+			ret = coord_next(config, &more);
+			if (ret < 0 || !more)
+				break;
+			continue;
+		}
 		if (confid_target_set && (n_iter >= config->min_iter) &&
 		    (confid_ival_hw <= confid_target_hw))
 			break;
@@ -547,6 +2225,8 @@ int all_iterations(struct client_config *config)
 			sum_sqr += result * result;
 			print_iter_result(iter + 1, n_iter, result, sum,
 					  sum_sqr, config->confid_level,
+					  show_cpu ? &iter_cpu[iter] : NULL,
+					  show_fair ? &iter_fairness[iter] : NULL,
 					  &config->print_opts);
 		}
 	}
@@ -559,43 +2239,499 @@ int all_iterations(struct client_config *config)
 			"*** The result is not reliable enough.\n",
 			200.0 * confid_ival_hw, 100.0 * confid_ival_hw,
 			config->confid_target);
+	cpu_result_average(&cpu_avg, n_iter);
+	have_robust = config->robust &&
+		      robust_estimate(iter_results, n_iter,
+				      config->confid_pct / 100.0, &robust) == 0;
+	if (config->baseline_path)
+		baseline_compare(&config->baseline, sum, sum_sqr, n_iter,
+				 config->confid_level, &base_cmp);
+	if (config->save_path)
+		baseline_save(config->save_path, config, iter_results, n_iter);
+	config->result_iter = n_iter;
+	config->result_avg = n_iter ? sum / n_iter : 0.0;
+	config->result_jain = n_iter ? jain_sum / n_iter : 1.0;
+	if (have_robust && n_iter >= ROBUST_MIN_SAMPLES)
+		config->result_confid = robust_ival_hw(config, n_iter);
+	else if (n_iter > 1)
+		config->result_confid = confid_interval(sum, sum_sqr, n_iter,
+							config->confid_level) /
+					config->result_avg;
+	else
+		config->result_confid = HUGE_VAL;
+	if (config->json_file) {
+		json_array_end(&json);
+		json_object_start(&json, "summary");
+		json_uint(&json, "iterations", n_iter);
+		if (n_iter)
+			json_estimate(config, sum, sum_sqr, n_iter);
+		json_cpu_result(&cpu_avg);
+		if (config->confid_target_set) {
+			json_double(&json, "confid_interval_width",
+				    (n_iter > 1) ? 200.0 * confid_ival_hw :
+						   HUGE_VAL);
+			json_bool(&json, "confid_target_met",
+				  n_iter > 1 &&
+				  200.0 * confid_ival_hw <= config->confid_target);
+		}
+		if (have_robust)
+			json_robust(config, &robust, n_iter);
+		if (config->latency && config->test_mode == MODE_TCP_RR)
+			json_latency(&config->latency_hist);
+		if (config->verify)
+			json_verify_result(&config->verify_total);
+		if (config->pace_rate && n_iter)
+			json_pace_result(config, &config->pace_sum);
+		if (config->n_cc_groups > 1 && n_iter)
+			json_cc_result(config, n_iter);
+		if (config->n_servers > 1 && n_iter)
+			json_server_result(config, n_iter);
+		if (show_fair && n_iter)
+			json_fairness_summary(config, n_iter);
+		if (config->n_sockopts && n_iter)
+			json_sockopts(config);
+		if (config->service_type != SERVICE_NONE)
+			json_service_time(config, config->service_count,
+					  config->service_nsec,
+					  config->service_max_nsec);
+		if (config->msg_dist.n && config->dist_msgs)
+			json_double(&json, "mean_msg_size",
+				    (double)config->dist_bytes /
+				    config->dist_msgs);
+		if (config->baseline_path)
+			json_baseline(&config->baseline, &base_cmp);
+		json_object_end(&json);
+	}
 	if (stats_mask & STATS_F_TOTAL)
 		print_iter_result(XFER_STATS_TOTAL, n_iter, 0.0,
 				  sum, sum_sqr, config->confid_level,
+				  show_cpu ? &cpu_avg : NULL, NULL,
 				  &config->print_opts);
+	if (config->robust && have_robust && (stats_mask & STATS_F_TOTAL))
+		print_robust_summary(config, &robust, n_iter);
+	if (show_fair && n_iter && (stats_mask & STATS_F_TOTAL))
+		print_fairness_summary(config, n_iter);
+	if (config->n_sockopts && n_iter && (stats_mask & STATS_F_TOTAL))
+		print_sockopts(config);
+	if (config->latency && config->test_mode == MODE_TCP_RR &&
+	    (stats_mask & STATS_F_TOTAL))
+		latency_print(&config->latency_hist);
+	if (config->verify && (stats_mask & STATS_F_TOTAL))
+		print_verify_result("verification", &config->verify_total);
+	if (config->pace_rate && n_iter && (stats_mask & STATS_F_TOTAL))
+		print_pace_result(config, &config->pace_sum);
+	if (config->n_cc_groups > 1 && n_iter &&
+	    (stats_mask & STATS_F_TOTAL))
+		print_cc_result(config, n_iter);
+	if (config->n_servers > 1 && n_iter && (stats_mask & STATS_F_TOTAL))
+		print_server_result(config, n_iter);
+	if (config->service_type != SERVICE_NONE &&
+	    (stats_mask & STATS_F_TOTAL))
+		print_service_time(config, config->service_count,
+				   config->service_nsec,
+				   config->service_max_nsec);
+	if (config->verify && (config->verify_total.client_errors ||
+			       config->verify_total.server_errors))
+		fprintf(stderr, "*** %" PRIu64 " messages failed verification ***\n",
+			config->verify_total.client_errors +
+			config->verify_total.server_errors);
+	if (config->msg_dist.n && config->dist_msgs &&
+	    (stats_mask & STATS_F_TOTAL))
+		printf("message size    mean %.1lf B (distribution %.1lf B, max %u B)\n",
+		       (double)config->dist_bytes / config->dist_msgs,
+		       msgdist_mean(&config->msg_dist), config->msg_size);
+	if (config->baseline_path && !config->quiet)
+		baseline_print(&config->baseline, &base_cmp, config);
 
 	return ret;
 }
 
+static void sweep_print_header(void)
+{
+	printf("%-10s %9s %7s %9s %9s %13s %12s %5s %7s\n", "test",
+	       "msg_size", "threads", "rcvbuf", "sndbuf", "result", "confid",
+	       "iter", "jain");
+}
+
+static void sweep_print_result(const struct client_config *config, int ret)
+{
+	printf("%-10s %9u %7u %9u %9u ", test_mode_names[config->test_mode],
+	       config->msg_size, config->n_threads, config->rcvbuf_size,
+	       config->sndbuf_size);
+	if (ret < 0 && !config->result_iter) {
+		printf("%16s\n", "failed");
+		return;
+	}
+	print_rate(config->result_avg, &config->print_opts);
+	if (config->print_opts.unit == PRINT_UNIT_BYTE)
+		putchar(' ');
+	if (config->result_confid < HUGE_VAL)
+		printf("  +/- %5.1lf%%", 100.0 * config->result_confid);
+	else
+		printf("  %10s", "-");
+	printf(" %5u %7.4lf\n", config->result_iter, config->result_jain);
+}
+
+static int sweep_point(struct client_config *config)
+{
+	unsigned int depth = json.depth;
+	int ret;
+
+	if (config->stats_mask) {
+		printf("=== test: %s, message size: %u, threads: %u, rcvbuf: %u, sndbuf: %u\n",
+		       test_mode_names[config->test_mode], config->msg_size,
+		       config->n_threads, config->rcvbuf_size,
+		       config->sndbuf_size);
+		putchar('\n');
+	}
+	if (config->json_file) {
+		json_object_start(&json, NULL);
+		json_string(&json, "test", test_mode_names[config->test_mode]);
+		json_uint(&json, "msg_size", config->msg_size);
+		json_uint(&json, "threads", config->n_threads);
+		json_uint(&json, "rcvbuf_size", config->rcvbuf_size);
+		json_uint(&json, "sndbuf_size", config->sndbuf_size);
+	}
+	config->result_iter = 0;
+	ret = all_iterations(config);
+	if (config->json_file) {
+		if (ret < 0 && !config->result_iter) {
+			json_close_to(&json, depth + 1);
+			json_string(&json, "error", strerror(-ret));
+		}
+		json_close_to(&json, depth);
+	}
+	if (config->stats_mask)
+		putchar('\n');
+	if (!config->quiet)
+		sweep_print_result(config, ret);
+	fflush(stdout);
+
+	return ret;
+}
+
+static unsigned long sweep_next(const struct sweep_list *list,
+				unsigned int *idx)
+{
+	unsigned long val = list->vals[*idx % list->n];
+
+	*idx /= list->n;
+	return val;
+}
+
+/* Run all combinations of swept parameters. Buffers are allocated for the
+ * largest message size and thread count so that they (and the control
+ * connection) can be reused for all points; a failed point does not stop
+ * the sweep.
+ */
+static int run_sweep(struct client_config *config)
+{
+	const struct sweep_list *msg_sizes = &config->sweep_msg_sizes;
+	unsigned int n_msg = msg_sizes->n ? msg_sizes->n : 1;
+	unsigned int n_points, point, idx;
+	unsigned int n_failed = 0;
+	int ret;
+
+	n_points = config->sweep_modes.n * n_msg * config->sweep_threads.n *
+		   config->sweep_rcvbufs.n * config->sweep_sndbufs.n;
+	if (!config->quiet)
+		sweep_print_header();
+	if (config->json_file)
+		json_array_start(&json, "points");
+	for (point = 0; point < n_points; point++) {
+		/* last parameter varies fastest */
+		idx = point;
+		config->sndbuf_size = sweep_next(&config->sweep_sndbufs, &idx);
+		config->rcvbuf_size = sweep_next(&config->sweep_rcvbufs, &idx);
+		config->n_threads = sweep_next(&config->sweep_threads, &idx);
+		config->msg_size = msg_sizes->n ? sweep_next(msg_sizes, &idx) : 0;
+		if (config->msg_dist.n)
+			config->msg_size = msgdist_max(&config->msg_dist);
+		config->test_mode = sweep_next(&config->sweep_modes, &idx);
+		/* zero (or no list) means default for the test */
+		if (!config->msg_size)
+			config->msg_size = default_msg_size(config->test_mode);
+		print_opts_setup(&config->print_opts, config->test_mode);
+
+		ret = sweep_point(config);
+		if (ret < 0)
+			n_failed++;
+	}
+	if (config->json_file)
+		json_array_end(&json);
+
+	return n_failed ? -EIO : 0;
+}
+
+/* one tested load of latency SLO search */
+struct slo_point {
+	unsigned int		n_threads;
+	unsigned int		n_iter;
+	double			result;
+	double			confid;
+	struct latency_hist	latency;
+};
+
+static struct slo_point slo_best;
+
+static void slo_print_header(const struct client_config *config)
+{
+	char pct_label[32];
+
+	printf("latency target: p%g <= %.1lf us, threads 1-%u\n\n",
+	       config->slo_pct, config->slo_usec, config->n_threads);
+	snprintf(pct_label, sizeof(pct_label), "p%g (us)", config->slo_pct);
+	printf("%7s %13s %12s %7s %10s %10s  %s\n", "threads", "result",
+	       "confid", "jain", "p50 (us)", pct_label, "SLO");
+}
+
+static bool slo_probe(struct client_config *config, unsigned int n_threads)
+{
+	const struct latency_hist *hist = &config->latency_hist;
+	unsigned int depth = json.depth;
+	double p_usec;
+	bool pass;
+	int ret;
+
+	config->n_threads = n_threads;
+	if (config->json_file) {
+		json_object_start(&json, NULL);
+		json_uint(&json, "threads", n_threads);
+	}
+	config->result_iter = 0;
+	ret = all_iterations(config);
+	p_usec = latency_percentile(hist, config->slo_pct) / 1000.0;
+	pass = config->result_iter && hist->n && p_usec <= config->slo_usec;
+	if (config->json_file) {
+		if (ret < 0 && !config->result_iter) {
+			json_close_to(&json, depth + 1);
+			json_string(&json, "error", strerror(-ret));
+		}
+		json_bool(&json, "slo_met", pass);
+		json_close_to(&json, depth);
+	}
+
+	if (!config->quiet) {
+		printf("%7u ", n_threads);
+		if (!config->result_iter) {
+			printf("%16s\n", "failed");
+			return false;
+		}
+		print_rate(config->result_avg, &config->print_opts);
+		if (config->result_confid < HUGE_VAL)
+			printf("  +/- %5.1lf%%", 100.0 * config->result_confid);
+		else
+			printf("  %10s", "-");
+		printf(" %7.4lf %10.1lf %10.1lf  %s\n", config->result_jain,
+		       latency_percentile(hist, 50.0) / 1000.0, p_usec,
+		       pass ? "met" : "missed");
+		fflush(stdout);
+	}
+
+	if (pass && n_threads > slo_best.n_threads) {
+		slo_best.n_threads = n_threads;
+		slo_best.n_iter = config->result_iter;
+		slo_best.result = config->result_avg;
+		slo_best.confid = config->result_confid;
+		slo_best.latency = *hist;
+	}
+	return pass;
+}
+
+/* Search for the highest thread count meeting the latency target, assuming
+ * the latency percentile grows with load: double the thread count until
+ * the target is missed (or -M is reached), then bisect.
+ */
+static int run_slo_search(struct client_config *config)
+{
+	unsigned int max_threads = config->n_threads;
+	unsigned int lo = 0, hi = max_threads + 1;
+	unsigned int n;
+
+	if (!config->quiet)
+		slo_print_header(config);
+	if (config->json_file)
+		json_array_start(&json, "slo_probes");
+	n = 1;
+	while (true) {
+		if (!slo_probe(config, n)) {
+			hi = n;
+			break;
+		}
+		lo = n;
+		if (n == max_threads)
+			break;
+		n = (2 * n < max_threads) ? 2 * n : max_threads;
+	}
+	while (hi <= max_threads && hi - lo > 1) {
+		n = lo + (hi - lo) / 2;
+		if (slo_probe(config, n))
+			lo = n;
+		else
+			hi = n;
+	}
+	if (config->json_file) {
+		json_array_end(&json);
+		json_object_start(&json, "slo");
+		json_double(&json, "target_usec", config->slo_usec);
+		json_double(&json, "percentile", config->slo_pct);
+		json_bool(&json, "met", lo > 0);
+		if (lo) {
+			json_uint(&json, "threads", slo_best.n_threads);
+			json_uint(&json, "iterations", slo_best.n_iter);
+			json_double(&json, "result", slo_best.result);
+			if (slo_best.confid < HUGE_VAL)
+				json_double(&json, "confid_interval_rel",
+					    slo_best.confid);
+			json_latency(&slo_best.latency);
+		}
+		json_object_end(&json);
+	}
+
+	if (!lo) {
+		fprintf(stderr, "*** Latency target not met even with one thread.\n");
+		return 0;
+	}
+	if (config->quiet)
+		return 0;
+	printf("\nhighest load meeting the target: %u threads, ",
+	       slo_best.n_threads);
+	print_rate(slo_best.result, &config->print_opts);
+	if (slo_best.confid < HUGE_VAL)
+		printf(" (+/- %.1lf%%)", 100.0 * slo_best.confid);
+	if (hi > max_threads)
+		fputs(", limited by -M", stdout);
+	putchar('\n');
+	latency_print(&slo_best.latency);
+
+	return 0;
+}
+
+static unsigned long sweep_max(const struct sweep_list *list,
+			       unsigned long val)
+{
+	unsigned int i;
+
+	for (i = 0; i < list->n; i++)
+		if (list->vals[i] > val)
+			val = list->vals[i];
+	return val;
+}
+
+/* Lists which were not given on command line sweep over the single value */
+static void sweep_init(struct sweep_list *list, unsigned int val)
+{
+	if (!list->n) {
+		list->n = 1;
+		list->vals[0] = val;
+	}
+}
+
+static void print_header(const struct client_config *config)
+{
+	unsigned int i;
+
+	printf("server: %s", config->servers[0].host);
+	for (i = 1; i < config->n_servers; i++)
+		printf(", %s", config->servers[i].host);
+	printf(", port %hu\n", config->ctrl_port);
+	if (config->min_iter < config->max_iter)
+		printf("iterations: %u-%u", config->min_iter,
+		       config->max_iter);
+	else
+		printf("iterations: %u", config->min_iter);
+	printf(", threads: %u, test length: %u\n",
+	       config->n_threads, config->test_length);
+	if (config->confid_target_set)
+		printf("confidence target: %.1lf%% (+/- %.1lf%%) at %u%%%s\n",
+		       config->confid_target, config->confid_target / 2,
+		       config->confid_pct, config->robust ? " (robust)" : "");
+	if (config->msg_dist.n)
+		printf("test: %s, message size: %s (mean %.1lf, max %u)",
+		       test_mode_names[config->test_mode],
+		       config->msg_dist_spec, msgdist_mean(&config->msg_dist),
+		       config->msg_size);
+	else
+		printf("test: %s, message size: %u",
+		       test_mode_names[config->test_mode], config->msg_size);
+	if (config->resp_size)
+		printf(", response size: %u", config->resp_size);
+	putchar('\n');
+	if (config->cc_spec || config->server_cc[0])
+		printf("congestion control: client %s, server %s\n",
+		       config->cc_spec ? config->cc_spec : "default",
+		       config->server_cc[0] ? config->server_cc : "default");
+	putchar('\n');
+}
+
 int main(int argc, char *argv[])
 {
+	unsigned int i;
 	int ret;
 
 	ret = parse_cmdline(argc, argv, &client_config);
 	if (ret < 0)
 		return 1;
+	if (client_config.baseline_path) {
+		ret = baseline_load(client_config.baseline_path,
+				    &client_config.baseline);
+		if (ret < 0)
+			return 1;
+		baseline_check_config(&client_config.baseline, &client_config);
+	}
+	if (client_config.coord_clients)
+		return coord_main(&client_config) < 0 ? 1 : 0;
+	if (client_config.coord_host && coord_join(&client_config) < 0)
+		return 1;
 	iter_results = calloc(client_config.max_iter, sizeof(iter_results[0]));
-	if (!iter_results)
+	iter_cpu = calloc(client_config.max_iter, sizeof(iter_cpu[0]));
+	iter_fairness = calloc(client_config.max_iter,
+			       sizeof(iter_fairness[0]));
+	if (!iter_results || !iter_cpu || !iter_fairness)
 		return 2;
 
-	printf("server: %s, port %hu\n", client_config.server_host,
-	       client_config.ctrl_port);
-	if (client_config.min_iter < client_config.max_iter)
-		printf("iterations: %u-%u", client_config.min_iter,
-		       client_config.max_iter);
-	else
-		printf("iterations: %u", client_config.min_iter);
-	printf(", threads: %u, test length: %u\n",
-	       client_config.n_threads, client_config.test_length);
-	if (client_config.confid_target_set)
-		printf("confidence target: %.1lf%% (+/- %.1lf%%) at %u%%\n",
-		       client_config.confid_target,
-		       client_config.confid_target / 2,
-		       confid_level_output(client_config.confid_level));
-	printf("test: %s, message size: %u\n",
-	       test_mode_names[client_config.test_mode],
-	       client_config.msg_size);
-	putchar('\n');
+	if (client_config.json_path) {
+		if (!strcmp(client_config.json_path, "-"))
+			client_config.json_file = stdout;
+		else
+			client_config.json_file = fopen(client_config.json_path,
+							"w");
+		if (!client_config.json_file) {
+			perror("failed to open JSON output file");
+			ret = -errno;
+			goto out_results;
+		}
+		json_init(&json, client_config.json_file);
+		json_object_start(&json, NULL);
+		json_config(&client_config);
+	}
+
+	if (client_config.sweep) {
+		unsigned int mode;
+
+		sweep_init(&client_config.sweep_modes, client_config.test_mode);
+		sweep_init(&client_config.sweep_threads,
+			   client_config.n_threads);
+		sweep_init(&client_config.sweep_rcvbufs,
+			   client_config.rcvbuf_size);
+		sweep_init(&client_config.sweep_sndbufs,
+			   client_config.sndbuf_size);
+		/* size buffers for the largest point */
+		client_config.n_threads = sweep_max(&client_config.sweep_threads,
+						    0);
+		for (mode = 0; mode < client_config.sweep_modes.n; mode++) {
+			unsigned int size;
+
+			size = default_msg_size(client_config.sweep_modes.vals[mode]);
+			if (size > client_config.msg_size)
+				client_config.msg_size = size;
+		}
+		client_config.msg_size = sweep_max(&client_config.sweep_msg_sizes,
+						   client_config.msg_size);
+	}
+	if (!client_config.quiet && !client_config.sweep &&
+	    !(client_config.slo_usec > 0))
+		print_header(&client_config);
 
 	ret = client_init();
 	if (ret < 0)
@@ -603,15 +2739,41 @@ int main(int argc, char *argv[])
 	ret = wsync_init(&client_worker_sync);
 	if (ret < 0)
 		goto out_results;
+	ret = worker_connect_init(client_config.connect_concurrency);
+	if (ret < 0)
+		goto out_ws;
 	ret = alloc_buffers(&client_config);
 	if (ret < 0)
 		goto out_ws;
-	ret = all_iterations(&client_config);
+	if (client_config.sweep)
+		ret = run_sweep(&client_config);
+	else if (client_config.slo_usec > 0)
+		ret = run_slo_search(&client_config);
+	else
+		ret = all_iterations(&client_config);
+	ctrl_close(&client_config);
+	coord_close(&client_config);
+	for (i = 0; i < client_config.n_servers; i++) {
+		ctrl_msg_free(&client_config.servers[i].msg);
+		free(client_config.servers[i].host);
+	}
 
 	free_buffers(&client_config);
+	net_counters_free(&client_config.net_start);
+	net_counters_free(&client_config.net_end);
+	net_counters_free(&client_config.net_delta);
+	net_counters_free(&client_config.server_net_delta);
 out_ws:
 	wsync_destroy(&client_worker_sync);
 out_results:
+	if (client_config.json_file) {
+		json_finish(&json);
+		if (client_config.json_file != stdout)
+			fclose(client_config.json_file);
+	}
+	msgdist_free(&client_config.msg_dist);
+	free(iter_fairness);
+	free(iter_cpu);
 	free(iter_results);
 	return (ret < 0) ? 2 : 0;
 }
@@ -3,48 +3,219 @@
 
 #include <stdint.h>
 
+#include "../common.h"
+#include "../ctrlmsg.h"
 #include "../stats.h"
+#include "../latency.h"
 #include "../estimate.h"
+#include "../cpustat.h"
+#include "../netcnt.h"
+#include "../msgdist.h"
+#include "../sockopt.h"
+#include "baseline.h"
 
 enum stats_type {
 	STATS_TOTAL,		/* total over all iterations */
 	STATS_ITER,		/* per iteration results */
 	STATS_THREAD,		/* per thread results for iteration */
 	STATS_RAW,		/* raw thread data */
+	STATS_CONNECT,		/* connection establishment */
+	STATS_PERF,		/* performance counters */
+	STATS_NET,		/* kernel network counters */
+	STATS_TCPINFO,		/* TCP_INFO samples */
 };
 
 #define STATS_F_TOTAL		(1 << STATS_TOTAL)
 #define STATS_F_ITER		(1 << STATS_ITER)
 #define STATS_F_THREAD		(1 << STATS_THREAD)
 #define STATS_F_RAW		(1 << STATS_RAW)
+#define STATS_F_CONNECT		(1 << STATS_CONNECT)
+#define STATS_F_PERF		(1 << STATS_PERF)
+#define STATS_F_NET		(1 << STATS_NET)
+#define STATS_F_TCPINFO		(1 << STATS_TCPINFO)
 
 #define STATS_F_ALL \
-	(STATS_F_TOTAL | STATS_F_ITER | STATS_F_THREAD | STATS_F_RAW)
+	(STATS_F_TOTAL | STATS_F_ITER | STATS_F_THREAD | STATS_F_RAW | \
+	 STATS_F_CONNECT | STATS_F_PERF | STATS_F_NET | STATS_F_TCPINFO)
+
+#define SWEEP_MAX_VALUES 256
+#define CC_MAX_SLOTS 64
+#define MAX_SERVERS 64
+
+/* threads using one congestion control algorithm and their throughput */
+struct cc_group {
+	char		name[CC_NAME_MAX];
+	unsigned int	n_threads;
+	double		result;		/* last iteration */
+	double		result_sum;	/* all iterations */
+};
+
+/* One nperfd instance of a (multi-server) run with its own control
+ * connection; threads are spread over servers round robin.
+ */
+struct server_target {
+	char			*host;
+	union sockaddr_any	ctrl_addr;	/* resolved on first connect */
+	union sockaddr_any	test_addr;
+	int			ctrl_sd;
+	uint64_t		caps;		/* CTRL_CAP_* bits */
+	struct ctrl_msg		msg;		/* reused for all messages */
+	unsigned int		n_threads;	/* current test */
+	double			result;		/* last iteration */
+	double			result_sum;	/* all iterations */
+};
+
+/* values of one swept parameter (list or range on command line) */
+struct sweep_list {
+	unsigned int	n;
+	unsigned long	vals[SWEEP_MAX_VALUES];
+};
+
+/* socket option given by -O and its effective values */
+struct sockopt_req {
+	const char	*spec;
+	struct sockopt	opt;
+	bool		client;
+	bool		server;
+	int		client_value;	/* read back on first connection */
+	int		server_value;
+};
+
+/* per thread results received from server */
+struct server_thread_stats {
+	struct xfer_stats	xfer;
+	uint64_t		cpu_usec;
+	struct perf_stats	perf;
+	struct tcpinfo_stats	tcpinfo;
+	uint64_t		verify_errors;
+	uint64_t		verify_usec;
+	uint64_t		service_count;
+	uint64_t		service_nsec;
+	uint64_t		service_max_nsec;
+};
+
+/* payload verification: mismatched messages and time spent checksumming */
+struct verify_result {
+	uint64_t	client_errors;
+	uint64_t	server_errors;
+	uint64_t	client_usec;
+	uint64_t	server_usec;
+	double		worker_usec;	/* test time of all threads */
+};
+
+/* rate limited stream: achieved rate and cadence of sends */
+struct pace_result {
+	double		bytes;		/* sent by client */
+	double		elapsed;
+	double		min_ratio;	/* slowest thread, achieved / target */
+	double		max_ratio;
+	uint64_t	sends;		/* send intervals */
+	double		ival_sum;	/* ns */
+	double		ival_sum_sqr;
+};
 
 struct client_config {
-	const char			*server_host;
+	struct server_target		servers[MAX_SERVERS];
+	unsigned int			n_servers;
 	uint16_t			ctrl_port;
-	uint16_t			test_port;
 	unsigned int			test_mode;
 	unsigned int			test_length;
 	unsigned int			min_iter;
 	unsigned int			max_iter;
 	unsigned int			n_threads;
 	enum confid_level		confid_level;
+	unsigned int			confid_pct;	/* any level, robust */
+	bool				robust;
 	double				confid_target;
 	bool				confid_target_set;
 	unsigned int			stats_mask;
 	unsigned int			rcvbuf_size;
 	unsigned int			sndbuf_size;
 	unsigned int			msg_size;
+	unsigned int			resp_size;	/* 0 = msg_size */
+	const char			*msg_dist_spec;
+	struct msgdist			msg_dist;	/* msg_size is max */
+	uint32_t			size_seed;
+	uint64_t			dist_bytes;	/* all iterations */
+	uint64_t			dist_msgs;
+	bool				verify;
+	uint64_t			pace_rate;	/* per connection B/s */
+	bool				pace_total;	/* rate given in total */
+	bool				pace_kernel;
+	struct pace_result		pace_iter;
+	struct pace_result		pace_sum;	/* all iterations */
+	struct verify_result		verify_iter;
+	struct verify_result		verify_total;	/* all iterations */
+	const char			*service_spec;
+	unsigned int			service_type;
+	uint32_t			service_arg1;	/* ns or bytes */
+	uint32_t			service_arg2;
+	uint64_t			service_count;	/* all iterations */
+	uint64_t			service_nsec;
+	uint64_t			service_max_nsec;
+	const char			*cc_spec;
+	struct cc_group			cc_groups[CC_MAX_SLOTS];
+	unsigned int			n_cc_groups;	/* 0 = system default */
+	unsigned int			cc_slots[CC_MAX_SLOTS];	/* group */
+	unsigned int			n_cc_slots;	/* round robin */
+	char				server_cc[CC_NAME_MAX];
+	struct sockopt_req		sockopts[SOCKOPT_MAX];
+	unsigned int			n_sockopts;
 	bool				tcp_nodelay;
+	bool				show_cpu;
+	bool				perf_counters;
+	bool				tcp_info;
+	unsigned int			tcp_info_interval;	/* ms */
+	double				converge;	/* relative, 0 = off */
+	unsigned int			converge_interval;	/* ms */
+	bool				converged;
+	unsigned int			accept_threads;
+	bool				cpu_steering;
+	unsigned int			connect_concurrency;
+	unsigned int			connect_retries;
 	struct print_options		print_opts;
-	int				ctrl_sd;
+	const char			*json_path;	/* "-" = stdout */
+	FILE				*json_file;
+	bool				quiet;		/* no text output */
+	bool				net_counters;
+	const char			*save_path;
+	const char			*baseline_path;
+	struct baseline			baseline;
+	bool				sweep;
+	struct sweep_list		sweep_modes;
+	struct sweep_list		sweep_msg_sizes;	/* empty = default */
+	struct sweep_list		sweep_threads;
+	struct sweep_list		sweep_rcvbufs;
+	struct sweep_list		sweep_sndbufs;
+	unsigned int			result_iter;	/* summary of last run */
+	double				result_avg;
+	double				result_confid;	/* relative half width */
+	double				result_jain;	/* mean fairness index */
+	struct fairness			fairness;	/* last iteration */
+	bool				latency;
+	struct latency_hist		latency_hist;	/* all iterations */
+	double				slo_usec;	/* 0 = no search */
+	double				slo_pct;
+	unsigned int			coord_clients;	/* run as coordinator */
+	const char			*coord_host;	/* coordinated client */
+	uint16_t			coord_port;
+	int				coord_sd;
+	struct ctrl_msg			coord_msg;
+	unsigned int			test_id;
 	unsigned char			*buffers;
 	unsigned long			buff_size;
 	unsigned long			buffers_size;
 	struct client_worker_data       *workers_data;
 	double				elapsed;
+	double				connect_time;
+	double				server_setup_time;
+	struct cpu_usage		cpu_usage;
+	struct net_counters		net_start;
+	struct net_counters		net_end;
+	struct net_counters		net_delta;
+	struct net_counters		server_net_delta;
+	struct cpu_usage		server_cpu_usage;
+	struct cpu_result		cpu_result;
 };
 
 extern struct client_config client_config;
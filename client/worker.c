@@ -1,16 +1,28 @@
 #include <pthread.h>
+#include <semaphore.h>
 #include <unistd.h>
+#include <time.h>
+#include <string.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/prctl.h>
 
 #include "../common.h"
 #include "worker.h"
 #include "main.h"
+#include "../cpustat.h"
+#include "../verify.h"
+#include "../sockopt.h"
 
 #define WORKER_STACK_SIZE 16384
+#define CONNECT_BACKOFF_MIN 10000	/* us */
+#define CONNECT_BACKOFF_MAX 1000000	/* us */
+#define PACE_MAX_CREDIT 2000000ULL	/* ns */
 
 struct client_worker_data *workers_data;
-union sockaddr_any test_addr;
+
+static bool connect_limited;
+static sem_t connect_sem;
 
 struct worker_sync client_worker_sync = {
 	.mtx	= PTHREAD_MUTEX_INITIALIZER,
@@ -22,15 +34,19 @@ static void cleanup_close(void *_data)
 	struct client_worker_data *data = _data;
 
 	close(data->sd);
+	if (data->perf)
+		perf_counters_close(&data->perf_counters);
 }
 
 int worker_setup(struct client_worker_data *data)
 {
+	unsigned int i;
 	int val;
 	int ret;
 	int sd;
 
-	sd = socket(test_addr.sa.sa_family, SOCK_STREAM, IPPROTO_TCP);
+	data->sd = -1;
+	sd = socket(data->addr->sa.sa_family, SOCK_STREAM, IPPROTO_TCP);
 	if (sd < 0) {
 		ret = -errno;
 		perror("socket");
@@ -43,7 +59,7 @@ int worker_setup(struct client_worker_data *data)
 		if (ret < 0) {
 			ret = -errno;
 			perror("setsockopt(TCP_NODELAY)");
-			return ret;
+			goto err;
 		}
 	}
 	if (client_config.rcvbuf_size) {
@@ -52,7 +68,7 @@ int worker_setup(struct client_worker_data *data)
 		if (ret < 0) {
 			ret = -errno;
 			perror("setsockopt(SO_RCVBUF)");
-			return ret;
+			goto err;
 		}
 	}
 	if (client_config.sndbuf_size) {
@@ -61,48 +77,175 @@ int worker_setup(struct client_worker_data *data)
 		if (ret < 0) {
 			ret = -errno;
 			perror("setsockopt(SO_SNDBUF)");
-			return ret;
+			goto err;
+		}
+	}
+
+	for (i = 0; i < client_config.n_sockopts; i++) {
+		if (!client_config.sockopts[i].client)
+			continue;
+		ret = sockopt_apply(sd, &client_config.sockopts[i].opt);
+		if (ret < 0)
+			goto err;
+	}
+
+	if (data->congestion) {
+		ret = setsockopt(sd, SOL_TCP, TCP_CONGESTION, data->congestion,
+				 strlen(data->congestion));
+		if (ret < 0) {
+			ret = -errno;
+			fprintf(stderr, "setsockopt(TCP_CONGESTION, %s): %s\n",
+				data->congestion, strerror(-ret));
+			goto err;
+		}
+	}
+
+	if (data->pace_rate && data->pace_kernel) {
+		uint64_t rate64 = data->pace_rate;
+		uint32_t rate32 = rate64;
+
+		/* 64-bit value is only accepted by kernel 4.20 and newer */
+		if (rate64 <= UINT32_MAX)
+			ret = setsockopt(sd, SOL_SOCKET, SO_MAX_PACING_RATE,
+					 &rate32, sizeof(rate32));
+		else
+			ret = setsockopt(sd, SOL_SOCKET, SO_MAX_PACING_RATE,
+					 &rate64, sizeof(rate64));
+		if (ret < 0) {
+			ret = -errno;
+			perror("setsockopt(SO_MAX_PACING_RATE)");
+			goto err;
 		}
 	}
 
 	data->sd = sd;
 	return 0;
+err:
+	close(sd);
+	return ret;
+}
+
+int worker_connect_init(unsigned int concurrency)
+{
+	connect_limited = (concurrency > 0);
+	if (!connect_limited)
+		return 0;
+	if (sem_init(&connect_sem, 0, concurrency) < 0)
+		return -errno;
+
+	return 0;
 }
 
+static void connect_limit_enter(void)
+{
+	if (!connect_limited)
+		return;
+	while (sem_wait(&connect_sem) < 0 && errno == EINTR)
+		;
+}
+
+static void connect_limit_leave(void)
+{
+	if (connect_limited)
+		sem_post(&connect_sem);
+}
+
+/* errors which may be caused by a temporary overload of server listener */
+static bool connect_retriable(int err)
+{
+	switch(err) {
+	case ECONNREFUSED:
+	case ECONNRESET:
+	case ETIMEDOUT:
+	case EAGAIN:
+	case EINTR:
+	case EADDRNOTAVAIL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* effective values of -O options, reported for the first connection */
+static void worker_read_sockopts(struct client_worker_data *data)
+{
+	struct sockopt_req *req;
+	unsigned int i;
+
+	for (i = 0; i < client_config.n_sockopts; i++) {
+		req = &client_config.sockopts[i];
+		if (req->client)
+			sockopt_read(data->sd, &req->opt, &req->client_value);
+	}
+}
+
+/* With thousands of threads connecting at once, server listen queue can
+ * overflow so that some connection attempts fail. Number of concurrent
+ * attempts can be limited and failed attempts are retried with exponential
+ * backoff (a new socket is needed after a failed connect()).
+ */
 int worker_connect(struct client_worker_data *data)
 {
+	unsigned int backoff = CONNECT_BACKOFF_MIN;
 	union sockaddr_any local_addr;
+	struct timespec ts0, ts1, ts_try;
 	socklen_t addr_len;
 	int ret;
 
-	ret = sockaddr_length(&test_addr);
+	ret = sockaddr_length(data->addr);
 	if (ret < 0)
 		return ret;
 	addr_len = ret;
-	ret = connect(data->sd, &test_addr.sa, addr_len);
+
+	/* total includes waiting for a slot, failed attempts and backoff */
+	clock_gettime(CLOCK_MONOTONIC, &ts0);
+	connect_limit_enter();
+	while (true) {
+		clock_gettime(CLOCK_MONOTONIC, &ts_try);
+		ret = connect(data->sd, &data->addr->sa, addr_len);
+		clock_gettime(CLOCK_MONOTONIC, &ts1);
+		if (ret == 0)
+			break;
+		ret = -errno;
+		if (!connect_retriable(-ret) ||
+		    data->connect_retries >= client_config.connect_retries)
+			break;
+
+		data->connect_retries++;
+		close(data->sd);
+		data->sd = -1;
+		connect_limit_leave();
+		usleep(backoff);
+		backoff = (2 * backoff < CONNECT_BACKOFF_MAX) ?
+			  2 * backoff : CONNECT_BACKOFF_MAX;
+		connect_limit_enter();
+		ret = worker_setup(data);
+		if (ret < 0)
+			break;
+	}
+	connect_limit_leave();
 	if (ret < 0)
 		return ret;
+	data->connect_latency = timespec_diff(&ts0, &ts1);
+	data->connect_attempt_latency = timespec_diff(&ts_try, &ts1);
+	if (data->id == 0)
+		worker_read_sockopts(data);
 
 	addr_len = sizeof(local_addr);
 	ret = getsockname(data->sd, &local_addr.sa, &addr_len);
-	if (ret < 0) {
-		ret = -errno;
-		goto err_close;
-	}
+	if (ret < 0)
+		return -errno;
 	ret = sockaddr_get_port(&local_addr);
 	if (ret < 0)
-		goto err_close;
+		return ret;
 	data->client_port = ret;
 
 	return 0;
-err_close:
-	close(data->sd);
-	return ret;
 }
 
-static int recv_msg(struct client_worker_data *data, bool *eof)
+static int recv_msg(struct client_worker_data *data, unsigned long len,
+		    bool *eof)
 {
-	unsigned long len = data->msg_size;
 	unsigned char *p = data->buff;
 	ssize_t chunk;
 
@@ -131,9 +274,8 @@ static int recv_msg(struct client_worker_data *data, bool *eof)
 	return 0;
 }
 
-static int send_msg(struct client_worker_data *data)
+static int send_msg(struct client_worker_data *data, unsigned long len)
 {
-	unsigned long len = data->msg_size;
 	unsigned char *p = data->buff;
 	ssize_t chunk;
 
@@ -157,15 +299,117 @@ static int send_msg(struct client_worker_data *data)
 	return 0;
 }
 
+static void worker_seal(struct client_worker_data *data, unsigned long len)
+{
+	uint64_t t0 = monotonic_nsec();
+
+	verify_seal(data->buff, len, data->stats.tx.msgs);
+	data->verify_nsec += monotonic_nsec() - t0;
+}
+
+static void worker_check(struct client_worker_data *data, unsigned long len)
+{
+	uint64_t t0 = monotonic_nsec();
+
+	if (!verify_check(data->buff, len, data->stats.rx.msgs - 1))
+		data->verify_errors++;
+	data->verify_nsec += monotonic_nsec() - t0;
+}
+
+/* Token bucket: wait until the previous messages fit into the target rate.
+ * Credit for late sending is limited to PACE_MAX_CREDIT (or one message if
+ * longer) so that it compensates for wakeup latency but cannot cause long
+ * bursts.
+ */
+static void worker_pace(struct client_worker_data *data, unsigned long len,
+			uint64_t *next, uint64_t *last)
+{
+	uint64_t ival = len * 1000000000ULL / data->pace_rate;
+	uint64_t credit = (ival > PACE_MAX_CREDIT) ? ival : PACE_MAX_CREDIT;
+	struct timespec ts;
+	uint64_t now;
+
+	now = monotonic_nsec();
+	while (now < *next && !data->test_finished) {
+		ts.tv_sec = *next / 1000000000ULL;
+		ts.tv_nsec = *next % 1000000000ULL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		now = monotonic_nsec();
+	}
+
+	if (*last) {
+		double ival = now - *last;
+
+		data->pace_sends++;
+		data->pace_ival_sum += ival;
+		data->pace_ival_sum_sqr += ival * ival;
+	}
+	*last = now;
+	if (*next + credit < now)
+		*next = now - credit;
+	*next += ival;
+}
+
+/* TCP_INFO is sampled by the worker itself between messages so that
+ * the socket cannot be closed under the sample.
+ */
+static void worker_tcpinfo(struct client_worker_data *data, uint64_t *next)
+{
+	uint64_t now = monotonic_nsec();
+
+	if (now < *next)
+		return;
+	tcpinfo_sample(data->sd, &data->tcpinfo);
+	*next = now + client_config.tcp_info_interval * 1000000ULL;
+}
+
 int worker_run_test(struct client_worker_data *data)
 {
 	bool get_reply = data->reply;
+	bool latency = data->latency && get_reply;
+	unsigned long len = data->msg_size;
+	uint64_t msgs, t0 = 0;
+	uint64_t size_state = 0;
+	uint64_t pace_next = 0, pace_last = 0;
+	bool pace = data->pace_rate && !data->pace_kernel;
+	bool tcpinfo = client_config.tcp_info &&
+		       client_config.tcp_info_interval;
+	uint64_t tcpinfo_next = 0;
 	bool eof = false;
+	uint64_t cpu0;
 	int ret;
 
+	if (data->perf)
+		perf_counters_enable(&data->perf_counters);
+	if (data->msg_dist)
+		size_state = msgdist_seed(data->size_seed, data->client_port);
+	if (data->verify)
+		verify_fill(data->buff, (data->resp_size > data->msg_size) ?
+					data->resp_size : data->msg_size,
+			    data->client_port);
+	/* default 50us timer slack would add to jitter of paced sends */
+	if (pace)
+		prctl(PR_SET_TIMERSLACK, 1UL);
+	cpu0 = thread_cpu_usec();
+	if (tcpinfo)
+		tcpinfo_next = monotonic_nsec() +
+			       client_config.tcp_info_interval * 1000000ULL;
 	data->status = 0;
 	while (!eof && !data->test_finished) {
-		ret = send_msg(data);
+		if (tcpinfo)
+			worker_tcpinfo(data, &tcpinfo_next);
+		if (data->msg_dist)
+			len = msgdist_next(data->msg_dist, &size_state);
+		if (data->verify)
+			worker_seal(data, len);
+		if (pace) {
+			worker_pace(data, len, &pace_next, &pace_last);
+			if (data->test_finished)
+				break;
+		}
+		if (latency)
+			t0 = monotonic_nsec();
+		ret = send_msg(data, len);
 		if (ret < 0) {
 			data->status = -1;
 			break;
@@ -173,14 +417,33 @@ int worker_run_test(struct client_worker_data *data)
 		if (data->test_finished)
 			break;
 		if (get_reply) {
-			ret = recv_msg(data, &eof);
+			unsigned long resp_len = data->resp_size ?
+						 data->resp_size : len;
+
+			msgs = data->stats.rx.msgs;
+			ret = recv_msg(data, resp_len, &eof);
 			if (ret < 0) {
 				data->status = -1;
 				break;
 			}
+			/* only complete transactions */
+			if (data->stats.rx.msgs == msgs)
+				continue;
+			if (latency)
+				latency_hist_add(&data->latency_hist,
+						 monotonic_nsec() - t0);
+			if (data->verify)
+				worker_check(data, resp_len);
 		}
 	}
 
+	data->cpu_usec = thread_cpu_usec() - cpu0;
+	if (data->perf) {
+		perf_counters_disable(&data->perf_counters);
+		perf_counters_read(&data->perf_counters, &data->perf_stats);
+	}
+	if (client_config.tcp_info)
+		tcpinfo_final(data->sd, &data->tcpinfo);
 	return 0;
 }
 
@@ -190,15 +453,19 @@ void *worker_main(void * _data)
 	int ret;
 
 	data->status = -1;
-	worker_setup(data);
+	ret = worker_setup(data);
+	if (data->perf)
+		perf_counters_open(&data->perf_counters);
 	pthread_cleanup_push(cleanup_close, data);
 	wsync_inc_counter(&client_worker_sync);
 
 	wsync_wait_for_state(&client_worker_sync, WS_CONNECT);
-	ret = worker_connect(data);
+	if (ret == 0)
+		ret = worker_connect(data);
+	data->connect_status = ret;
+	wsync_inc_counter(&client_worker_sync);
 	if (ret < 0)
 		goto out;
-	wsync_inc_counter(&client_worker_sync);
 
 	wsync_wait_for_state(&client_worker_sync, WS_RUN);
 	ret = worker_run_test(data);
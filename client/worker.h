@@ -8,6 +8,8 @@
 #include "../common.h"
 #include "../wsync.h"
 #include "../stats.h"
+#include "../latency.h"
+#include "../msgdist.h"
 
 enum worker_state {
 	WS_INIT = 0,
@@ -21,19 +23,43 @@ extern struct worker_sync client_worker_sync;
 struct client_worker_data {
 	unsigned int		id;
 	int			sd;
+	const union sockaddr_any *addr;	/* server data port */
 	uint16_t		client_port;
 	unsigned char 		*buff;
 	bool			reply;
+	bool			perf;
+	bool			latency;
 	unsigned long		msg_size;
+	unsigned long		resp_size;	/* 0 = request size */
+	const struct msgdist	*msg_dist;	/* NULL = fixed msg_size */
+	uint32_t		size_seed;
+	bool			verify;
+	const char		*congestion;	/* NULL = system default */
+	uint64_t		pace_rate;	/* B/s, 0 = unlimited */
+	bool			pace_kernel;	/* SO_MAX_PACING_RATE */
+	uint64_t		pace_sends;
+	double			pace_ival_sum;	/* ns between sends */
+	double			pace_ival_sum_sqr;
+	uint64_t		verify_errors;
+	uint64_t		verify_nsec;
 	pthread_t		tid;
+	int			connect_status;
+	unsigned int		connect_retries;
+	double			connect_latency;	/* all attempts */
+	double			connect_attempt_latency;	/* last one */
 	struct xfer_stats	stats;
+	uint64_t		cpu_usec;
+	struct perf_counters	perf_counters;
+	struct perf_stats	perf_stats;
+	struct tcpinfo_stats	tcpinfo;
+	struct latency_hist	latency_hist;
 	int			status;
 	int			test_finished;
 } __attribute__ ((__aligned__ (CACHELINE_SIZE)));
 
 extern struct client_worker_data *workers_data;
-extern union sockaddr_any test_addr;
 
+int worker_connect_init(unsigned int concurrency);
 int start_client_worker(struct client_worker_data *data);
 
 #endif /* __NPERF_CLIENT_WORKER_H */
@@ -13,6 +13,26 @@ const char *const test_mode_names[MODE_COUNT] =
 	[MODE_TCP_RR]		= "TCP_RR",
 };
 
+const char *const service_type_names[SERVICE_COUNT] =
+{
+	[SERVICE_NONE]		= "none",
+	[SERVICE_SPIN]		= "spin",
+	[SERVICE_EXP]		= "exp",
+	[SERVICE_UNIFORM]	= "uniform",
+	[SERVICE_TOUCH]		= "touch",
+};
+
+const char *const ctrl_status_names[CTRL_STATUS_COUNT] =
+{
+	[CTRL_STATUS_OK]		= "success",
+	[CTRL_STATUS_BUSY]		= "server busy (session limit reached)",
+	[CTRL_STATUS_THREAD_LIMIT]	= "thread count exceeds server limit",
+	[CTRL_STATUS_CONGESTION]	= "congestion control algorithm not available",
+	[CTRL_STATUS_SOCKOPT]		= "socket option rejected by server",
+	[CTRL_STATUS_UNSUPPORTED]	= "test needs a feature not supported by server",
+	[CTRL_STATUS_MEMORY_LIMIT]	= "service memory exceeds server limit",
+};
+
 int parse_ulong_delim(const char *name, const char *str, unsigned long *val,
 		      char delimiter, const char **next)
 {
@@ -187,11 +207,6 @@ int ignore_signal(int signum)
 	return 0;
 }
 
-struct __common_ctrl_header {
-	uint32_t	length;
-	uint32_t	version;
-};
-
 int send_block(int sd, const void *buff, unsigned int length)
 {
 	const unsigned char *bp = buff;
@@ -235,44 +250,3 @@ int recv_block(int sd, void *buff, unsigned int length)
 
 	return 0;
 }
-
-int ctrl_send_msg(int sd, const void *buff, unsigned int length)
-{
-	return send_block(sd, buff, length);
-}
-
-int ctrl_recv_msg(int sd, void *buff, unsigned int length)
-{
-	const struct __common_ctrl_header *hdr = buff;
-	unsigned int rest = length;
-	unsigned char *bp = buff;
-	ssize_t chunk;
-
-	while (rest > length - sizeof(*hdr)) {
-		chunk = recv(sd, bp, rest, 0);
-		if (chunk < 0) {
-			if (errno == EINTR)
-				continue;
-			return -errno;
-		}
-		if (!chunk)
-			return -EINVAL;
-
-		bp += chunk;
-		rest -= chunk;
-	}
-
-	if (ntohl(hdr->length) != length || ntohl(hdr->version) != CTRL_VERSION)
-		return -EINVAL;
-
-	while (rest > 0) {
-		chunk = recv(sd, bp, rest, MSG_WAITALL);
-		if (chunk < 0)
-			return -errno;
-
-		bp += chunk;
-		rest -= chunk;
-	}
-
-	return 0;
-}
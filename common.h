@@ -4,14 +4,17 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <errno.h>
+#include <time.h>
 #include <netinet/in.h>
 
 #include "stats.h"
+#include "netcnt.h"
 
-#define CTRL_VERSION 1
+#define CTRL_VERSION 3
 #define DEFAULT_PORT 12543
 
 #define CACHELINE_SIZE 64
+#define CC_NAME_MAX 16		/* TCP_CA_NAME_MAX */
 
 #define ROUND_UP(x, d) ((((x) + (d) - 1) / (d)) * (d))
 
@@ -30,45 +33,34 @@ enum test_mode {
 
 extern const char *const test_mode_names[MODE_COUNT];
 
-/* all entries in network byte order (BE) */
-struct client_ctrl_msg {
-	uint32_t	length;
-	uint32_t	version;
-	uint32_t	test_id;
-	uint32_t	mode;
-	uint32_t	n_threads;
-	uint32_t	msg_size;
-	uint8_t		tcp_nodelay;
-	uint8_t		_padding[3];
-};
+/* emulated server processing of each TCP_RR request */
+enum service_type {
+	SERVICE_NONE,
+	SERVICE_SPIN,		/* busy loop for arg1 ns */
+	SERVICE_EXP,		/* busy loop, exponential with mean arg1 ns */
+	SERVICE_UNIFORM,	/* busy loop, uniform in arg1 - arg2 ns */
+	SERVICE_TOUCH,		/* write one byte per cache line of arg1 bytes */
 
-/* all entries in network byte order (BE) */
-struct server_start_msg {
-	uint32_t	length;
-	uint32_t	version;
-	uint32_t	test_id;
-	uint16_t	port;
-	uint8_t		_padding[2];
+	SERVICE_COUNT
 };
 
-/* all entries in network byte order (BE) */
-struct server_end_msg {
-	uint32_t	length;
-	uint32_t	version;
-	uint32_t	test_id;
-	uint32_t	status;
-	uint32_t	thread_length;
-	uint32_t	n_threads;
-};
+extern const char *const service_type_names[SERVICE_COUNT];
+
+/* reason for refusing a test, sent in CTRL_MSG_START */
+enum ctrl_status {
+	CTRL_STATUS_OK,
+	CTRL_STATUS_BUSY,		/* session limit reached */
+	CTRL_STATUS_THREAD_LIMIT,	/* too many threads requested */
+	CTRL_STATUS_CONGESTION,		/* congestion control not available */
+	CTRL_STATUS_SOCKOPT,		/* socket option cannot be set */
+	CTRL_STATUS_UNSUPPORTED,	/* unknown mandatory attribute */
+	CTRL_STATUS_MEMORY_LIMIT,	/* service memory not available */
 
-/* all entries in network byt order (BE) */
-struct server_thread_info {
-	struct xfer_stats	stats;
-	uint32_t		status;
-	uint16_t		client_port;
-	uint8_t			_padding[2];
+	CTRL_STATUS_COUNT
 };
 
+extern const char *const ctrl_status_names[CTRL_STATUS_COUNT];
+
 int parse_ulong(const char *name, const char *str, unsigned long *val);
 int parse_ulong_delim(const char *name, const char *str, unsigned long *val,
 		      char delimiter, const char **next);
@@ -90,8 +82,41 @@ int parse_double_range_delim(const char *name, const char *str,
 int ignore_signal(int signum);
 int send_block(int sd, const void *buff, unsigned int length);
 int recv_block(int sd, void *buff, unsigned int length);
-int ctrl_send_msg(int sd, const void *buff, unsigned int length);
-int ctrl_recv_msg(int sd, void *buff, unsigned int length);
+
+static inline void timespec_add_msec(struct timespec *ts, unsigned int msec)
+{
+	ts->tv_sec += msec / 1000;
+	ts->tv_nsec += (msec % 1000) * 1000000L;
+	if (ts->tv_nsec >= 1000000000L) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+static inline int timespec_cmp(const struct timespec *a,
+			       const struct timespec *b)
+{
+	if (a->tv_sec != b->tv_sec)
+		return (a->tv_sec < b->tv_sec) ? -1 : 1;
+	if (a->tv_nsec != b->tv_nsec)
+		return (a->tv_nsec < b->tv_nsec) ? -1 : 1;
+	return 0;
+}
+
+static inline double timespec_diff(const struct timespec *start,
+				   const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+	       1E-9 * (end->tv_nsec - start->tv_nsec);
+}
+
+static inline uint64_t monotonic_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
 static inline int sockaddr_get_port(const union sockaddr_any *addr)
 {
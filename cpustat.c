@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "cpustat.h"
+
+/* Read the aggregate "cpu" line of /proc/stat; idle and iowait time is
+ * counted as idle, everything else (including irq, softirq and steal) as
+ * busy.
+ */
+int cpu_sample_read(struct cpu_sample *sample)
+{
+	uint64_t user, nice, system, idle, iowait, irq, softirq, steal;
+	FILE *f;
+	int ret;
+
+	f = fopen("/proc/stat", "r");
+	if (!f)
+		return -errno;
+	user = nice = system = idle = iowait = irq = softirq = steal = 0;
+	ret = fscanf(f, "cpu %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+		     " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64,
+		     &user, &nice, &system, &idle, &iowait, &irq, &softirq,
+		     &steal);
+	fclose(f);
+	if (ret < 4)
+		return -EINVAL;
+
+	sample->busy = user + nice + system + irq + softirq + steal;
+	sample->total = sample->busy + idle + iowait;
+	return 0;
+}
+
+void cpu_usage_delta(const struct cpu_sample *start,
+		     const struct cpu_sample *end, struct cpu_usage *usage)
+{
+	long clk_tck = sysconf(_SC_CLK_TCK);
+	long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (clk_tck <= 0)
+		clk_tck = 100;
+	memset(usage, '\0', sizeof(*usage));
+	usage->n_cpus = (n_cpus > 0) ? n_cpus : 1;
+	if (end->total < start->total || end->busy < start->busy)
+		return;
+	usage->busy_usec = (end->busy - start->busy) * 1000000ULL / clk_tck;
+	usage->total_usec = (end->total - start->total) * 1000000ULL / clk_tck;
+}
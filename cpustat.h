@@ -0,0 +1,41 @@
+#ifndef __NPERF_CPUSTAT_H
+#define __NPERF_CPUSTAT_H
+
+#include <stdint.h>
+#include <time.h>
+
+/* system wide counters from /proc/stat, in clock ticks */
+struct cpu_sample {
+	uint64_t	busy;
+	uint64_t	total;
+};
+
+/* system wide CPU usage over a time interval, summed over all CPUs */
+struct cpu_usage {
+	uint64_t	busy_usec;
+	uint64_t	total_usec;
+	unsigned int	n_cpus;
+};
+
+int cpu_sample_read(struct cpu_sample *sample);
+void cpu_usage_delta(const struct cpu_sample *start,
+		     const struct cpu_sample *end, struct cpu_usage *usage);
+
+static inline double cpu_usage_util(const struct cpu_usage *usage)
+{
+	if (!usage->total_usec)
+		return 0.0;
+	return (double)usage->busy_usec / usage->total_usec;
+}
+
+/* CPU time consumed by calling thread */
+static inline uint64_t thread_cpu_usec(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+		return 0;
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+#endif /* __NPERF_CPUSTAT_H */
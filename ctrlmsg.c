@@ -0,0 +1,300 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "ctrlmsg.h"
+#include "common.h"
+
+#define CTRL_MSG_INITIAL_SIZE	256
+
+const char *const ctrl_cap_names[CTRL_CAP_COUNT] = {
+	[CTRL_CAP_CPU_STEERING]		= "cpu-steering",
+	[CTRL_CAP_PERF_COUNTERS]	= "perf-counters",
+	[CTRL_CAP_TCP_INFO]		= "tcp-info",
+	[CTRL_CAP_NET_COUNTERS]		= "net-counters",
+	[CTRL_CAP_RESP_SIZE]		= "resp-size",
+	[CTRL_CAP_MSG_DIST]		= "msg-dist",
+	[CTRL_CAP_VERIFY]		= "verify",
+	[CTRL_CAP_SERVICE]		= "service",
+	[CTRL_CAP_CONGESTION]		= "congestion",
+	[CTRL_CAP_SOCKOPT]		= "sockopt",
+};
+
+static size_t ctrl_align(size_t len)
+{
+	return ROUND_UP(len, CTRL_ALIGN);
+}
+
+static int ctrl_reserve(struct ctrl_msg *msg, size_t len)
+{
+	unsigned char *buff;
+	size_t size;
+
+	if (msg->error)
+		return msg->error;
+	if (msg->length + len <= msg->size)
+		return 0;
+	if (msg->length + len > CTRL_MSG_MAX) {
+		msg->error = -EMSGSIZE;
+		return msg->error;
+	}
+	size = msg->size ? msg->size : CTRL_MSG_INITIAL_SIZE;
+	while (size < msg->length + len)
+		size *= 2;
+	buff = realloc(msg->buff, size);
+	if (!buff) {
+		msg->error = -ENOMEM;
+		return msg->error;
+	}
+	msg->buff = buff;
+	msg->size = size;
+
+	return 0;
+}
+
+void ctrl_msg_init(struct ctrl_msg *msg, enum ctrl_msg_type type,
+		   uint32_t test_id)
+{
+	struct ctrl_msg_header hdr = {
+		.version	= htonl(CTRL_VERSION),
+		.type		= htonl(type),
+		.test_id	= htonl(test_id),
+	};
+
+	msg->length = 0;
+	msg->depth = 0;
+	msg->error = 0;
+	if (ctrl_reserve(msg, sizeof(hdr)) < 0)
+		return;
+	memcpy(msg->buff, &hdr, sizeof(hdr));
+	msg->length = sizeof(hdr);
+}
+
+void ctrl_msg_free(struct ctrl_msg *msg)
+{
+	free(msg->buff);
+	memset(msg, '\0', sizeof(*msg));
+}
+
+void ctrl_put(struct ctrl_msg *msg, uint16_t type, uint16_t flags,
+	      const void *data, size_t len)
+{
+	struct ctrl_attr attr = {
+		.type	= htons(type),
+		.flags	= htons(flags),
+		.length	= htonl(sizeof(attr) + len),
+	};
+	size_t total = ctrl_align(sizeof(attr) + len);
+
+	if (ctrl_reserve(msg, total) < 0)
+		return;
+	memcpy(msg->buff + msg->length, &attr, sizeof(attr));
+	if (len)
+		memcpy(msg->buff + msg->length + sizeof(attr), data, len);
+	memset(msg->buff + msg->length + sizeof(attr) + len, '\0',
+	       total - sizeof(attr) - len);
+	msg->length += total;
+}
+
+void ctrl_put_u32(struct ctrl_msg *msg, uint16_t type, uint16_t flags,
+		  uint32_t val)
+{
+	val = htonl(val);
+	ctrl_put(msg, type, flags, &val, sizeof(val));
+}
+
+void ctrl_put_u64(struct ctrl_msg *msg, uint16_t type, uint16_t flags,
+		  uint64_t val)
+{
+	val = hton64(val);
+	ctrl_put(msg, type, flags, &val, sizeof(val));
+}
+
+void ctrl_put_flag(struct ctrl_msg *msg, uint16_t type, uint16_t flags)
+{
+	ctrl_put(msg, type, flags, NULL, 0);
+}
+
+void ctrl_put_string(struct ctrl_msg *msg, uint16_t type, uint16_t flags,
+		     const char *str)
+{
+	ctrl_put(msg, type, flags, str, strlen(str) + 1);
+}
+
+/* attributes put until ctrl_nest_end() form the value of a nested one */
+void ctrl_nest_start(struct ctrl_msg *msg, uint16_t type)
+{
+	if (msg->depth >= CTRL_NEST_MAX) {
+		msg->error = -EINVAL;
+		return;
+	}
+	msg->nest[msg->depth++] = msg->length;
+	ctrl_put(msg, type, 0, NULL, 0);
+}
+
+void ctrl_nest_end(struct ctrl_msg *msg)
+{
+	struct ctrl_attr *attr;
+	size_t start;
+
+	if (msg->error || !msg->depth)
+		return;
+	start = msg->nest[--msg->depth];
+	attr = (struct ctrl_attr *)(msg->buff + start);
+	attr->length = htonl(msg->length - start);
+}
+
+int ctrl_msg_send(int sd, struct ctrl_msg *msg)
+{
+	struct ctrl_msg_header *hdr;
+
+	if (msg->error)
+		return msg->error;
+	hdr = (struct ctrl_msg_header *)msg->buff;
+	hdr->length = htonl(msg->length);
+	return send_block(sd, msg->buff, msg->length);
+}
+
+/* Receive one control message. Returns -ENOTCONN if the peer closed the
+ * connection before sending anything, i.e. at a message boundary (regular
+ * end of a control session).
+ */
+int ctrl_msg_recv(int sd, struct ctrl_msg *msg)
+{
+	struct ctrl_msg_header hdr;
+	unsigned char *bp = (unsigned char *)&hdr;
+	unsigned int rest = sizeof(hdr);
+	uint32_t length;
+	ssize_t chunk;
+	int ret;
+
+	while (rest > 0) {
+		chunk = recv(sd, bp, rest, 0);
+		if (chunk < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!chunk)
+			return (rest == sizeof(hdr)) ? -ENOTCONN : -EINVAL;
+		bp += chunk;
+		rest -= chunk;
+	}
+
+	length = ntohl(hdr.length);
+	if (ntohl(hdr.version) != CTRL_VERSION || length < sizeof(hdr) ||
+	    length > CTRL_MSG_MAX)
+		return -EINVAL;
+	msg->length = 0;
+	msg->depth = 0;
+	msg->error = 0;
+	ret = ctrl_reserve(msg, length);
+	if (ret < 0)
+		return ret;
+	memcpy(msg->buff, &hdr, sizeof(hdr));
+	ret = recv_block(sd, msg->buff + sizeof(hdr), length - sizeof(hdr));
+	if (ret < 0)
+		return ret;
+	msg->length = length;
+
+	return 0;
+}
+
+enum ctrl_msg_type ctrl_msg_type(const struct ctrl_msg *msg)
+{
+	const struct ctrl_msg_header *hdr =
+		(const struct ctrl_msg_header *)msg->buff;
+
+	return ntohl(hdr->type);
+}
+
+uint32_t ctrl_msg_test_id(const struct ctrl_msg *msg)
+{
+	const struct ctrl_msg_header *hdr =
+		(const struct ctrl_msg_header *)msg->buff;
+
+	return ntohl(hdr->test_id);
+}
+
+void ctrl_iter_msg(struct ctrl_attr_iter *it, const struct ctrl_msg *msg)
+{
+	it->pos = msg->buff + sizeof(struct ctrl_msg_header);
+	it->end = msg->buff + msg->length;
+	it->error = 0;
+}
+
+void ctrl_iter_nested(struct ctrl_attr_iter *it,
+		      const struct ctrl_attr *attr)
+{
+	it->pos = ctrl_attr_data(attr);
+	it->end = it->pos + ctrl_attr_len(attr);
+	it->error = 0;
+}
+
+/* next attribute or NULL at the end, it->error is set if malformed */
+const struct ctrl_attr *ctrl_iter_next(struct ctrl_attr_iter *it)
+{
+	const struct ctrl_attr *attr;
+	size_t avail = it->end - it->pos;
+	uint32_t len;
+
+	if (avail < sizeof(*attr)) {
+		if (avail)
+			it->error = -EINVAL;
+		return NULL;
+	}
+	attr = (const struct ctrl_attr *)it->pos;
+	len = ntohl(attr->length);
+	if (len < sizeof(*attr) || len > avail) {
+		it->error = -EINVAL;
+		return NULL;
+	}
+	len = ctrl_align(len);
+	it->pos += (len < avail) ? len : avail;
+
+	return attr;
+}
+
+int ctrl_attr_u32(const struct ctrl_attr *attr, uint32_t *val)
+{
+	uint32_t raw;
+
+	if (ctrl_attr_len(attr) != sizeof(raw))
+		return -EINVAL;
+	memcpy(&raw, ctrl_attr_data(attr), sizeof(raw));
+	*val = ntohl(raw);
+	return 0;
+}
+
+int ctrl_attr_u64(const struct ctrl_attr *attr, uint64_t *val)
+{
+	uint64_t raw;
+
+	if (ctrl_attr_len(attr) != sizeof(raw))
+		return -EINVAL;
+	memcpy(&raw, ctrl_attr_data(attr), sizeof(raw));
+	*val = ntoh64(raw);
+	return 0;
+}
+
+/* null terminated string of at most size bytes (terminator included) */
+int ctrl_attr_string(const struct ctrl_attr *attr, char *buff, size_t size)
+{
+	uint32_t len = ctrl_attr_len(attr);
+	const char *str = ctrl_attr_data(attr);
+
+	if (!len || len > size || str[len - 1] != '\0')
+		return -EINVAL;
+	memcpy(buff, str, len);
+	return 0;
+}
+
+/* fixed size value, copied as is (network byte order) */
+int ctrl_attr_struct(const struct ctrl_attr *attr, void *buff, size_t len)
+{
+	if (ctrl_attr_len(attr) != len)
+		return -EINVAL;
+	memcpy(buff, ctrl_attr_data(attr), len);
+	return 0;
+}
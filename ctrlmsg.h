@@ -0,0 +1,229 @@
+#ifndef __NPERF_CTRLMSG_H
+#define __NPERF_CTRLMSG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <arpa/inet.h>
+
+#define CTRL_MSG_MAX		(64U << 20)
+#define CTRL_ALIGN		4
+#define CTRL_NEST_MAX		4
+
+/* Control messages are a header followed by a sequence of type-length-value
+ * attributes, each padded to CTRL_ALIGN. Attributes of unknown type are
+ * ignored unless flagged CTRL_ATTR_F_MANDATORY, known attributes of
+ * unexpected length are ignored (metrics) or rejected (test parameters).
+ * A session starts with an exchange of CTRL_MSG_HELLO carrying supported
+ * capabilities so that a client only sends what the server understands;
+ * CTRL_VERSION only changes with the framing itself. The same framing is
+ * used between coordinated clients and their coordinator (CTRL_MSG_COORD_*).
+ *
+ * all entries in network byte order (BE)
+ */
+struct ctrl_msg_header {
+	uint32_t	length;		/* including header */
+	uint32_t	version;
+	uint32_t	type;
+	uint32_t	test_id;
+};
+
+/* all entries in network byte order (BE), value follows */
+struct ctrl_attr {
+	uint16_t	type;
+	uint16_t	flags;
+	uint32_t	length;		/* including header, without padding */
+};
+
+#define CTRL_ATTR_F_MANDATORY	0x0001	/* refuse message if unknown */
+
+enum ctrl_msg_type {
+	CTRL_MSG_HELLO,		/* both ways, session start */
+	CTRL_MSG_TEST,		/* client: test parameters */
+	CTRL_MSG_START,		/* server: test accepted or refused */
+	CTRL_MSG_END,		/* server: results */
+	CTRL_MSG_COORD_JOIN,	/* both ways, coordinated client joins */
+	CTRL_MSG_COORD_READY,	/* client: data connections established */
+	CTRL_MSG_COORD_GO,	/* coordinator: start test */
+	CTRL_MSG_COORD_STOP,	/* coordinator: end test */
+	CTRL_MSG_COORD_RESULT,	/* client: counters of the iteration */
+	CTRL_MSG_COORD_NEXT,	/* coordinator: run another iteration? */
+
+	CTRL_MSG_COUNT
+};
+
+/* optional features, announced in CTRL_MSG_HELLO */
+enum ctrl_cap {
+	CTRL_CAP_CPU_STEERING,
+	CTRL_CAP_PERF_COUNTERS,
+	CTRL_CAP_TCP_INFO,
+	CTRL_CAP_NET_COUNTERS,
+	CTRL_CAP_RESP_SIZE,
+	CTRL_CAP_MSG_DIST,
+	CTRL_CAP_VERIFY,
+	CTRL_CAP_SERVICE,
+	CTRL_CAP_CONGESTION,
+	CTRL_CAP_SOCKOPT,
+
+	CTRL_CAP_COUNT
+};
+
+#define CTRL_CAPS_ALL	((1ULL << CTRL_CAP_COUNT) - 1)
+
+extern const char *const ctrl_cap_names[CTRL_CAP_COUNT];
+
+enum ctrl_attr_type {
+	CA_UNSPEC,
+
+	/* CTRL_MSG_HELLO */
+	CA_CAPS,		/* u64, CTRL_CAP_* bits */
+
+	/* CTRL_MSG_TEST */
+	CA_MODE,		/* u32 */
+	CA_THREADS,		/* u32 */
+	CA_MSG_SIZE,		/* u32 */
+	CA_ACCEPT_THREADS,	/* u32, 0 = one per CPU */
+	CA_TCP_NODELAY,		/* flag */
+	CA_CPU_STEERING,	/* flag */
+	CA_PERF_COUNTERS,	/* flag */
+	CA_TCP_INFO,		/* u32 interval in ms, 0 = final sample */
+	CA_NET_COUNTERS,	/* flag */
+	CA_RESP_SIZE,		/* u32 */
+	CA_SIZE_SEED,		/* u32 */
+	CA_MSG_DIST,		/* struct msgdist_segment[] */
+	CA_VERIFY,		/* flag */
+	CA_SERVICE,		/* struct ctrl_service */
+	CA_CONGESTION,		/* string */
+	CA_SOCKOPT,		/* struct sockopt, repeated */
+
+	/* CTRL_MSG_START, CTRL_MSG_END */
+	CA_STATUS,		/* u32, enum ctrl_status / -errno */
+	CA_PORT,		/* u32 */
+	CA_SETUP_USEC,		/* u32 */
+	CA_CPU_USAGE,		/* struct ctrl_cpu_usage */
+	CA_THREAD,		/* nested CA_T_*, one per thread */
+	CA_NET_COUNTER,		/* struct net_counter, repeated */
+	CA_SOCKOPT_VALUE,	/* struct ctrl_sockopt_value, repeated */
+
+	/* nested in CA_THREAD */
+	CA_T_CLIENT_PORT,	/* u32 */
+	CA_T_XFER,		/* struct xfer_stats */
+	CA_T_CPU_USEC,		/* u64 */
+	CA_T_PERF,		/* struct perf_stats */
+	CA_T_TCP_INFO,		/* struct tcpinfo_stats */
+	CA_T_VERIFY,		/* struct ctrl_verify */
+	CA_T_SERVICE,		/* struct ctrl_service_stats */
+
+	/* CTRL_MSG_COORD_* */
+	CA_COORD_ITERATIONS,	/* u32, maximum */
+	CA_COORD_TEST_LENGTH,	/* u32, seconds */
+	CA_COORD_DONE,		/* flag, last iteration */
+	CA_COORD_ELAPSED_USEC,	/* u64 */
+	CA_COORD_CLIENT_XFER,	/* struct xfer_stats, sum of threads */
+	CA_COORD_SERVER_XFER,	/* struct xfer_stats, sum of threads */
+	CA_COORD_CLIENT_CPU,	/* struct ctrl_cpu_usage */
+	CA_COORD_SERVER_CPU,	/* struct ctrl_cpu_usage */
+
+	CA_COUNT
+};
+
+/* all entries in network byte order (BE) */
+struct ctrl_service {
+	uint32_t	type;		/* enum service_type */
+	uint32_t	arg1;
+	uint32_t	arg2;
+};
+
+/* all entries in network byte order (BE) */
+struct ctrl_cpu_usage {
+	uint32_t	n_cpus;
+	uint32_t	_padding;
+	uint64_t	busy_usec;	/* system wide, all CPUs */
+	uint64_t	total_usec;
+};
+
+/* all entries in network byte order (BE) */
+struct ctrl_sockopt_value {
+	uint32_t	index;		/* among CA_SOCKOPT of the test */
+	int32_t		value;		/* read back on first connection */
+};
+
+/* all entries in network byte order (BE) */
+struct ctrl_verify {
+	uint64_t	errors;
+	uint64_t	usec;
+};
+
+/* all entries in network byte order (BE) */
+struct ctrl_service_stats {
+	uint64_t	count;
+	uint64_t	nsec;		/* sum */
+	uint64_t	max_nsec;
+};
+
+/* message being built or received */
+struct ctrl_msg {
+	unsigned char	*buff;
+	size_t		length;
+	size_t		size;
+	size_t		nest[CTRL_NEST_MAX];
+	unsigned int	depth;
+	int		error;		/* sticky, checked on send */
+};
+
+struct ctrl_attr_iter {
+	const unsigned char	*pos;
+	const unsigned char	*end;
+	int			error;
+};
+
+void ctrl_msg_init(struct ctrl_msg *msg, enum ctrl_msg_type type,
+		   uint32_t test_id);
+void ctrl_msg_free(struct ctrl_msg *msg);
+void ctrl_put(struct ctrl_msg *msg, uint16_t type, uint16_t flags,
+	      const void *data, size_t len);
+void ctrl_put_u32(struct ctrl_msg *msg, uint16_t type, uint16_t flags,
+		  uint32_t val);
+void ctrl_put_u64(struct ctrl_msg *msg, uint16_t type, uint16_t flags,
+		  uint64_t val);
+void ctrl_put_flag(struct ctrl_msg *msg, uint16_t type, uint16_t flags);
+void ctrl_put_string(struct ctrl_msg *msg, uint16_t type, uint16_t flags,
+		     const char *str);
+void ctrl_nest_start(struct ctrl_msg *msg, uint16_t type);
+void ctrl_nest_end(struct ctrl_msg *msg);
+int ctrl_msg_send(int sd, struct ctrl_msg *msg);
+int ctrl_msg_recv(int sd, struct ctrl_msg *msg);
+
+enum ctrl_msg_type ctrl_msg_type(const struct ctrl_msg *msg);
+uint32_t ctrl_msg_test_id(const struct ctrl_msg *msg);
+void ctrl_iter_msg(struct ctrl_attr_iter *it, const struct ctrl_msg *msg);
+void ctrl_iter_nested(struct ctrl_attr_iter *it,
+		      const struct ctrl_attr *attr);
+const struct ctrl_attr *ctrl_iter_next(struct ctrl_attr_iter *it);
+
+int ctrl_attr_u32(const struct ctrl_attr *attr, uint32_t *val);
+int ctrl_attr_u64(const struct ctrl_attr *attr, uint64_t *val);
+int ctrl_attr_string(const struct ctrl_attr *attr, char *buff, size_t size);
+int ctrl_attr_struct(const struct ctrl_attr *attr, void *buff, size_t len);
+
+static inline uint16_t ctrl_attr_type(const struct ctrl_attr *attr)
+{
+	return ntohs(attr->type);
+}
+
+static inline bool ctrl_attr_mandatory(const struct ctrl_attr *attr)
+{
+	return ntohs(attr->flags) & CTRL_ATTR_F_MANDATORY;
+}
+
+static inline uint32_t ctrl_attr_len(const struct ctrl_attr *attr)
+{
+	return ntohl(attr->length) - sizeof(*attr);
+}
+
+static inline const void *ctrl_attr_data(const struct ctrl_attr *attr)
+{
+	return attr + 1;
+}
+
+#endif /* __NPERF_CTRLMSG_H */
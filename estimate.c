@@ -1,7 +1,16 @@
 #include <math.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "estimate.h"
 
+#define BOOTSTRAP_RESAMPLES	2000
+#define BOOTSTRAP_SEED		0x9e3779b97f4a7c15ULL
+#define MAD_SCALE		1.4826	/* MAD to sdev for normal distribution */
+#define OUTLIER_THRESHOLD	3.5	/* modified z-score (Iglewicz, Hoaglin) */
+
 #define t95 [CONFID_LEVEL_95]
 #define t99 [CONFID_LEVEL_99]
 
@@ -147,6 +156,162 @@ static double tval(unsigned int nu, enum confid_level level)
 	       tval_coeffs[level].c2 / (nu * nu);
 }
 
+/* Welch's t-test of the hypothesis that two samples (with possibly
+ * different variances) have the same mean, two sided at given confidence
+ * level. Degrees of freedom are rounded down for the critical value.
+ */
+int welch_test(double sum1, double sum_sqr1, unsigned int n1,
+	       double sum2, double sum_sqr2, unsigned int n2,
+	       enum confid_level level, struct welch_result *res)
+{
+	double var1, var2, v1, v2, diff, se;
+
+	if (n1 < 2 || n2 < 2)
+		return -EINVAL;
+	var1 = (sum_sqr1 - sum1 * sum1 / n1) / (n1 - 1);
+	var2 = (sum_sqr2 - sum2 * sum2 / n2) / (n2 - 1);
+	if (var1 < 0)
+		var1 = 0;
+	if (var2 < 0)
+		var2 = 0;
+	v1 = var1 / n1;
+	v2 = var2 / n2;
+	diff = sum1 / n1 - sum2 / n2;
+	se = sqrt(v1 + v2);
+
+	if (se == 0) {
+		/* no variance at all, any difference is significant */
+		res->t = (diff == 0) ? 0 : copysign(HUGE_VAL, diff);
+		res->dof = n1 + n2 - 2;
+		res->crit = tval(n1 + n2 - 2, level);
+		res->sign = (diff > 0) - (diff < 0);
+		return 0;
+	}
+
+	res->t = diff / se;
+	res->dof = (v1 + v2) * (v1 + v2) /
+		   (v1 * v1 / (n1 - 1) + v2 * v2 / (n2 - 1));
+	res->crit = tval(res->dof >= 1 ? (unsigned int)res->dof : 1, level);
+	if (fabs(res->t) <= res->crit)
+		res->sign = 0;
+	else
+		res->sign = (res->t > 0) ? 1 : -1;
+	return 0;
+}
+
+/* k-th smallest element (Wirth's selection), reorders the array */
+static double select_kth(double *vals, unsigned int n, unsigned int k)
+{
+	long left = 0, right = (long)n - 1;
+
+	while (left < right) {
+		double pivot = vals[k];
+		long i = left, j = right;
+
+		do {
+			while (vals[i] < pivot)
+				i++;
+			while (pivot < vals[j])
+				j--;
+			if (i <= j) {
+				double tmp = vals[i];
+
+				vals[i] = vals[j];
+				vals[j] = tmp;
+				i++;
+				j--;
+			}
+		} while (i <= j);
+		if (j < (long)k)
+			left = i;
+		if ((long)k < i)
+			right = j;
+	}
+
+	return vals[k];
+}
+
+static double median_of(double *vals, unsigned int n)
+{
+	double hi = select_kth(vals, n, n / 2);
+
+	if (n % 2)
+		return hi;
+	return (select_kth(vals, n, n / 2 - 1) + hi) / 2;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* xorshift64*, fixed seed so that repeated evaluation gives same result */
+static uint64_t bootstrap_rand(uint64_t *state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545f4914f6cdd1dULL;
+}
+
+/* Median, median absolute deviation and percentile bootstrap confidence
+ * interval of the median at given level (0 < level < 1). Unlike the t based
+ * interval, these do not assume normal distribution and a single outlier
+ * does not affect them much.
+ */
+int robust_estimate(const double *vals, unsigned int n, double level,
+		    struct robust_stats *rs)
+{
+	uint64_t state = BOOTSTRAP_SEED;
+	double *tmp, *boot;
+	unsigned int i, j;
+	double alpha;
+
+	if (!n)
+		return -EINVAL;
+	tmp = malloc(n * sizeof(tmp[0]));
+	boot = malloc(BOOTSTRAP_RESAMPLES * sizeof(boot[0]));
+	if (!tmp || !boot) {
+		free(tmp);
+		free(boot);
+		return -ENOMEM;
+	}
+
+	memcpy(tmp, vals, n * sizeof(tmp[0]));
+	rs->median = median_of(tmp, n);
+	for (i = 0; i < n; i++)
+		tmp[i] = fabs(vals[i] - rs->median);
+	rs->mad = MAD_SCALE * median_of(tmp, n);
+
+	for (i = 0; i < BOOTSTRAP_RESAMPLES; i++) {
+		for (j = 0; j < n; j++)
+			tmp[j] = vals[bootstrap_rand(&state) % n];
+		boot[i] = median_of(tmp, n);
+	}
+	qsort(boot, BOOTSTRAP_RESAMPLES, sizeof(boot[0]), cmp_double);
+	alpha = (1 - level) / 2;
+	i = alpha * (BOOTSTRAP_RESAMPLES - 1);
+	rs->ci_low = boot[i];
+	rs->ci_high = boot[BOOTSTRAP_RESAMPLES - 1 - i];
+
+	free(tmp);
+	free(boot);
+	return 0;
+}
+
+/* modified z-score 0.6745 * |x - median| / MAD, the scaled MAD already
+ * includes the factor (0.6745 * 1.4826 = 1)
+ */
+bool robust_outlier(const struct robust_stats *rs, double val)
+{
+	if (rs->mad == 0)
+		return val != rs->median;
+	return fabs(val - rs->median) > OUTLIER_THRESHOLD * rs->mad;
+}
+
 /* half width of the confidence interfal */
 double confid_interval(double sum, double sum_sqr, unsigned int n,
 		       enum confid_level level)
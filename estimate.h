@@ -2,6 +2,7 @@
 #define __NPERF_ESTIMATE_H
 
 #include <errno.h>
+#include <stdbool.h>
 
 enum confid_level {
 	CONFID_LEVEL_95,
@@ -34,7 +35,31 @@ static inline unsigned int confid_level_output(enum confid_level level)
 	}
 }
 
+/* result of comparing two sample means */
+struct welch_result {
+	double		t;		/* t statistic */
+	double		dof;		/* Welch-Satterthwaite degrees of freedom */
+	double		crit;		/* critical value of t */
+	int		sign;		/* 1 / -1 if first mean significantly
+					 * greater / smaller, 0 otherwise */
+};
+
+/* outlier resistant estimates of the center and spread of a sample */
+struct robust_stats {
+	double		median;
+	double		mad;		/* scaled to estimate standard deviation */
+	double		ci_low;		/* bootstrap confidence interval */
+	double		ci_high;	/* of the median */
+};
+
+double sdev_n1(double sum, double sum_sqr, unsigned int n);
 double confid_interval(double sum, double sum_sqr, unsigned int n,
 		       enum confid_level level);
+int welch_test(double sum1, double sum_sqr1, unsigned int n1,
+	       double sum2, double sum_sqr2, unsigned int n2,
+	       enum confid_level level, struct welch_result *res);
+int robust_estimate(const double *vals, unsigned int n, double level,
+		    struct robust_stats *rs);
+bool robust_outlier(const struct robust_stats *rs, double val);
 
 #endif /* __NPERF_ESTIMATE_H */
@@ -0,0 +1,172 @@
+#include <inttypes.h>
+#include <math.h>
+
+#include "json.h"
+
+void json_init(struct json_writer *jw, FILE *f)
+{
+	jw->f = f;
+	jw->depth = 0;
+	jw->skipped = 0;
+	jw->in_array[0] = true;
+	jw->need_comma[0] = false;
+}
+
+static void print_string(FILE *f, const char *s)
+{
+	unsigned char c;
+
+	fputc('"', f);
+	while ((c = *s++)) {
+		switch (c) {
+		case '"':
+		case '\\':
+			fputc('\\', f);
+			fputc(c, f);
+			break;
+		case '\n':
+			fputs("\\n", f);
+			break;
+		case '\t':
+			fputs("\\t", f);
+			break;
+		default:
+			if (c < 0x20)
+				fprintf(f, "\\u%04x", c);
+			else
+				fputc(c, f);
+		}
+	}
+	fputc('"', f);
+}
+
+/* Separator, indentation and key of a new value; false if the value is
+ * inside a skipped container and must not be written.
+ */
+static bool json_value_start(struct json_writer *jw, const char *key)
+{
+	unsigned int i;
+
+	if (jw->skipped)
+		return false;
+	if (jw->need_comma[jw->depth])
+		fputc(',', jw->f);
+	if (jw->depth)
+		fputc('\n', jw->f);
+	for (i = 0; i < jw->depth; i++)
+		fputs("  ", jw->f);
+	if (!jw->in_array[jw->depth]) {
+		print_string(jw->f, key ? key : "");
+		fputs(": ", jw->f);
+	}
+	jw->need_comma[jw->depth] = true;
+	return true;
+}
+
+static void json_container_start(struct json_writer *jw, const char *key,
+				 bool array)
+{
+	if (jw->skipped || jw->depth + 1 >= JSON_MAX_DEPTH) {
+		jw->skipped++;
+		return;
+	}
+	json_value_start(jw, key);
+	fputc(array ? '[' : '{', jw->f);
+	jw->depth++;
+	jw->in_array[jw->depth] = array;
+	jw->need_comma[jw->depth] = false;
+}
+
+static void json_container_end(struct json_writer *jw)
+{
+	bool array = jw->in_array[jw->depth];
+	bool empty = !jw->need_comma[jw->depth];
+	unsigned int i;
+
+	if (jw->skipped) {
+		jw->skipped--;
+		return;
+	}
+	if (!jw->depth)
+		return;
+	jw->depth--;
+	if (!empty) {
+		fputc('\n', jw->f);
+		for (i = 0; i < jw->depth; i++)
+			fputs("  ", jw->f);
+	}
+	fputc(array ? ']' : '}', jw->f);
+}
+
+void json_object_start(struct json_writer *jw, const char *key)
+{
+	json_container_start(jw, key, false);
+}
+
+void json_object_end(struct json_writer *jw)
+{
+	json_container_end(jw);
+}
+
+void json_array_start(struct json_writer *jw, const char *key)
+{
+	json_container_start(jw, key, true);
+}
+
+void json_array_end(struct json_writer *jw)
+{
+	json_container_end(jw);
+}
+
+void json_string(struct json_writer *jw, const char *key, const char *val)
+{
+	if (!json_value_start(jw, key))
+		return;
+	print_string(jw->f, val);
+}
+
+void json_uint(struct json_writer *jw, const char *key, uint64_t val)
+{
+	if (!json_value_start(jw, key))
+		return;
+	fprintf(jw->f, "%" PRIu64, val);
+}
+
+void json_int(struct json_writer *jw, const char *key, int64_t val)
+{
+	if (!json_value_start(jw, key))
+		return;
+	fprintf(jw->f, "%" PRId64, val);
+}
+
+/* JSON has no representation of infinity and NaN */
+void json_double(struct json_writer *jw, const char *key, double val)
+{
+	if (!json_value_start(jw, key))
+		return;
+	if (isfinite(val))
+		fprintf(jw->f, "%.15g", val);
+	else
+		fputs("null", jw->f);
+}
+
+void json_bool(struct json_writer *jw, const char *key, bool val)
+{
+	if (!json_value_start(jw, key))
+		return;
+	fputs(val ? "true" : "false", jw->f);
+}
+
+/* close open objects and arrays down to given nesting level */
+void json_close_to(struct json_writer *jw, unsigned int depth)
+{
+	while (jw->skipped || jw->depth > depth)
+		json_container_end(jw);
+}
+
+void json_finish(struct json_writer *jw)
+{
+	json_close_to(jw, 0);
+	fputc('\n', jw->f);
+	fflush(jw->f);
+}
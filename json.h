@@ -0,0 +1,37 @@
+#ifndef __NPERF_JSON_H
+#define __NPERF_JSON_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define JSON_MAX_DEPTH 16
+
+/* Streaming JSON writer: values are written out as soon as they are
+ * added, only the nesting state is kept. Keys are ignored inside arrays
+ * and must be provided inside objects. Containers nested deeper than
+ * JSON_MAX_DEPTH are left out with all their contents so that the output
+ * stays valid.
+ */
+struct json_writer {
+	FILE		*f;
+	unsigned int	depth;
+	unsigned int	skipped;	/* open containers beyond max depth */
+	bool		in_array[JSON_MAX_DEPTH];
+	bool		need_comma[JSON_MAX_DEPTH];
+};
+
+void json_init(struct json_writer *jw, FILE *f);
+void json_object_start(struct json_writer *jw, const char *key);
+void json_object_end(struct json_writer *jw);
+void json_array_start(struct json_writer *jw, const char *key);
+void json_array_end(struct json_writer *jw);
+void json_string(struct json_writer *jw, const char *key, const char *val);
+void json_uint(struct json_writer *jw, const char *key, uint64_t val);
+void json_int(struct json_writer *jw, const char *key, int64_t val);
+void json_double(struct json_writer *jw, const char *key, double val);
+void json_bool(struct json_writer *jw, const char *key, bool val);
+void json_close_to(struct json_writer *jw, unsigned int depth);
+void json_finish(struct json_writer *jw);
+
+#endif /* __NPERF_JSON_H */
@@ -0,0 +1,78 @@
+#include <stdio.h>
+
+#include "latency.h"
+
+const double latency_pcts[LAT_N_PCTS] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+
+/* highest value falling into a bucket */
+static uint64_t latency_bucket_high(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < 2 * LAT_SUB_BUCKETS)
+		return idx;
+	shift = idx / LAT_SUB_BUCKETS - 1;
+	return ((uint64_t)(idx % LAT_SUB_BUCKETS + LAT_SUB_BUCKETS + 1)
+		<< shift) - 1;
+}
+
+/* Value such that at least pct percent of samples are less or equal,
+ * rounded up to bucket boundary (but never above the maximum seen).
+ */
+uint64_t latency_percentile(const struct latency_hist *hist, double pct)
+{
+	uint64_t rank, seen = 0;
+	unsigned int i;
+
+	if (!hist->n)
+		return 0;
+	rank = (uint64_t)(pct / 100.0 * hist->n + 0.5);
+	if (rank < 1)
+		rank = 1;
+	if (rank > hist->n)
+		rank = hist->n;
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seen += hist->counts[i];
+		if (seen >= rank)
+			break;
+	}
+	if (i >= LAT_BUCKETS)
+		return hist->max;
+	return (latency_bucket_high(i) < hist->max) ?
+	       latency_bucket_high(i) : hist->max;
+}
+
+void latency_hist_merge(struct latency_hist *dst,
+			const struct latency_hist *src)
+{
+	unsigned int i;
+
+	if (!src->n)
+		return;
+	if (!dst->n || src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	dst->n += src->n;
+	dst->sum += src->sum;
+	for (i = 0; i < LAT_BUCKETS; i++)
+		dst->counts[i] += src->counts[i];
+}
+
+void latency_print(const struct latency_hist *hist)
+{
+	unsigned int i;
+
+	if (!hist->n) {
+		fputs("latency         no samples\n", stdout);
+		return;
+	}
+	printf("latency (us)    min %.1lf, avg %.1lf, max %.1lf\n",
+	       hist->min / 1000.0, (double)hist->sum / hist->n / 1000.0,
+	       hist->max / 1000.0);
+	fputs("               ", stdout);
+	for (i = 0; i < LAT_N_PCTS; i++)
+		printf(" p%g %.1lf%s", latency_pcts[i],
+		       latency_percentile(hist, latency_pcts[i]) / 1000.0,
+		       (i + 1 < LAT_N_PCTS) ? "," : "\n");
+}
@@ -0,0 +1,63 @@
+#ifndef __NPERF_LATENCY_H
+#define __NPERF_LATENCY_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* Log-linear histogram of latencies in nanoseconds: values below
+ * 2 * LAT_SUB_BUCKETS have their own bucket, larger ones are split into
+ * power of two ranges with LAT_SUB_BUCKETS buckets each, i.e. relative
+ * error of percentiles is at most 1 / LAT_SUB_BUCKETS (about 3%).
+ */
+#define LAT_SUB_BITS		5
+#define LAT_SUB_BUCKETS		(1U << LAT_SUB_BITS)
+#define LAT_MAX_BITS		40	/* about 18 minutes */
+#define LAT_BUCKETS		((LAT_MAX_BITS - LAT_SUB_BITS + 1) * \
+				 LAT_SUB_BUCKETS)
+
+/* percentiles shown in latency distribution */
+#define LAT_N_PCTS		5
+extern const double latency_pcts[LAT_N_PCTS];
+
+struct latency_hist {
+	uint64_t	n;
+	uint64_t	sum;		/* ns */
+	uint64_t	min;		/* ns */
+	uint64_t	max;		/* ns */
+	uint64_t	counts[LAT_BUCKETS];
+};
+
+uint64_t latency_percentile(const struct latency_hist *hist, double pct);
+void latency_hist_merge(struct latency_hist *dst,
+			const struct latency_hist *src);
+void latency_print(const struct latency_hist *hist);
+
+static inline void latency_hist_reset(struct latency_hist *hist)
+{
+	memset(hist, '\0', sizeof(*hist));
+}
+
+static inline unsigned int latency_bucket(uint64_t val)
+{
+	unsigned int shift;
+
+	if (val >= (1ULL << LAT_MAX_BITS))
+		return LAT_BUCKETS - 1;
+	if (val < 2 * LAT_SUB_BUCKETS)
+		return val;
+	shift = 63 - __builtin_clzll(val) - LAT_SUB_BITS;
+	return shift * LAT_SUB_BUCKETS + (val >> shift);
+}
+
+static inline void latency_hist_add(struct latency_hist *hist, uint64_t val)
+{
+	if (!hist->n || val < hist->min)
+		hist->min = val;
+	if (val > hist->max)
+		hist->max = val;
+	hist->n++;
+	hist->sum += val;
+	hist->counts[latency_bucket(val)]++;
+}
+
+#endif /* __NPERF_LATENCY_H */
@@ -0,0 +1,312 @@
+#include <math.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <arpa/inet.h>
+
+#include "msgdist.h"
+#include "common.h"
+
+#define MSGDIST_EXP_SEGMENTS	64
+#define MSGDIST_MAX_SIZE	INT_MAX
+
+int msgdist_alloc(struct msgdist *dist, unsigned int n)
+{
+	if (!n || n > MSGDIST_MAX_SEGMENTS)
+		return -EINVAL;
+	dist->segs = calloc(n, sizeof(dist->segs[0]));
+	if (!dist->segs)
+		return -ENOMEM;
+	dist->n = n;
+	return 0;
+}
+
+void msgdist_free(struct msgdist *dist)
+{
+	free(dist->segs);
+	dist->segs = NULL;
+	dist->n = 0;
+}
+
+static uint32_t cum_value(double p)
+{
+	if (p >= 1.0)
+		return MSGDIST_CUM_MAX;
+	if (p <= 0.0)
+		return 0;
+	return (uint32_t)(p * 4294967296.0);
+}
+
+static int msgdist_uniform(const char *arg, struct msgdist *dist)
+{
+	unsigned long lo, hi;
+	const char *next;
+	int ret;
+
+	ret = parse_ulong_range_delim("minimum size", arg, &lo, 1,
+				      MSGDIST_MAX_SIZE, '-', &next);
+	if (ret < 0)
+		return ret;
+	if (*next != '-') {
+		fputs("uniform distribution needs <min>-<max>\n", stderr);
+		return -EINVAL;
+	}
+	ret = parse_ulong_range("maximum size", next + 1, &hi, lo,
+				MSGDIST_MAX_SIZE);
+	if (ret < 0)
+		return ret;
+
+	ret = msgdist_alloc(dist, 1);
+	if (ret < 0)
+		return ret;
+	dist->segs[0] = (struct msgdist_segment){
+		.lo = lo, .hi = hi, .cum = MSGDIST_CUM_MAX
+	};
+	return 0;
+}
+
+static int msgdist_bimodal(const char *arg, struct msgdist *dist)
+{
+	unsigned long size1, size2;
+	const char *next;
+	double pct;
+	int ret;
+
+	ret = parse_ulong_range_delim("first size", arg, &size1, 1,
+				      MSGDIST_MAX_SIZE, ',', &next);
+	if (ret < 0)
+		return ret;
+	if (!*next)
+		goto err;
+	ret = parse_ulong_range_delim("second size", next + 1, &size2, 1,
+				      MSGDIST_MAX_SIZE, ',', &next);
+	if (ret < 0)
+		return ret;
+	if (!*next)
+		goto err;
+	ret = parse_double_range("first size percentage", next + 1, &pct,
+				 0.0, 100.0);
+	if (ret < 0)
+		return ret;
+
+	ret = msgdist_alloc(dist, 2);
+	if (ret < 0)
+		return ret;
+	dist->segs[0] = (struct msgdist_segment){
+		.lo = size1, .hi = size1, .cum = cum_value(pct / 100.0)
+	};
+	dist->segs[1] = (struct msgdist_segment){
+		.lo = size2, .hi = size2, .cum = MSGDIST_CUM_MAX
+	};
+	return 0;
+err:
+	fputs("bimodal distribution needs <size1>,<size2>,<pct1>\n", stderr);
+	return -EINVAL;
+}
+
+/* Exponential distribution approximated by uniform segments between its
+ * quantiles. The tail above the last quantile q is replaced by a uniform
+ * segment from q to q + 2 * mean which preserves its mean (memoryless
+ * property) unless limited by the maximum.
+ */
+static int msgdist_exp(const char *arg, struct msgdist *dist)
+{
+	unsigned long mean, max_size = 0;
+	unsigned int n = MSGDIST_EXP_SEGMENTS;
+	double prev = 0.0;
+	const char *next;
+	unsigned int i;
+	int ret;
+
+	ret = parse_ulong_range_delim("mean size", arg, &mean, 1,
+				      MSGDIST_MAX_SIZE / 16, ',', &next);
+	if (ret < 0)
+		return ret;
+	if (*next) {
+		ret = parse_ulong_range("maximum size", next + 1, &max_size,
+					1, MSGDIST_MAX_SIZE);
+		if (ret < 0)
+			return ret;
+	}
+
+	ret = msgdist_alloc(dist, n);
+	if (ret < 0)
+		return ret;
+	for (i = 0; i < n; i++) {
+		struct msgdist_segment *seg = &dist->segs[i];
+		double q;
+
+		if (i < n - 1)
+			q = -(double)mean * log(1.0 - (double)(i + 1) / n);
+		else
+			q = prev + 2.0 * mean;
+		seg->lo = (prev < 1.0) ? 1 : (uint32_t)prev + 1;
+		seg->hi = (q < seg->lo) ? seg->lo : (uint32_t)q;
+		if (max_size && seg->hi > max_size)
+			seg->hi = max_size;
+		if (seg->lo > seg->hi)
+			seg->lo = seg->hi;
+		seg->cum = (i < n - 1) ? cum_value((double)(i + 1) / n) :
+					 MSGDIST_CUM_MAX;
+		prev = q;
+	}
+	return 0;
+}
+
+/* Empirical distribution: lines "<size> <cumulative probability>" with
+ * nondecreasing values, the last probability must be 1. Sizes between two
+ * points are uniformly distributed.
+ */
+static int msgdist_cdf(const char *path, struct msgdist *dist)
+{
+	unsigned int n = 0, lineno = 0;
+	unsigned long prev_size = 0;
+	double prev_p = 0.0;
+	char line[256];
+	int ret = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		ret = -errno;
+		perror("failed to open size distribution file");
+		return ret;
+	}
+	ret = msgdist_alloc(dist, MSGDIST_MAX_SEGMENTS);
+	if (ret < 0)
+		goto out;
+	while (fgets(line, sizeof(line), f)) {
+		struct msgdist_segment *seg;
+		unsigned long size;
+		char *p = line;
+		double prob;
+
+		lineno++;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '#' || *p == '\n' || !*p)
+			continue;
+		if (sscanf(p, "%lu %lf", &size, &prob) != 2 ||
+		    size < 1 || size > MSGDIST_MAX_SIZE ||
+		    size < prev_size || prob < prev_p || prob > 1.0) {
+			ret = -EINVAL;
+			break;
+		}
+		if (n >= MSGDIST_MAX_SEGMENTS) {
+			ret = -E2BIG;
+			break;
+		}
+		seg = &dist->segs[n++];
+		seg->lo = (prev_size && size > prev_size) ? prev_size + 1 :
+							    size;
+		seg->hi = size;
+		seg->cum = cum_value(prob);
+		prev_size = size;
+		prev_p = prob;
+	}
+	if (!ret && (!n || prev_p < 1.0)) {
+		ret = -EINVAL;
+		lineno = 0;
+	}
+	if (ret < 0) {
+		if (lineno)
+			fprintf(stderr, "invalid size distribution file '%s' (line %u)\n",
+				path, lineno);
+		else
+			fprintf(stderr, "size distribution file '%s' does not end with probability 1\n",
+				path);
+		msgdist_free(dist);
+		goto out;
+	}
+	dist->n = n;
+out:
+	fclose(f);
+	return ret;
+}
+
+/* uniform:<min>-<max>, exp:<mean>[,<max>], bimodal:<size1>,<size2>,<pct1>
+ * or cdf:<file>
+ */
+int msgdist_parse(const char *spec, struct msgdist *dist)
+{
+	const char *arg = strchr(spec, ':');
+	size_t len;
+
+	dist->n = 0;
+	dist->segs = NULL;
+	if (!arg)
+		goto err;
+	len = arg++ - spec;
+	if (!strncmp(spec, "uniform", len) && len == strlen("uniform"))
+		return msgdist_uniform(arg, dist);
+	if (!strncmp(spec, "exp", len) && len == strlen("exp"))
+		return msgdist_exp(arg, dist);
+	if (!strncmp(spec, "bimodal", len) && len == strlen("bimodal"))
+		return msgdist_bimodal(arg, dist);
+	if (!strncmp(spec, "cdf", len) && len == strlen("cdf"))
+		return msgdist_cdf(arg, dist);
+err:
+	fprintf(stderr, "invalid size distribution '%s'\n", spec);
+	return -EINVAL;
+}
+
+uint32_t msgdist_max(const struct msgdist *dist)
+{
+	uint32_t max_size = 0;
+	unsigned int i;
+
+	for (i = 0; i < dist->n; i++)
+		if (dist->segs[i].hi > max_size)
+			max_size = dist->segs[i].hi;
+	return max_size;
+}
+
+double msgdist_mean(const struct msgdist *dist)
+{
+	double sum = 0.0, prev = 0.0;
+	unsigned int i;
+
+	for (i = 0; i < dist->n; i++) {
+		const struct msgdist_segment *seg = &dist->segs[i];
+		double cum = (seg->cum == MSGDIST_CUM_MAX) ?
+			     4294967296.0 : seg->cum;
+
+		sum += (cum - prev) * ((double)seg->lo + seg->hi) / 2;
+		prev = cum;
+	}
+	return sum / 4294967296.0;
+}
+
+void msgdist_hton(const struct msgdist *dist, struct msgdist_segment *dst)
+{
+	unsigned int i;
+
+	for (i = 0; i < dist->n; i++) {
+		dst[i].lo = htonl(dist->segs[i].lo);
+		dst[i].hi = htonl(dist->segs[i].hi);
+		dst[i].cum = htonl(dist->segs[i].cum);
+	}
+}
+
+/* convert received table in place and check it is usable */
+int msgdist_ntoh(struct msgdist *dist)
+{
+	uint32_t prev = 0;
+	unsigned int i;
+
+	for (i = 0; i < dist->n; i++) {
+		struct msgdist_segment *seg = &dist->segs[i];
+
+		seg->lo = ntohl(seg->lo);
+		seg->hi = ntohl(seg->hi);
+		seg->cum = ntohl(seg->cum);
+		if (!seg->lo || seg->lo > seg->hi || seg->cum < prev)
+			return -EINVAL;
+		prev = seg->cum;
+	}
+	if (dist->n && prev != MSGDIST_CUM_MAX)
+		return -EINVAL;
+	return 0;
+}
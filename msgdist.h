@@ -0,0 +1,78 @@
+#ifndef __NPERF_MSGDIST_H
+#define __NPERF_MSGDIST_H
+
+#include <stdint.h>
+
+#define MSGDIST_MAX_SEGMENTS	4096
+#define MSGDIST_CUM_MAX		UINT32_MAX
+
+/* Message size distribution as a table of segments: segment is chosen with
+ * probability proportional to the difference of its cumulative value and
+ * the one of previous segment (scaled to 2^32), size is then uniformly
+ * distributed between lo and hi (inclusive). Both ends generate the same
+ * sequence of sizes from a shared seed and client port so that message
+ * boundaries need not be transferred.
+ *
+ * all entries in network byte order (BE) when sent over control connection
+ */
+struct msgdist_segment {
+	uint32_t	lo;
+	uint32_t	hi;
+	uint32_t	cum;
+};
+
+struct msgdist {
+	unsigned int		n;
+	struct msgdist_segment	*segs;
+};
+
+int msgdist_parse(const char *spec, struct msgdist *dist);
+int msgdist_alloc(struct msgdist *dist, unsigned int n);
+void msgdist_free(struct msgdist *dist);
+uint32_t msgdist_max(const struct msgdist *dist);
+double msgdist_mean(const struct msgdist *dist);
+void msgdist_hton(const struct msgdist *dist, struct msgdist_segment *dst);
+int msgdist_ntoh(struct msgdist *dist);
+
+/* splitmix64 of the shared seed and connection client port */
+static inline uint64_t msgdist_seed(uint32_t seed, uint16_t port)
+{
+	uint64_t z = ((uint64_t)seed << 16 | port) + 0x9e3779b97f4a7c15ULL;
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	z ^= z >> 31;
+	return z ? z : 1;
+}
+
+/* next message size, state is xorshift64* generator state */
+static inline uint32_t msgdist_next(const struct msgdist *dist,
+				    uint64_t *state)
+{
+	const struct msgdist_segment *seg;
+	unsigned int lo = 0, hi = dist->n - 1;
+	uint64_t x = *state;
+	uint32_t r;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	x *= 0x2545f4914f6cdd1dULL;
+
+	r = x >> 32;
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (r <= dist->segs[mid].cum)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	seg = &dist->segs[lo];
+	if (seg->hi == seg->lo)
+		return seg->lo;
+	return seg->lo + (uint32_t)x % (seg->hi - seg->lo + 1);
+}
+
+#endif /* __NPERF_MSGDIST_H */
@@ -0,0 +1,205 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "netcnt.h"
+
+#define N_DEV_FIELDS 16
+
+static const char *const dev_fields[N_DEV_FIELDS] = {
+	"rx_bytes", "rx_packets", "rx_errs", "rx_drop", "rx_fifo",
+	"rx_frame", "rx_compressed", "rx_multicast",
+	"tx_bytes", "tx_packets", "tx_errs", "tx_drop", "tx_fifo",
+	"tx_colls", "tx_carrier", "tx_compressed",
+};
+
+int net_counters_reserve(struct net_counters *set, unsigned int n)
+{
+	struct net_counter *counters;
+	unsigned int size;
+
+	if (n <= set->size)
+		return 0;
+	size = set->size ? set->size : 256;
+	while (size < n)
+		size *= 2;
+	counters = realloc(set->counters, size * sizeof(counters[0]));
+	if (!counters)
+		return -ENOMEM;
+	set->counters = counters;
+	set->size = size;
+	return 0;
+}
+
+void net_counters_free(struct net_counters *set)
+{
+	free(set->counters);
+	set->counters = NULL;
+	set->n = set->size = 0;
+}
+
+static int add_counter(struct net_counters *set, const char *prefix,
+		       const char *name, int64_t value)
+{
+	struct net_counter *cnt;
+	int ret;
+
+	ret = net_counters_reserve(set, set->n + 1);
+	if (ret < 0)
+		return ret;
+	cnt = &set->counters[set->n++];
+	snprintf(cnt->name, sizeof(cnt->name), "%s.%s", prefix, name);
+	cnt->value = value;
+	return 0;
+}
+
+/* /proc/net/snmp and /proc/net/netstat consist of pairs of lines, first
+ * with names of counters, second with their values, both starting with
+ * the same "Proto:" prefix.
+ */
+static int read_snmp_file(const char *path, struct net_counters *snap)
+{
+	char *names = NULL, *values = NULL;
+	size_t names_size = 0, values_size = 0;
+	int ret = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	while (getline(&names, &names_size, f) > 0 &&
+	       getline(&values, &values_size, f) > 0) {
+		char *nsave, *vsave, *name, *value, *prefix;
+		size_t len;
+
+		prefix = strtok_r(names, " \n", &nsave);
+		value = strtok_r(values, " \n", &vsave);
+		if (!prefix || !value || strcmp(prefix, value)) {
+			ret = -EINVAL;
+			break;
+		}
+		len = strlen(prefix);
+		if (len && prefix[len - 1] == ':')
+			prefix[len - 1] = '\0';
+		while ((name = strtok_r(NULL, " \n", &nsave)) &&
+		       (value = strtok_r(NULL, " \n", &vsave))) {
+			ret = add_counter(snap, prefix, name,
+					  strtoll(value, NULL, 10));
+			if (ret < 0)
+				goto out;
+		}
+	}
+out:
+	free(names);
+	free(values);
+	fclose(f);
+	return ret;
+}
+
+static int read_dev_file(struct net_counters *snap)
+{
+	size_t line_size = 0;
+	char *line = NULL;
+	unsigned int n = 0;
+	int ret = 0;
+	FILE *f;
+
+	f = fopen("/proc/net/dev", "r");
+	if (!f)
+		return -errno;
+	while (getline(&line, &line_size, f) > 0) {
+		char *ifname, *p, *end;
+		unsigned int i;
+
+		/* two header lines */
+		if (++n <= 2)
+			continue;
+		p = strchr(line, ':');
+		if (!p)
+			continue;
+		*p++ = '\0';
+		ifname = line + strspn(line, " ");
+		for (i = 0; i < N_DEV_FIELDS; i++) {
+			int64_t value = strtoll(p, &end, 10);
+
+			if (end == p)
+				break;
+			p = end;
+			ret = add_counter(snap, ifname, dev_fields[i], value);
+			if (ret < 0)
+				goto out;
+		}
+	}
+out:
+	free(line);
+	fclose(f);
+	return ret;
+}
+
+/* Files which cannot be read (e.g. in a restricted container) are skipped,
+ * it is only an error if no counters were found at all.
+ */
+int net_counters_read(struct net_counters *snap)
+{
+	int ret1, ret2, ret3;
+
+	snap->n = 0;
+	ret1 = read_snmp_file("/proc/net/snmp", snap);
+	ret2 = read_snmp_file("/proc/net/netstat", snap);
+	ret3 = read_dev_file(snap);
+
+	if (ret1 == -ENOMEM || ret2 == -ENOMEM || ret3 == -ENOMEM)
+		return -ENOMEM;
+	return snap->n ? 0 : -ENOENT;
+}
+
+/* Counters usually come in the same order in both snapshots so try the
+ * same position first.
+ */
+const struct net_counter *net_counters_find(const struct net_counters *set,
+					    const char *name,
+					    unsigned int hint)
+{
+	unsigned int i;
+
+	if (hint < set->n && !strcmp(set->counters[hint].name, name))
+		return &set->counters[hint];
+	for (i = 0; i < set->n; i++)
+		if (!strcmp(set->counters[i].name, name))
+			return &set->counters[i];
+
+	return NULL;
+}
+
+/* only counters with non-zero difference are stored in delta */
+int net_counters_delta(const struct net_counters *start,
+		       const struct net_counters *end,
+		       struct net_counters *delta)
+{
+	unsigned int i;
+	int ret;
+
+	delta->n = 0;
+	for (i = 0; i < end->n; i++) {
+		const struct net_counter *cnt = &end->counters[i];
+		const struct net_counter *cnt0;
+		int64_t diff;
+
+		cnt0 = net_counters_find(start, cnt->name, i);
+		if (!cnt0)
+			continue;
+		diff = cnt->value - cnt0->value;
+		if (!diff)
+			continue;
+		ret = net_counters_reserve(delta, delta->n + 1);
+		if (ret < 0)
+			return ret;
+		delta->counters[delta->n] = *cnt;
+		delta->counters[delta->n].value = diff;
+		delta->n++;
+	}
+
+	return 0;
+}
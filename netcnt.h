@@ -0,0 +1,35 @@
+#ifndef __NPERF_NETCNT_H
+#define __NPERF_NETCNT_H
+
+#include <stdint.h>
+
+#define NET_COUNTER_NAME_LEN 48
+#define MAX_NET_COUNTERS 65536
+
+/* one counter from /proc/net/snmp, /proc/net/netstat ("Tcp.RetransSegs",
+ * "TcpExt.ListenOverflows") or /proc/net/dev ("eth0.rx_drop")
+ *
+ * value in network byte order (BE) when sent over control connection
+ */
+struct net_counter {
+	char		name[NET_COUNTER_NAME_LEN];
+	int64_t		value;
+};
+
+struct net_counters {
+	struct net_counter	*counters;
+	unsigned int		n;
+	unsigned int		size;
+};
+
+int net_counters_read(struct net_counters *snap);
+int net_counters_delta(const struct net_counters *start,
+		       const struct net_counters *end,
+		       struct net_counters *delta);
+const struct net_counter *net_counters_find(const struct net_counters *set,
+					    const char *name,
+					    unsigned int hint);
+int net_counters_reserve(struct net_counters *set, unsigned int n);
+void net_counters_free(struct net_counters *set);
+
+#endif /* __NPERF_NETCNT_H */
@@ -0,0 +1,124 @@
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perfcnt.h"
+
+const char *const perf_counter_names[PERF_CNT_COUNT] = {
+	[PERF_CNT_CYCLES]	= "cycles",
+	[PERF_CNT_INSTRUCTIONS]	= "instructions",
+	[PERF_CNT_CACHE_MISSES]	= "cache-misses",
+	[PERF_CNT_CTX_SWITCHES]	= "ctx-switches",
+	[PERF_CNT_MIGRATIONS]	= "migrations",
+	[PERF_CNT_TASK_CLOCK]	= "task-clock",
+};
+
+static const struct {
+	uint32_t	type;
+	uint64_t	config;
+} perf_events[PERF_CNT_COUNT] = {
+	[PERF_CNT_CYCLES]	= { PERF_TYPE_HARDWARE,
+				    PERF_COUNT_HW_CPU_CYCLES },
+	[PERF_CNT_INSTRUCTIONS]	= { PERF_TYPE_HARDWARE,
+				    PERF_COUNT_HW_INSTRUCTIONS },
+	[PERF_CNT_CACHE_MISSES]	= { PERF_TYPE_HARDWARE,
+				    PERF_COUNT_HW_CACHE_MISSES },
+	[PERF_CNT_CTX_SWITCHES]	= { PERF_TYPE_SOFTWARE,
+				    PERF_COUNT_SW_CONTEXT_SWITCHES },
+	[PERF_CNT_MIGRATIONS]	= { PERF_TYPE_SOFTWARE,
+				    PERF_COUNT_SW_CPU_MIGRATIONS },
+	[PERF_CNT_TASK_CLOCK]	= { PERF_TYPE_SOFTWARE,
+				    PERF_COUNT_SW_TASK_CLOCK },
+};
+
+static int perf_event_open(enum perf_counter cnt, bool user_only)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, '\0', sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = perf_events[cnt].type;
+	attr.config = perf_events[cnt].config;
+	attr.disabled = 1;
+	attr.exclude_kernel = user_only;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+			   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Counters are opened one by one so that hardware counters which are not
+ * available (e.g. in a VM) do not prevent use of software ones. If kernel
+ * cannot be counted (perf_event_paranoid), fall back to user space only.
+ */
+void perf_counters_open(struct perf_counters *pc)
+{
+	unsigned int i;
+	int fd;
+
+	pc->user_only = false;
+	for (i = 0; i < PERF_CNT_COUNT; i++) {
+		fd = perf_event_open(i, pc->user_only);
+		if (fd < 0 && (errno == EACCES || errno == EPERM) &&
+		    !pc->user_only) {
+			pc->user_only = true;
+			fd = perf_event_open(i, pc->user_only);
+		}
+		pc->fds[i] = fd;
+	}
+}
+
+void perf_counters_enable(struct perf_counters *pc)
+{
+	unsigned int i;
+
+	for (i = 0; i < PERF_CNT_COUNT; i++)
+		if (pc->fds[i] >= 0)
+			ioctl(pc->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void perf_counters_disable(struct perf_counters *pc)
+{
+	unsigned int i;
+
+	for (i = 0; i < PERF_CNT_COUNT; i++)
+		if (pc->fds[i] >= 0)
+			ioctl(pc->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+}
+
+/* values are scaled if counters were multiplexed */
+void perf_counters_read(struct perf_counters *pc, struct perf_stats *stats)
+{
+	uint64_t buff[3];	/* value, time enabled, time running */
+	unsigned int i;
+	ssize_t len;
+
+	perf_stats_reset(stats, false);
+	stats->user_only = pc->user_only;
+	for (i = 0; i < PERF_CNT_COUNT; i++) {
+		if (pc->fds[i] < 0)
+			continue;
+		len = read(pc->fds[i], buff, sizeof(buff));
+		if (len != sizeof(buff))
+			continue;
+		if (buff[2] && buff[2] < buff[1])
+			buff[0] = (double)buff[0] * buff[1] / buff[2];
+		stats->counters[i] = buff[0];
+		stats->valid |= (1U << i);
+	}
+}
+
+void perf_counters_close(struct perf_counters *pc)
+{
+	unsigned int i;
+
+	for (i = 0; i < PERF_CNT_COUNT; i++) {
+		if (pc->fds[i] >= 0)
+			close(pc->fds[i]);
+		pc->fds[i] = -1;
+	}
+}
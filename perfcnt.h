@@ -0,0 +1,61 @@
+#ifndef __NPERF_PERFCNT_H
+#define __NPERF_PERFCNT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum perf_counter {
+	PERF_CNT_CYCLES,
+	PERF_CNT_INSTRUCTIONS,
+	PERF_CNT_CACHE_MISSES,
+	PERF_CNT_CTX_SWITCHES,
+	PERF_CNT_MIGRATIONS,
+	PERF_CNT_TASK_CLOCK,	/* ns */
+
+	PERF_CNT_COUNT
+};
+
+extern const char *const perf_counter_names[PERF_CNT_COUNT];
+
+/* all entries in network byte order (BE) when sent over control connection */
+struct perf_stats {
+	uint64_t	counters[PERF_CNT_COUNT];
+	uint32_t	valid;		/* mask of counters available */
+	uint32_t	user_only;	/* kernel not counted (permissions) */
+};
+
+/* per thread set of counters, opened and read by the counted thread */
+struct perf_counters {
+	int		fds[PERF_CNT_COUNT];
+	bool		user_only;
+};
+
+void perf_counters_open(struct perf_counters *pc);
+void perf_counters_enable(struct perf_counters *pc);
+void perf_counters_disable(struct perf_counters *pc);
+void perf_counters_read(struct perf_counters *pc, struct perf_stats *stats);
+void perf_counters_close(struct perf_counters *pc);
+
+static inline void perf_stats_reset(struct perf_stats *stats, bool all_valid)
+{
+	unsigned int i;
+
+	for (i = 0; i < PERF_CNT_COUNT; i++)
+		stats->counters[i] = 0;
+	stats->valid = all_valid ? (1U << PERF_CNT_COUNT) - 1 : 0;
+	stats->user_only = 0;
+}
+
+/* only counters valid in all added entries are valid in the sum */
+static inline void perf_stats_add(struct perf_stats *dst,
+				  const struct perf_stats *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < PERF_CNT_COUNT; i++)
+		dst->counters[i] += src->counters[i];
+	dst->valid &= src->valid;
+	dst->user_only |= src->user_only;
+}
+
+#endif /* __NPERF_PERFCNT_H */
@@ -1,39 +1,39 @@
+#define _GNU_SOURCE
 #include <pthread.h>
+#include <sched.h>
 #include <string.h>
 #include <errno.h>
 #include <malloc.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
 #include <netinet/in.h>
 #include <netinet/ip6.h>
 #include <netinet/tcp.h>
 
 #include "../common.h"
 #include "control.h"
+#include "session.h"
 #include "worker.h"
 
 #define MIN_SKTBUF 65536
 #define SKTBUF_ALIGN 65536
 #define MIN_LISTEN_BACKLOG 16
 #define MAX_LISTEN_BACKLOG 16384
+#define MAX_ACCEPT_THREADS 1024
 
-struct server_ctrl_config {
-	unsigned int			mode;
-	unsigned int			n_threads;
-	unsigned int			msg_size;
-	bool				tcp_nodelay;
-	uint16_t			port;
-	unsigned char			*buffers;
-	unsigned long			buff_size;
-	unsigned long			buffers_size;
-	struct server_worker_data	*workers_data;
-	int				ctrl_sd;
+struct accept_shard {
+	struct server_ctrl_config	*config;
+	int				sd;
+	int				cpu;
+	pthread_t			tid;
 	int				status;
 };
-static struct server_ctrl_config config;
-
-struct client_ctrl_msg client_msg;
 
 static struct server_worker_data *worker_data(struct server_ctrl_config
 					      *config, unsigned int i)
@@ -41,9 +41,202 @@ static struct server_worker_data *worker_data(struct server_ctrl_config
 	return config->workers_data + i;
 }
 
+static void cleanup_buffers(struct server_ctrl_config *config)
+{
+	if (!config->buffers)
+		return;
+	munmap(config->buffers, config->buffers_size);
+	config->buffers = NULL;
+	config->buffers_size = 0;
+}
+
+/* size distribution table, number of segments given by attribute length */
+static int ctrl_parse_msgdist(struct server_ctrl_config *config,
+			      const struct ctrl_attr *attr)
+{
+	struct msgdist *dist = &config->msg_dist;
+	uint32_t len = ctrl_attr_len(attr);
+	unsigned int n = len / sizeof(dist->segs[0]);
+	int ret;
+
+	msgdist_free(dist);
+	if (!n || len % sizeof(dist->segs[0]))
+		return -EINVAL;
+	ret = msgdist_alloc(dist, n);
+	if (ret < 0)
+		return ret;
+	memcpy(dist->segs, ctrl_attr_data(attr), len);
+	ret = msgdist_ntoh(dist);
+	if (ret < 0) {
+		msgdist_free(dist);
+		return ret;
+	}
+
+	return 0;
+}
+
+static int ctrl_parse_sockopt(struct server_ctrl_config *config,
+			      const struct ctrl_attr *attr)
+{
+	struct sockopt opt;
+	int ret;
+
+	if (config->n_sockopts >= SOCKOPT_MAX)
+		return -EINVAL;
+	ret = ctrl_attr_struct(attr, &opt, sizeof(opt));
+	if (ret < 0)
+		return ret;
+	sockopt_ntoh(&opt, &config->sockopts[config->n_sockopts++], 1);
+
+	return 0;
+}
+
+static int ctrl_parse_service(struct server_ctrl_config *config,
+			      const struct ctrl_attr *attr)
+{
+	struct ctrl_service svc;
+	int ret;
+
+	ret = ctrl_attr_struct(attr, &svc, sizeof(svc));
+	if (ret < 0)
+		return ret;
+	config->service_type = ntohl(svc.type);
+	config->service_arg1 = ntohl(svc.arg1);
+	config->service_arg2 = ntohl(svc.arg2);
+
+	return 0;
+}
+
+static void ctrl_reset_config(struct server_ctrl_config *config)
+{
+	config->mode = MODE_COUNT;
+	config->n_threads = 0;
+	config->msg_size = 0;
+	config->resp_size = 0;
+	config->size_seed = 0;
+	msgdist_free(&config->msg_dist);
+	config->verify = false;
+	config->service_type = SERVICE_NONE;
+	config->service_arg1 = 0;
+	config->service_arg2 = 0;
+	config->congestion[0] = '\0';
+	config->n_sockopts = 0;
+	config->tcp_nodelay = false;
+	config->accept_threads = 1;	/* single listener */
+	config->cpu_steering = false;
+	config->perf_counters = false;
+	config->tcp_info = false;
+	config->tcp_info_interval = 0;
+	config->net_counters = false;
+	config->unsupported = false;
+}
+
+/* Attributes missing from the request keep their defaults (feature off,
+ * one data listener).
+ * An unknown mandatory attribute means the client asks for something this
+ * server cannot do; the test is then refused with CTRL_STATUS_UNSUPPORTED.
+ */
+static int ctrl_parse_test(struct server_ctrl_config *config)
+{
+	const struct ctrl_attr *attr;
+	struct ctrl_attr_iter it;
+	int ret = 0;
+
+	ctrl_reset_config(config);
+	config->test_id = ctrl_msg_test_id(&config->msg);
+	ctrl_iter_msg(&it, &config->msg);
+	while (ret == 0 && (attr = ctrl_iter_next(&it))) {
+		switch (ctrl_attr_type(attr)) {
+		case CA_MODE:
+			ret = ctrl_attr_u32(attr, &config->mode);
+			break;
+		case CA_THREADS:
+			ret = ctrl_attr_u32(attr, &config->n_threads);
+			break;
+		case CA_MSG_SIZE:
+			ret = ctrl_attr_u32(attr, &config->msg_size);
+			break;
+		case CA_RESP_SIZE:
+			ret = ctrl_attr_u32(attr, &config->resp_size);
+			break;
+		case CA_SIZE_SEED:
+			ret = ctrl_attr_u32(attr, &config->size_seed);
+			break;
+		case CA_ACCEPT_THREADS:
+			ret = ctrl_attr_u32(attr, &config->accept_threads);
+			break;
+		case CA_TCP_INFO:
+			config->tcp_info = true;
+			ret = ctrl_attr_u32(attr, &config->tcp_info_interval);
+			break;
+		case CA_TCP_NODELAY:
+			config->tcp_nodelay = true;
+			break;
+		case CA_CPU_STEERING:
+			config->cpu_steering = true;
+			break;
+		case CA_PERF_COUNTERS:
+			config->perf_counters = true;
+			break;
+		case CA_NET_COUNTERS:
+			config->net_counters = true;
+			break;
+		case CA_VERIFY:
+			config->verify = true;
+			break;
+		case CA_MSG_DIST:
+			ret = ctrl_parse_msgdist(config, attr);
+			break;
+		case CA_SERVICE:
+			ret = ctrl_parse_service(config, attr);
+			break;
+		case CA_CONGESTION:
+			ret = ctrl_attr_string(attr, config->congestion,
+					       CC_NAME_MAX);
+			break;
+		case CA_SOCKOPT:
+			ret = ctrl_parse_sockopt(config, attr);
+			break;
+		default:
+			if (ctrl_attr_mandatory(attr))
+				config->unsupported = true;
+			break;
+		}
+	}
+	if (ret == 0)
+		ret = it.error;
+
+	return ret;
+}
+
+/* Wait for the next test request, answering capability queries. */
+static int ctrl_recv_test(struct server_ctrl_config *config)
+{
+	int ret;
+
+	for (;;) {
+		ret = ctrl_msg_recv(config->ctrl_sd, &config->msg);
+		if (ret < 0)
+			return ret;
+		switch (ctrl_msg_type(&config->msg)) {
+		case CTRL_MSG_TEST:
+			return 0;
+		case CTRL_MSG_HELLO:
+			ctrl_msg_init(&config->msg, CTRL_MSG_HELLO, 0);
+			ctrl_put_u64(&config->msg, CA_CAPS, 0, CTRL_CAPS_ALL);
+			ret = ctrl_msg_send(config->ctrl_sd, &config->msg);
+			if (ret < 0)
+				return ret;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+}
 
 static int ctrl_get_config(struct server_ctrl_config *config)
 {
+	unsigned long buffers_size;
 	long page_size;
 	int ret;
 
@@ -51,74 +244,148 @@ static int ctrl_get_config(struct server_ctrl_config *config)
 	if (page_size < 0)
 		return -EFAULT;
 
-	ret = ctrl_recv_msg(config->ctrl_sd, &client_msg, sizeof(client_msg));
-	if (ret < 0) {
-		close(config->ctrl_sd);
+	ret = ctrl_recv_test(config);
+	if (ret < 0)
+		return (ret == -ENOTCONN) ? ret : -EINVAL;
+	ret = ctrl_parse_test(config);
+	if (ret < 0)
 		return -EINVAL;
-	}
 
-	config->mode = ntohl(client_msg.mode);
-	config->n_threads = ntohl(client_msg.n_threads);
-	config->msg_size = ntohl(client_msg.msg_size);
-	config->tcp_nodelay = client_msg.tcp_nodelay;
-	config->buff_size = ROUND_UP(config->msg_size, page_size);
-	config->buffers_size = config->n_threads * config->buff_size;
-	config->buffers_size +=
+	if (config->mode >= MODE_COUNT || !config->n_threads ||
+	    !config->msg_size ||
+	    msgdist_max(&config->msg_dist) > config->msg_size)
+		return -EINVAL;
+	if (config->service_type >= SERVICE_COUNT ||
+	    (config->service_type == SERVICE_TOUCH &&
+	     config->service_arg1 > SERVICE_TOUCH_MAX) ||
+	    (config->service_type != SERVICE_TOUCH &&
+	     (config->service_arg1 > SERVICE_SPIN_MAX ||
+	      config->service_arg2 > SERVICE_SPIN_MAX)) ||
+	    (config->service_type == SERVICE_UNIFORM &&
+	     config->service_arg2 < config->service_arg1))
+		return -EINVAL;
+	config->buff_size = ROUND_UP(config->msg_size > config->resp_size ?
+				     config->msg_size : config->resp_size,
+				     page_size);
+	buffers_size = config->n_threads * config->buff_size;
+	buffers_size +=
 		ROUND_UP(config->n_threads * sizeof(struct server_worker_data),
 			 page_size);
+	config->buffers_needed = buffers_size;
 
 	return 0;
 }
 
+/* Buffers are kept for the whole control session and only reallocated if
+ * a test needs more than previous ones.
+ */
 static int prepare_buffers(struct server_ctrl_config *config)
 {
 	unsigned int i;
 	int ret;
 
-	config->buffers = mmap(NULL, config->buffers_size,
-			       PROT_READ | PROT_WRITE,
-			       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-	if (config->buffers == MAP_FAILED) {
-		ret = -errno;
-		fprintf(stderr, "failed to allocate buffers\n");
-		return ret;
+	if (config->buffers_needed > config->buffers_size) {
+		cleanup_buffers(config);
+		config->buffers = mmap(NULL, config->buffers_needed,
+				       PROT_READ | PROT_WRITE,
+				       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (config->buffers == MAP_FAILED) {
+			ret = -errno;
+			config->buffers = NULL;
+			config->buffers_size = 0;
+			fprintf(stderr, "failed to allocate buffers\n");
+			return ret;
+		}
+		config->buffers_size = config->buffers_needed;
 	}
 	config->workers_data = (struct server_worker_data *)
 	       (config->buffers + config->n_threads * config->buff_size);
+	memset(config->workers_data, '\0',
+	       config->n_threads * sizeof(struct server_worker_data));
 
 	for (i = 0; i < config->n_threads; i++) {
 		struct server_worker_data *wdata = worker_data(config, i);
 
 		wdata->id = i;
+		wdata->sd = -1;
 		wdata->buff = config->buffers + i * config->buff_size;
 		wdata->msg_size = config->msg_size;
+		wdata->resp_size = config->resp_size;
+		wdata->msg_dist = config->msg_dist.n ? &config->msg_dist : NULL;
+		wdata->size_seed = config->size_seed;
+		wdata->verify = config->verify;
+		wdata->service_type = (config->mode == MODE_TCP_RR) ?
+				      config->service_type : SERVICE_NONE;
+		wdata->service_arg1 = config->service_arg1;
+		wdata->service_arg2 = config->service_arg2;
 		wdata->reply = (config->mode == MODE_TCP_RR);
+		wdata->perf = config->perf_counters;
+		wdata->tcp_info = config->tcp_info;
+		wdata->tcp_info_interval = config->tcp_info_interval;
 	}
 
 	return 0;
 }
 
-static void cleanup_buffers(struct server_ctrl_config *config)
+/* Memory touched by SERVICE_TOUCH (a private region per thread) is set up
+ * before the test is accepted so that a test needing more than the server
+ * allows or can get is refused instead of running with failed workers.
+ */
+static enum ctrl_status alloc_service_buffers(struct server_ctrl_config *config)
 {
-	munmap(config->buffers, config->buffers_size);
+	size_t stride;
+	unsigned int i;
+
+	if (config->mode != MODE_TCP_RR ||
+	    config->service_type != SERVICE_TOUCH)
+		return CTRL_STATUS_OK;
+	stride = ROUND_UP((size_t)config->service_arg1, CACHELINE_SIZE);
+	if ((uint64_t)stride * config->n_threads > SERVICE_TOUCH_TOTAL_MAX)
+		return CTRL_STATUS_MEMORY_LIMIT;
+	config->service_buffers_size = stride * config->n_threads;
+	config->service_buffers = mmap(NULL, config->service_buffers_size,
+				       PROT_READ | PROT_WRITE,
+				       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (config->service_buffers == MAP_FAILED) {
+		config->service_buffers = NULL;
+		config->service_buffers_size = 0;
+		return CTRL_STATUS_MEMORY_LIMIT;
+	}
+	for (i = 0; i < config->n_threads; i++)
+		worker_data(config, i)->service_buff =
+			config->service_buffers + i * stride;
+
+	return CTRL_STATUS_OK;
+}
+
+static void free_service_buffers(struct server_ctrl_config *config)
+{
+	if (!config->service_buffers)
+		return;
+	munmap(config->service_buffers, config->service_buffers_size);
+	config->service_buffers = NULL;
+	config->service_buffers_size = 0;
 }
 
-static int setup_listener(struct server_ctrl_config *config)
+/* Open one data listener on given port (0 for an ephemeral one). Sharded
+ * listeners share the port using SO_REUSEPORT and are non-blocking as they
+ * are polled by accept threads.
+ */
+static int open_listener(uint16_t port, bool sharded, unsigned int backlog)
 {
 	union sockaddr_any addr = {
 		.sa6 = {
 			.sin6_family    = AF_INET6,
-			.sin6_port      = htons(0),
+			.sin6_port      = htons(port),
 			.sin6_addr      = IN6ADDR_ANY_INIT,
 		}
 	};
-	unsigned int listen_backlog = config->n_threads;
-	socklen_t addr_len = sizeof(addr);
 	int val;
 	int ret;
 	int sd;
 
-	sd = socket(PF_INET6, SOCK_STREAM, IPPROTO_TCP);
+	sd = socket(PF_INET6, SOCK_STREAM | (sharded ? SOCK_NONBLOCK : 0),
+		    IPPROTO_TCP);
 	if (sd < 0) {
 		ret = -errno;
 		perror("socket");
@@ -130,22 +397,51 @@ static int setup_listener(struct server_ctrl_config *config)
 	if (ret < 0) {
 		ret = -errno;
 		perror("setsockopt(IPV6_V6ONLY)");
-		return ret;
+		goto err;
 	}
 	val = 1;
 	ret = setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
 	if (ret < 0) {
 		ret = -errno;
 		perror("setsockopt(SO_REUSEADDR)");
-		return ret;
+		goto err;
+	}
+	if (sharded) {
+		val = 1;
+		ret = setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, &val,
+				 sizeof(val));
+		if (ret < 0) {
+			ret = -errno;
+			perror("setsockopt(SO_REUSEPORT)");
+			goto err;
+		}
 	}
 
 	ret = bind(sd, (struct sockaddr *)&addr.sa, sizeof(addr.sa6));
 	if (ret < 0) {
 		ret = -errno;
 		perror("bind");
-		return ret;
+		goto err;
+	}
+	ret = listen(sd, backlog);
+	if (ret < 0) {
+		ret = -errno;
+		perror("listen");
+		goto err;
 	}
+
+	return sd;
+err:
+	close(sd);
+	return ret;
+}
+
+static int listener_port(int sd)
+{
+	union sockaddr_any addr;
+	socklen_t addr_len = sizeof(addr);
+	int ret;
+
 	ret = getsockname(sd, &addr.sa, &addr_len);
 	if (ret < 0) {
 		ret = -errno;
@@ -158,153 +454,575 @@ static int setup_listener(struct server_ctrl_config *config)
 			addr.sa.sa_family);
 		return -EINVAL;
 	}
-	config->port = ret;
+
+	return ret;
+}
+
+/* Classic BPF program selecting the listener with index equal to the CPU
+ * which received the connection request. As listeners are opened (bound) in
+ * CPU order, the connection is accepted by the accept thread bound to the
+ * same CPU.
+ */
+static int attach_cpu_steering(int sd)
+{
+	struct sock_filter code[] = {
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+	struct sock_fprog prog = {
+		.len	= sizeof(code) / sizeof(code[0]),
+		.filter	= code,
+	};
+	int ret;
+
+	ret = setsockopt(sd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+			 sizeof(prog));
+	if (ret < 0) {
+		ret = -errno;
+		perror("setsockopt(SO_ATTACH_REUSEPORT_CBPF)");
+		return ret;
+	}
+
+	return 0;
+}
+
+static void close_listeners(struct server_ctrl_config *config)
+{
+	unsigned int i;
+
+	for (i = 0; i < config->n_listeners; i++)
+		close(config->listen_sds[i]);
+	free(config->listen_sds);
+	config->listen_sds = NULL;
+	config->n_listeners = 0;
+	config->listen_backlog = 0;
+}
+
+static unsigned int listener_count(const struct server_ctrl_config *config)
+{
+	unsigned int n_listeners = config->accept_threads;
+	long ncpus;
+
+	if (config->cpu_steering || !n_listeners) {
+		ncpus = sysconf(config->cpu_steering ? _SC_NPROCESSORS_CONF :
+						       _SC_NPROCESSORS_ONLN);
+		n_listeners = (ncpus > 0) ? ncpus : 1;
+	}
+	if (n_listeners > MAX_ACCEPT_THREADS)
+		n_listeners = MAX_ACCEPT_THREADS;
+
+	return n_listeners;
+}
+
+static int setup_listeners(struct server_ctrl_config *config)
+{
+	unsigned int n_listeners = listener_count(config);
+	unsigned int listen_backlog = config->n_threads;
+	bool sharded = (n_listeners > 1);
+	unsigned int i;
+	int ret;
+	int sd;
 
 	if (listen_backlog < MIN_LISTEN_BACKLOG)
 		listen_backlog = MIN_LISTEN_BACKLOG;
 	if (listen_backlog > MAX_LISTEN_BACKLOG)
 		listen_backlog = MAX_LISTEN_BACKLOG;
-	ret = listen(sd, listen_backlog);
-	if (ret < 0) {
-		ret = -errno;
-		perror("listen");
-		return ret;
+
+	/* listeners are reused by all tests of the session */
+	if (config->n_listeners == n_listeners &&
+	    config->steering_attached == config->cpu_steering) {
+		if (listen_backlog <= config->listen_backlog)
+			return 0;
+		for (i = 0; i < n_listeners; i++) {
+			ret = listen(config->listen_sds[i], listen_backlog);
+			if (ret < 0) {
+				ret = -errno;
+				perror("listen");
+				return ret;
+			}
+		}
+		config->listen_backlog = listen_backlog;
+		return 0;
 	}
 
-	return sd;
+	close_listeners(config);
+	config->listen_sds = calloc(n_listeners, sizeof(config->listen_sds[0]));
+	if (!config->listen_sds)
+		return -ENOMEM;
+	for (i = 0; i < n_listeners; i++) {
+		sd = open_listener(i ? config->port : 0, sharded,
+				   listen_backlog);
+		if (sd < 0) {
+			ret = sd;
+			goto err;
+		}
+		config->listen_sds[config->n_listeners++] = sd;
+		if (i)
+			continue;
+
+		ret = listener_port(sd);
+		if (ret < 0)
+			goto err;
+		config->port = ret;
+		if (config->cpu_steering && sharded) {
+			ret = attach_cpu_steering(sd);
+			if (ret < 0)
+				goto err;
+		}
+	}
+	config->listen_backlog = listen_backlog;
+	config->steering_attached = config->cpu_steering;
+
+	return 0;
+err:
+	close_listeners(config);
+	return ret;
 }
 
-static int ctrl_send_start(struct server_ctrl_config *config)
+static int ctrl_send_start(struct server_ctrl_config *config,
+			   enum ctrl_status status)
 {
-	struct server_start_msg msg = {
-		.length		= htonl(sizeof(msg)),
-		.version	= htonl(CTRL_VERSION),
-		.test_id	= client_msg.test_id,
-	};
+	struct ctrl_msg *msg = &config->msg;
 	int ret;
 
-	msg.port = htons(config->port);
-	ret = ctrl_send_msg(config->ctrl_sd, &msg, sizeof(msg));
+	ctrl_msg_init(msg, CTRL_MSG_START, config->test_id);
+	ctrl_put_u32(msg, CA_STATUS, 0, status);
+	if (status == CTRL_STATUS_OK)
+		ctrl_put_u32(msg, CA_PORT, 0, config->port);
+	ret = ctrl_msg_send(config->ctrl_sd, msg);
 	if (ret < 0)
 		return -EFAULT;
 
 	return 0;
 }
 
-static int ctrl_run_test(int sd, struct server_ctrl_config *config)
+/* Accept one data connection and start its worker. Returns 1 when all
+ * connections of the test have been accepted, 0 if more are expected.
+ */
+static int accept_one(struct server_ctrl_config *config, int sd)
 {
-	unsigned int n_threads = config->n_threads;
 	union sockaddr_any client_addr = {};
+	struct server_worker_data *wdata;
 	socklen_t addr_len;
-	unsigned int i, n;
+	unsigned int n, i;
 	int csd;
 	int ret;
 
-	n = 0;
-	while (n < n_threads) {
-		struct server_worker_data *wdata;
-
-		addr_len = sizeof(client_addr);
-		csd = accept(sd, &client_addr.sa, &addr_len);
-		if (csd < 0) {
+	addr_len = sizeof(client_addr);
+	csd = accept(sd, &client_addr.sa, &addr_len);
+	if (csd < 0) {
+		if (errno != EAGAIN && errno != EINTR)
 			perror("accept");
-			continue;
-		}
+		return 0;
+	}
+	n = __atomic_fetch_add(&config->n_accepted, 1, __ATOMIC_RELAXED);
+	if (n >= config->n_threads) {
+		close(csd);
+		return 1;
+	}
 
-		wdata = worker_data(config, n);
-		ret = sockaddr_get_port(&client_addr);
+	wdata = worker_data(config, n);
+	ret = sockaddr_get_port(&client_addr);
+	if (ret < 0)
+		goto err;
+	wdata->client_port = ret;
+	wdata->sd = csd;
+	if (config->congestion[0]) {
+		ret = setsockopt(csd, SOL_TCP, TCP_CONGESTION,
+				 config->congestion,
+				 strlen(config->congestion));
 		if (ret < 0) {
-			close(csd);
-			goto failed;
+			perror("setsockopt(TCP_CONGESTION)");
+			goto err;
 		}
-		wdata->client_port = ret;
-		wdata->sd = csd;
-		ret = start_worker(wdata);
+	}
+	for (i = 0; i < config->n_sockopts; i++) {
+		ret = sockopt_apply(csd, &config->sockopts[i]);
+		if (ret < 0)
+			goto err;
+		if (n == 0)
+			sockopt_read(csd, &config->sockopts[i],
+				     &config->sockopt_values[i]);
+	}
+	ret = start_worker(wdata);
+	if (ret < 0)
+		goto err;
+	wdata->started = true;
+
+	n = __atomic_add_fetch(&config->n_started, 1, __ATOMIC_ACQ_REL);
+	if (n < config->n_threads)
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &config->setup_end);
+	return 1;
+err:
+	close(csd);
+	wdata->sd = -1;
+	return -EFAULT;
+}
+
+static void *accept_main(void *_data)
+{
+	struct accept_shard *shard = _data;
+	struct server_ctrl_config *config = shard->config;
+	struct pollfd pfds[3] = {
+		{ .fd = shard->sd,		.events = POLLIN },
+		{ .fd = config->wake_fds[0],	.events = POLLIN },
+		{ .fd = config->ctrl_sd,	.events = POLLIN },
+	};
+	cpu_set_t cpus;
+	int ret;
+
+	if (shard->cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(shard->cpu, &cpus);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	}
+
+	while (true) {
+		ret = poll(pfds, 3, -1);
 		if (ret < 0) {
-			close(csd);
-			goto failed;
+			if (errno == EINTR)
+				continue;
+			shard->status = -errno;
+			break;
 		}
+		if (pfds[1].revents)
+			break;
+		/* client gave up the test (e.g. some connections failed) */
+		if (pfds[2].revents) {
+			shard->status = -ECONNABORTED;
+			break;
+		}
+		if (!(pfds[0].revents & POLLIN))
+			continue;
+		ret = accept_one(config, shard->sd);
+		if (ret < 0)
+			shard->status = ret;
+		if (ret != 0)
+			break;
+	}
 
-		n++;
+	/* wake up the other accept threads, pipe is never drained */
+	ret = write(config->wake_fds[1], "", 1);
+	return NULL;
+}
+
+/* One accept thread per sharded listener; with CPU steering, threads are
+ * bound to the CPU their listener is selected for (and so are the workers
+ * they start). A single listener is served by the control thread itself.
+ */
+static int run_accept_shards(struct server_ctrl_config *config)
+{
+	unsigned int n_shards = config->n_listeners;
+	struct accept_shard *shards;
+	unsigned int i, n;
+	int ret;
+
+	shards = calloc(n_shards, sizeof(shards[0]));
+	if (!shards)
+		return -ENOMEM;
+	ret = pipe(config->wake_fds);
+	if (ret < 0) {
+		ret = -errno;
+		goto out_free;
 	}
 
+	if (n_shards == 1) {
+		shards[0].config = config;
+		shards[0].sd = config->listen_sds[0];
+		shards[0].cpu = -1;
+		accept_main(&shards[0]);
+		ret = shards[0].status;
+		goto out_pipe;
+	}
+	for (n = 0; n < n_shards; n++) {
+		struct accept_shard *shard = &shards[n];
+
+		shard->config = config;
+		shard->sd = config->listen_sds[n];
+		shard->cpu = config->cpu_steering ? (int)n : -1;
+		ret = pthread_create(&shard->tid, NULL, accept_main, shard);
+		if (ret) {
+			ret = write(config->wake_fds[1], "", 1);
+			ret = -EFAULT;
+			break;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		pthread_join(shards[i].tid, NULL);
+		if (shards[i].status < 0)
+			ret = shards[i].status;
+	}
+
+out_pipe:
+	close(config->wake_fds[0]);
+	close(config->wake_fds[1]);
+out_free:
+	free(shards);
+	return ret;
+}
+
+static int ctrl_run_test(struct server_ctrl_config *config)
+{
+	unsigned int n_threads = config->n_threads;
+	struct cpu_sample cpu_end = {};
+	unsigned int i;
+	int ret;
+
+	config->n_accepted = 0;
+	config->n_started = 0;
+	clock_gettime(CLOCK_MONOTONIC, &config->setup_start);
+	ret = run_accept_shards(config);
+	if (ret < 0 || config->n_started < n_threads)
+		goto failed;
+	config->setup_time =
+		(config->setup_end.tv_sec - config->setup_start.tv_sec) +
+		1E-9 * (config->setup_end.tv_nsec - config->setup_start.tv_nsec);
+	memset(&config->cpu_start, '\0', sizeof(config->cpu_start));
+	cpu_sample_read(&config->cpu_start);
+	config->net_delta.n = 0;
+	if (config->net_counters)
+		net_counters_read(&config->net_start);
+
 	for (i = 0; i < n_threads; i++)
 		pthread_join(worker_data(config, i)->tid, NULL);
 
+	cpu_sample_read(&cpu_end);
+	cpu_usage_delta(&config->cpu_start, &cpu_end, &config->cpu_usage);
+	if (config->net_counters &&
+	    net_counters_read(&config->net_end) == 0)
+		net_counters_delta(&config->net_start, &config->net_end,
+				   &config->net_delta);
+	if (config->net_delta.n > MAX_NET_COUNTERS)
+		config->net_delta.n = MAX_NET_COUNTERS;
+
 	return 0;
 failed:
-	close(sd);
-	for (i = 0; i < n; i++) {
-		pthread_cancel(worker_data(config, i)->tid);
+	/* buffers and worker data are reused by the next test */
+	for (i = 0; i < n_threads; i++) {
+		struct server_worker_data *wdata = worker_data(config, i);
+
+		if (wdata->started)
+			pthread_cancel(wdata->tid);
+	}
+	for (i = 0; i < n_threads; i++) {
+		struct server_worker_data *wdata = worker_data(config, i);
+
+		if (wdata->started)
+			pthread_join(wdata->tid, NULL);
+		if (wdata->sd >= 0)
+			close(wdata->sd);
+		wdata->sd = -1;
 	}
 	return -EFAULT;
 }
 
+/* Metrics of features the test did not ask for are left out. */
+static void ctrl_put_thread(struct server_ctrl_config *config,
+			    const struct server_worker_data *wd)
+{
+	struct ctrl_msg *msg = &config->msg;
+	struct ctrl_service_stats svc;
+	struct tcpinfo_stats tcpinfo;
+	struct ctrl_verify verify;
+	struct perf_stats perf;
+	struct xfer_stats xfer;
+
+	ctrl_nest_start(msg, CA_THREAD);
+	ctrl_put_u32(msg, CA_T_CLIENT_PORT, 0, wd->client_port);
+	xfer_stats_hton(&wd->stats, &xfer);
+	ctrl_put(msg, CA_T_XFER, 0, &xfer, sizeof(xfer));
+	ctrl_put_u64(msg, CA_T_CPU_USEC, 0, wd->cpu_usec);
+	if (config->perf_counters) {
+		perf_stats_hton(&wd->perf_stats, &perf);
+		ctrl_put(msg, CA_T_PERF, 0, &perf, sizeof(perf));
+	}
+	if (config->tcp_info) {
+		tcpinfo_stats_hton(&wd->tcpinfo, &tcpinfo);
+		ctrl_put(msg, CA_T_TCP_INFO, 0, &tcpinfo, sizeof(tcpinfo));
+	}
+	if (config->verify) {
+		verify.errors = hton64(wd->verify_errors);
+		verify.usec = hton64(wd->verify_nsec / 1000);
+		ctrl_put(msg, CA_T_VERIFY, 0, &verify, sizeof(verify));
+	}
+	if (config->service_type != SERVICE_NONE) {
+		svc.count = hton64(wd->service_count);
+		svc.nsec = hton64(wd->service_nsec);
+		svc.max_nsec = hton64(wd->service_max_nsec);
+		ctrl_put(msg, CA_T_SERVICE, 0, &svc, sizeof(svc));
+	}
+	ctrl_nest_end(msg);
+}
+
 static int ctrl_send_end(struct server_ctrl_config *config)
 {
-	struct server_end_msg msg = {
-		.length		= htonl(sizeof(msg)),
-		.version	= htonl(CTRL_VERSION),
-		.test_id	= client_msg.test_id,
-		.status		= htonl(config->status),
-		.thread_length	= htonl(sizeof(struct server_thread_info)),
-		.n_threads	= htonl(config->n_threads),
+	struct ctrl_cpu_usage cpu = {
+		.n_cpus		= htonl(config->cpu_usage.n_cpus),
+		.busy_usec	= hton64(config->cpu_usage.busy_usec),
+		.total_usec	= hton64(config->cpu_usage.total_usec),
 	};
-	struct server_thread_info tinfo;
-	int sd = config->ctrl_sd;
+	struct ctrl_msg *msg = &config->msg;
+	struct ctrl_sockopt_value val;
+	struct net_counter cnt;
 	unsigned int i;
-	int ret;
 
-	ret = ctrl_send_msg(sd, &msg, sizeof(msg));
-	if (ret < 0)
-		return -EFAULT;
+	ctrl_msg_init(msg, CTRL_MSG_END, config->test_id);
+	ctrl_put_u32(msg, CA_STATUS, 0, config->status);
+	ctrl_put_u32(msg, CA_SETUP_USEC, 0, config->setup_time * 1E6);
+	ctrl_put(msg, CA_CPU_USAGE, 0, &cpu, sizeof(cpu));
+	for (i = 0; i < config->n_threads; i++)
+		ctrl_put_thread(config, worker_data(config, i));
+	for (i = 0; i < config->net_delta.n; i++) {
+		cnt = config->net_delta.counters[i];
+		cnt.value = hton64(cnt.value);
+		ctrl_put(msg, CA_NET_COUNTER, 0, &cnt, sizeof(cnt));
+	}
+	for (i = 0; i < config->n_sockopts; i++) {
+		val.index = htonl(i);
+		val.value = htonl(config->sockopt_values[i]);
+		ctrl_put(msg, CA_SOCKOPT_VALUE, 0, &val, sizeof(val));
+	}
 
-	for (i = 0; i < config->n_threads; i++) {
-		const struct server_worker_data *wd = worker_data(config, i);
+	return ctrl_msg_send(config->ctrl_sd, msg);
+}
 
-		memset(&tinfo, '\0', sizeof(tinfo));
-		xfer_stats_hton(&wd->stats, &tinfo.stats);
-		tinfo.client_port = htons(wd->client_port);
+/* Try requested congestion control and socket options on a socket of the
+ * same kind as data sockets before accepting the test so that e.g. an
+ * algorithm not allowed by net.ipv4.tcp_allowed_congestion_control or an
+ * option needing CAP_NET_ADMIN is refused with a reason.
+ */
+static enum ctrl_status check_socket_options(struct server_ctrl_config *config)
+{
+	enum ctrl_status status = CTRL_STATUS_OK;
+	unsigned int i;
+	int ret;
+	int sd;
 
-		ret = ctrl_send_msg(sd, &tinfo, sizeof(tinfo));
+	if (!config->congestion[0] && !config->n_sockopts)
+		return CTRL_STATUS_OK;
+	sd = socket(PF_INET6, SOCK_STREAM, IPPROTO_TCP);
+	if (sd < 0)
+		return CTRL_STATUS_SOCKOPT;
+	if (config->congestion[0]) {
+		ret = setsockopt(sd, SOL_TCP, TCP_CONGESTION,
+				 config->congestion,
+				 strlen(config->congestion));
 		if (ret < 0)
-			return ret;
+			status = CTRL_STATUS_CONGESTION;
 	}
+	for (i = 0; i < config->n_sockopts && status == CTRL_STATUS_OK; i++)
+		if (sockopt_apply(sd, &config->sockopts[i]) < 0)
+			status = CTRL_STATUS_SOCKOPT;
+	close(sd);
 
-	return 0;
+	return status;
 }
 
-int ctrl_main(int ctrl_sd)
+static int ctrl_one_test(struct server_ctrl_config *config)
 {
+	enum ctrl_status status;
 	int ret;
-	int sd;
 
-	config.ctrl_sd = ctrl_sd;
-	ret = ctrl_get_config(&config);
-	if (ret < 0)
-		goto out_close;
-	ret = prepare_buffers(&config);
+	/* refusal is not a session error, client decides what to do next */
+	if (config->unsupported)
+		return ctrl_send_start(config, CTRL_STATUS_UNSUPPORTED);
+	status = check_socket_options(config);
+	if (status != CTRL_STATUS_OK)
+		return ctrl_send_start(config, status);
+	status = session_reserve_threads(config->n_threads);
+	if (status != CTRL_STATUS_OK)
+		return ctrl_send_start(config, status);
+
+	ret = prepare_buffers(config);
 	if (ret < 0)
-		goto out_close;
-	sd = setup_listener(&config);
-	if (sd < 0) {
-		ret = sd;
-		goto out_buffers;
+		goto out;
+	status = alloc_service_buffers(config);
+	if (status != CTRL_STATUS_OK) {
+		session_release_threads(config->n_threads);
+		return ctrl_send_start(config, status);
 	}
-	ret = ctrl_send_start(&config);
+	ret = setup_listeners(config);
+	if (ret < 0)
+		goto out;
+	ret = ctrl_send_start(config, CTRL_STATUS_OK);
+	if (ret < 0)
+		goto out;
+	ret = ctrl_run_test(config);
+	session_release_threads(config->n_threads);
+	free_service_buffers(config);
 	if (ret < 0) {
-		close(sd);
-		goto out_close;
+		/* drop connections left in accept queues */
+		close_listeners(config);
+		return ret;
 	}
-	ret = ctrl_run_test(sd, &config);
-	close(sd);
-	if (ret < 0)
-		goto out_close;
-	ret = ctrl_send_end(&config);
 
-out_buffers:
-	cleanup_buffers(&config);
-out_close:
+	return ctrl_send_end(config);
+out:
+	session_release_threads(config->n_threads);
+	free_service_buffers(config);
+	return ret;
+}
+
+void ctrl_init(struct server_ctrl_config *config)
+{
+	memset(config, '\0', sizeof(*config));
+	config->ctrl_sd = -1;
+}
+
+/* Release resources kept between sessions. */
+void ctrl_release(struct server_ctrl_config *config)
+{
+	close_listeners(config);
+	cleanup_buffers(config);
+	msgdist_free(&config->msg_dist);
+	ctrl_msg_free(&config->msg);
+	net_counters_free(&config->net_start);
+	net_counters_free(&config->net_end);
+	net_counters_free(&config->net_delta);
+}
+
+/* Refuse a control session without running any test: wait for the test
+ * request and tell the client why it cannot be served.
+ */
+int ctrl_reject(int ctrl_sd, enum ctrl_status status)
+{
+	struct server_ctrl_config config;
+	int ret;
+
+	ctrl_init(&config);
+	config.ctrl_sd = ctrl_sd;
+	ret = ctrl_get_config(&config);
+	if (ret >= 0)
+		ret = ctrl_send_start(&config, status);
+	msgdist_free(&config.msg_dist);
+	ctrl_msg_free(&config.msg);
+	close(ctrl_sd);
+
+	return ret;
+}
+
+/* One control session can run any number of tests, each started by a new
+ * CTRL_MSG_TEST. The session ends when client closes the connection.
+ * Buffers stay in config so that they can be reused by a following session;
+ * use ctrl_release() to free them.
+ */
+int ctrl_main(struct server_ctrl_config *config, int ctrl_sd)
+{
+	int ret;
+
+	config->ctrl_sd = ctrl_sd;
+	do {
+		ret = ctrl_get_config(config);
+		if (ret < 0)
+			break;
+		ret = ctrl_one_test(config);
+	} while (ret >= 0);
+	if (ret == -ENOTCONN)
+		ret = 0;
+
+	close_listeners(config);
 	close(ctrl_sd);
+	config->ctrl_sd = -1;
 	return ret;
 }
@@ -1,8 +1,70 @@
 #ifndef __NPERF_SERVER_CONTROL_H
 #define __NPERF_SERVER_CONTROL_H
 
+#include <stdbool.h>
+#include <time.h>
+
 #include "../common.h"
+#include "../ctrlmsg.h"
+#include "../cpustat.h"
+#include "../msgdist.h"
+#include "../sockopt.h"
+
+struct server_ctrl_config {
+	unsigned int			mode;
+	unsigned int			n_threads;
+	unsigned int			msg_size;
+	unsigned int			resp_size;	/* 0 = request size */
+	struct msgdist			msg_dist;
+	uint32_t			size_seed;
+	bool				verify;
+	unsigned int			service_type;
+	uint32_t			service_arg1;
+	uint32_t			service_arg2;
+	char				congestion[CC_NAME_MAX];
+	struct sockopt			sockopts[SOCKOPT_MAX];
+	unsigned int			n_sockopts;
+	int32_t				sockopt_values[SOCKOPT_MAX];	/* read back */
+	bool				tcp_nodelay;
+	unsigned int			accept_threads;
+	bool				cpu_steering;
+	bool				perf_counters;
+	bool				tcp_info;
+	unsigned int			tcp_info_interval;	/* ms */
+	bool				net_counters;
+	uint16_t			port;
+	unsigned char			*buffers;
+	unsigned long			buff_size;
+	unsigned long			buffers_size;
+	unsigned long			buffers_needed;
+	struct server_worker_data	*workers_data;
+	unsigned char			*service_buffers;	/* SERVICE_TOUCH */
+	size_t				service_buffers_size;
+	uint32_t			test_id;
+	bool				unsupported;	/* unknown mandatory attr */
+	struct ctrl_msg			msg;		/* reused for all messages */
+	int				ctrl_sd;
+	int				*listen_sds;
+	unsigned int			n_listeners;
+	unsigned int			listen_backlog;
+	bool				steering_attached;
+	int				wake_fds[2];
+	unsigned int			n_accepted;
+	unsigned int			n_started;
+	struct timespec			setup_start;
+	struct timespec			setup_end;
+	double				setup_time;
+	struct cpu_sample		cpu_start;
+	struct cpu_usage		cpu_usage;
+	struct net_counters		net_start;
+	struct net_counters		net_end;
+	struct net_counters		net_delta;
+	int				status;
+};
 
-int ctrl_main(int sd);
+void ctrl_init(struct server_ctrl_config *config);
+void ctrl_release(struct server_ctrl_config *config);
+int ctrl_reject(int ctrl_sd, enum ctrl_status status);
+int ctrl_main(struct server_ctrl_config *config, int ctrl_sd);
 
 #endif /* __NPERF_SERVER_CONTROL_H */
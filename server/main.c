@@ -15,16 +15,26 @@
 
 #include "../common.h"
 #include "control.h"
+#include "session.h"
 
-const char *opts = "hp:";
+#define MAX_SESSIONS	1024
+#define MAX_THREADS	(1U << 20)
+
+const char *opts = "hp:Ps:T:q:";
 const struct option long_opts[] = {
 	{ .name = "help",				.val = 'h' },
 	{ .name = "port",		.has_arg = 1,	.val = 'p' },
+	{ .name = "persistent",				.val = 'P' },
+	{ .name = "max-sessions",	.has_arg = 1,	.val = 's' },
+	{ .name = "max-threads",	.has_arg = 1,	.val = 'T' },
+	{ .name = "queue",		.has_arg = 1,	.val = 'q' },
 	{}
 };
 
 struct server_config {
-	uint16_t	port;
+	uint16_t		port;
+	bool			persistent;
+	struct session_limits	limits;
 };
 
 static struct server_config server_config = {
@@ -37,7 +47,8 @@ static const char *help_text = "\n"
 "  Network performance benchmarking utility (server side). Listens on given\n"
 "  TCP port and provides server for tests initiated by client (nperf).\n"
 "  For each client connection, nperfd starts a new listener on an ephemeral\n"
-"  port which is then used by client data connections (the benchmark).\n"
+"  port which is then used by client data connections (the benchmark). One\n"
+"  control connection can be used to run any number of tests.\n"
 "\n"
 "  *IMPORTANT NOTE:* This utility is still in its initial development stage\n"
 "  so that command line options may change in the future and client and\n"
@@ -49,6 +60,19 @@ static const char *help_text = "\n"
 "      Display this help text.\n"
 "  -p,--port <port>\n"
 "      Server port to listen on (default 12543).\n"
+"  -P,--persistent\n"
+"      Serve control connections by a fixed set of session threads of one\n"
+"      long-lived process (with session resources reused) rather than by\n"
+"      forking a new process for each of them. Implied by options below.\n"
+"  -s,--max-sessions <num>\n"
+"      Maximum number of concurrently running sessions (default 1).\n"
+"  -T,--max-threads <num>\n"
+"      Maximum number of data threads of all running tests (default no\n"
+"      limit).\n"
+"  -q,--queue <num>\n"
+"      Number of clients allowed to wait for a free session; they also wait\n"
+"      for the thread limit rather than being refused (default 0, i.e.\n"
+"      refuse clients over the limits immediately).\n"
 "\n";
 
 static int parse_cmdline(int argc, char *argv[], struct server_config *config)
@@ -69,6 +93,33 @@ static int parse_cmdline(int argc, char *argv[], struct server_config *config)
 				return -EINVAL;
 			config->port = val;
 			break;
+		case 'P':
+			config->persistent = true;
+			break;
+		case 's':
+			ret = parse_ulong_range("session count", optarg, &val,
+						1, MAX_SESSIONS);
+			if (ret < 0)
+				return -EINVAL;
+			config->limits.max_sessions = val;
+			config->persistent = true;
+			break;
+		case 'T':
+			ret = parse_ulong_range("thread count", optarg, &val,
+						1, MAX_THREADS);
+			if (ret < 0)
+				return -EINVAL;
+			config->limits.max_threads = val;
+			config->persistent = true;
+			break;
+		case 'q':
+			ret = parse_ulong_range("queue length", optarg, &val,
+						0, MAX_SESSIONS);
+			if (ret < 0)
+				return -EINVAL;
+			config->limits.queue_len = val;
+			config->persistent = true;
+			break;
 		case '?':
 			fputs("\nUsage:", stdout);
 			fputs(help_text, stdout);
@@ -164,8 +215,12 @@ static int server_loop(int sd)
 			continue;
 		}
 		if (cpid == 0) { /* child */
+			struct server_ctrl_config ctrl_config;
+
 			close(sd);
-			ctrl_main(csd);
+			ctrl_init(&ctrl_config);
+			ctrl_main(&ctrl_config, csd);
+			ctrl_release(&ctrl_config);
 			exit(0);
 		}
 
@@ -185,6 +240,17 @@ int main(int argc, char *argv[])
 		return 1;
 
 	printf("port: %hu\n", server_config.port);
+	if (server_config.persistent) {
+		const struct session_limits *limits = &server_config.limits;
+
+		printf("sessions: %u, queue: %u",
+		       limits->max_sessions ? limits->max_sessions : 1,
+		       limits->queue_len);
+		if (limits->max_threads)
+			printf(", threads: %u", limits->max_threads);
+		putchar('\n');
+	}
+	fflush(stdout);
 
 	ret = server_init();
 	if (ret < 0)
@@ -193,11 +259,16 @@ int main(int argc, char *argv[])
 	if (sd < 0)
 		return 2;
 
-	ret = server_loop(sd);
+	if (server_config.persistent) {
+		ret = session_pool_init(&server_config.limits);
+		if (ret < 0)
+			return 2;
+		ret = session_loop(sd);
+	} else {
+		ret = server_loop(sd);
+	}
 	if (ret < 0)
 		return 3;
-	if (ret > 0) /* child */
-		ret = ctrl_main(sd);
 
 	close(sd);
 	return ret ? 3 : 0;
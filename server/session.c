@@ -0,0 +1,238 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "../common.h"
+#include "session.h"
+#include "control.h"
+
+#define REJECT_STACK_SIZE 65536
+#define REJECT_TIMEOUT 5		/* s, waiting for the test request */
+#define MAX_REJECT_THREADS 64
+
+/* Persistent server mode: a fixed set of session threads, each with its own
+ * (reused) session resources, is created at startup. Accepted control
+ * connections are queued for them; if the queue is full, the client is told
+ * the server is busy. Total number of data threads of all running tests
+ * can be limited as well.
+ */
+struct session_pool {
+	pthread_mutex_t			mtx;
+	pthread_cond_t			cv;
+	struct session_limits		limits;
+	struct server_ctrl_config	*sessions;
+	pthread_t			*tids;
+	int				*queue;
+	unsigned int			queue_size;
+	unsigned int			queue_head;
+	unsigned int			n_queued;
+	unsigned int			n_active;
+	unsigned int			n_threads;
+	unsigned int			n_rejecting;
+};
+
+static struct session_pool pool = {
+	.mtx	= PTHREAD_MUTEX_INITIALIZER,
+	.cv	= PTHREAD_COND_INITIALIZER,
+};
+
+static int queue_pop(void)
+{
+	int sd;
+
+	sd = pool.queue[pool.queue_head];
+	pool.queue_head = (pool.queue_head + 1) % pool.queue_size;
+	pool.n_queued--;
+
+	return sd;
+}
+
+static void queue_push(int sd)
+{
+	unsigned int tail = (pool.queue_head + pool.n_queued) % pool.queue_size;
+
+	pool.queue[tail] = sd;
+	pool.n_queued++;
+}
+
+static void *session_main(void *_data)
+{
+	struct server_ctrl_config *config = _data;
+	int sd;
+
+	while (true) {
+		pthread_mutex_lock(&pool.mtx);
+		while (!pool.n_queued)
+			pthread_cond_wait(&pool.cv, &pool.mtx);
+		sd = queue_pop();
+		pool.n_active++;
+		pthread_mutex_unlock(&pool.mtx);
+
+		ctrl_main(config, sd);
+
+		pthread_mutex_lock(&pool.mtx);
+		pool.n_active--;
+		pthread_mutex_unlock(&pool.mtx);
+	}
+
+	return NULL;
+}
+
+static void *reject_main(void *_data)
+{
+	int sd = (int)(long)_data;
+
+	ctrl_reject(sd, CTRL_STATUS_BUSY);
+
+	pthread_mutex_lock(&pool.mtx);
+	pool.n_rejecting--;
+	pthread_mutex_unlock(&pool.mtx);
+	return NULL;
+}
+
+/* Rejecting in a separate thread so that accept loop is not blocked by
+ * a client which is slow to send its request. A client which sends
+ * nothing is dropped after REJECT_TIMEOUT; under a connection flood,
+ * clients beyond MAX_REJECT_THREADS are dropped without a reason.
+ */
+static void session_reject(int sd)
+{
+	struct timeval tv = { .tv_sec = REJECT_TIMEOUT };
+	pthread_attr_t attr;
+	bool allowed;
+	pthread_t tid;
+	int ret;
+
+	pthread_mutex_lock(&pool.mtx);
+	allowed = (pool.n_rejecting < MAX_REJECT_THREADS);
+	if (allowed)
+		pool.n_rejecting++;
+	pthread_mutex_unlock(&pool.mtx);
+	if (!allowed)
+		goto err_close;
+
+	if (setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0 ||
+	    setsockopt(sd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0)
+		goto err;
+	ret = pthread_attr_init(&attr);
+	if (ret)
+		goto err;
+	pthread_attr_setstacksize(&attr, REJECT_STACK_SIZE);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&tid, &attr, reject_main, (void *)(long)sd);
+	pthread_attr_destroy(&attr);
+	if (ret)
+		goto err;
+	return;
+err:
+	pthread_mutex_lock(&pool.mtx);
+	pool.n_rejecting--;
+	pthread_mutex_unlock(&pool.mtx);
+err_close:
+	close(sd);
+}
+
+int session_pool_init(const struct session_limits *limits)
+{
+	unsigned int i;
+	int ret;
+
+	pool.limits = *limits;
+	if (!pool.limits.max_sessions)
+		pool.limits.max_sessions = 1;
+	pool.queue_size = pool.limits.max_sessions + pool.limits.queue_len;
+
+	pool.sessions = calloc(pool.limits.max_sessions,
+			       sizeof(pool.sessions[0]));
+	pool.tids = calloc(pool.limits.max_sessions, sizeof(pool.tids[0]));
+	pool.queue = calloc(pool.queue_size, sizeof(pool.queue[0]));
+	if (!pool.sessions || !pool.tids || !pool.queue)
+		return -ENOMEM;
+
+	for (i = 0; i < pool.limits.max_sessions; i++) {
+		ctrl_init(&pool.sessions[i]);
+		ret = pthread_create(&pool.tids[i], NULL, session_main,
+				     &pool.sessions[i]);
+		if (ret) {
+			fprintf(stderr, "failed to start session thread: %s\n",
+				strerror(ret));
+			return -ret;
+		}
+	}
+
+	return 0;
+}
+
+int session_loop(int sd)
+{
+	bool accepted;
+	int csd;
+	int ret;
+
+	while (true) {
+		csd = accept(sd, NULL, NULL);
+		if (csd < 0) {
+			ret = -errno;
+			if (ret == -EINTR || ret == -ECONNABORTED)
+				continue;
+			perror("accept");
+			return ret;
+		}
+
+		pthread_mutex_lock(&pool.mtx);
+		accepted = (pool.n_active + pool.n_queued < pool.queue_size);
+		if (accepted) {
+			queue_push(csd);
+			pthread_cond_broadcast(&pool.cv);
+		}
+		pthread_mutex_unlock(&pool.mtx);
+
+		if (!accepted)
+			session_reject(csd);
+	}
+
+	return 0;
+}
+
+/* Account data threads of a test against the server wide limit. If client
+ * queueing is enabled, wait for other tests to finish, otherwise refuse
+ * the test immediately.
+ */
+enum ctrl_status session_reserve_threads(unsigned int n_threads)
+{
+	unsigned int max_threads = pool.limits.max_threads;
+	enum ctrl_status status = CTRL_STATUS_OK;
+
+	if (!max_threads)
+		return CTRL_STATUS_OK;
+	if (n_threads > max_threads)
+		return CTRL_STATUS_THREAD_LIMIT;
+
+	pthread_mutex_lock(&pool.mtx);
+	while (pool.n_threads + n_threads > max_threads) {
+		if (!pool.limits.queue_len) {
+			status = CTRL_STATUS_BUSY;
+			goto out;
+		}
+		pthread_cond_wait(&pool.cv, &pool.mtx);
+	}
+	pool.n_threads += n_threads;
+out:
+	pthread_mutex_unlock(&pool.mtx);
+	return status;
+}
+
+void session_release_threads(unsigned int n_threads)
+{
+	if (!pool.limits.max_threads)
+		return;
+
+	pthread_mutex_lock(&pool.mtx);
+	pool.n_threads -= n_threads;
+	pthread_cond_broadcast(&pool.cv);
+	pthread_mutex_unlock(&pool.mtx);
+}
@@ -0,0 +1,18 @@
+#ifndef __NPERF_SERVER_SESSION_H
+#define __NPERF_SERVER_SESSION_H
+
+#include "../common.h"
+
+/* zero means no limit */
+struct session_limits {
+	unsigned int	max_sessions;
+	unsigned int	max_threads;
+	unsigned int	queue_len;
+};
+
+int session_pool_init(const struct session_limits *limits);
+int session_loop(int sd);
+enum ctrl_status session_reserve_threads(unsigned int n_threads);
+void session_release_threads(unsigned int n_threads);
+
+#endif /* __NPERF_SERVER_SESSION_H */
@@ -1,17 +1,21 @@
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <unistd.h>
+#include <math.h>
 
 #include "worker.h"
+#include "../cpustat.h"
+#include "../verify.h"
 
 #define WORKER_STACK_SIZE 16384
 
 struct server_worker_data *workers_data;
 
-static int recv_msg(struct server_worker_data *data, bool *eof)
+static int recv_msg(struct server_worker_data *data, unsigned long len,
+		    bool *eof)
 {
-	unsigned long len = data->msg_size;
 	unsigned char *p = data->buff;
 	ssize_t chunk;
 
@@ -39,9 +43,8 @@ static int recv_msg(struct server_worker_data *data, bool *eof)
 	return 0;
 }
 
-static int send_msg(struct server_worker_data *data)
+static int send_msg(struct server_worker_data *data, unsigned long len)
 {
-	unsigned long len = data->msg_size;
 	unsigned char *p = data->buff;
 	ssize_t chunk;
 
@@ -69,27 +72,162 @@ static void cleanup_close(void *_data)
 	struct server_worker_data *data = _data;
 
 	close(data->sd);
+	data->sd = -1;
+}
+
+static void worker_seal(struct server_worker_data *data, unsigned long len)
+{
+	uint64_t t0 = monotonic_nsec();
+
+	verify_seal(data->buff, len, data->stats.tx.msgs);
+	data->verify_nsec += monotonic_nsec() - t0;
+}
+
+static void worker_check(struct server_worker_data *data, unsigned long len)
+{
+	uint64_t t0 = monotonic_nsec();
+
+	if (!verify_check(data->buff, len, data->stats.rx.msgs - 1))
+		data->verify_errors++;
+	data->verify_nsec += monotonic_nsec() - t0;
+}
+
+/* xorshift64* */
+static uint64_t service_random(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+static uint64_t service_spin_nsec(struct server_worker_data *data,
+				  uint64_t *state)
+{
+	double u;
+
+	switch (data->service_type) {
+	case SERVICE_SPIN:
+		return data->service_arg1;
+	case SERVICE_EXP:
+		/* uniform in (0, 1] */
+		u = ((service_random(state) >> 11) + 1) * 0x1.0p-53;
+		return -log(u) * data->service_arg1;
+	case SERVICE_UNIFORM:
+		return data->service_arg1 +
+		       service_random(state) %
+		       ((uint64_t)data->service_arg2 - data->service_arg1 + 1);
+	default:
+		return 0;
+	}
+}
+
+/* Emulate server processing of a request; actual time spent is recorded
+ * so that the achieved service time can be reported.
+ */
+static void worker_service(struct server_worker_data *data, uint64_t *state)
+{
+	uint64_t t0, t1, target, elapsed;
+	uint32_t i;
+
+	t0 = monotonic_nsec();
+	if (data->service_type == SERVICE_TOUCH) {
+		volatile unsigned char *p = data->service_buff;
+
+		for (i = 0; i < data->service_arg1; i += CACHELINE_SIZE)
+			p[i]++;
+		t1 = monotonic_nsec();
+	} else {
+		target = t0 + service_spin_nsec(data, state);
+		do
+			t1 = monotonic_nsec();
+		while (t1 < target);
+	}
+
+	elapsed = t1 - t0;
+	data->service_count++;
+	data->service_nsec += elapsed;
+	if (elapsed > data->service_max_nsec)
+		data->service_max_nsec = elapsed;
+}
+
+/* TCP_INFO is sampled by the worker itself between messages so that
+ * the socket cannot be closed (and the fd reused) under the sample.
+ */
+static void worker_tcpinfo(struct server_worker_data *data, uint64_t *next)
+{
+	uint64_t now = monotonic_nsec();
+
+	if (now < *next)
+		return;
+	tcpinfo_sample(data->sd, &data->tcpinfo);
+	*next = now + data->tcp_info_interval * 1000000ULL;
 }
 
 static void *worker_main(void *_data)
 {
 	struct server_worker_data *data = _data;
 	bool do_write = data->reply;
+	bool tcpinfo = data->tcp_info && data->tcp_info_interval;
+	uint64_t service_state, tcpinfo_next = 0;
+	struct perf_counters pc;
+	unsigned long len = data->msg_size;
+	uint64_t size_state = 0;
 	bool eof = false;
+	uint64_t cpu0;
 	int ret;
 
 	pthread_cleanup_push(cleanup_close, data);
-
+	if (data->msg_dist)
+		size_state = msgdist_seed(data->size_seed, data->client_port);
+	if (data->verify)
+		verify_fill(data->buff, (data->resp_size > data->msg_size) ?
+					data->resp_size : data->msg_size,
+			    data->client_port);
+	service_state = 0x9e3779b97f4a7c15ULL ^ data->client_port;
+
+	if (data->perf) {
+		perf_counters_open(&pc);
+		perf_counters_enable(&pc);
+	}
+	cpu0 = thread_cpu_usec();
+	if (tcpinfo)
+		tcpinfo_next = monotonic_nsec() +
+			       data->tcp_info_interval * 1000000ULL;
 	while (!eof) {
-		ret = recv_msg(data, &eof);
+		if (tcpinfo)
+			worker_tcpinfo(data, &tcpinfo_next);
+		if (data->msg_dist)
+			len = msgdist_next(data->msg_dist, &size_state);
+		ret = recv_msg(data, len, &eof);
 		if (ret < 0 || eof)
 			break;
+		if (data->verify)
+			worker_check(data, len);
+		if (data->service_type != SERVICE_NONE)
+			worker_service(data, &service_state);
 		if (do_write) {
-			ret = send_msg(data);
+			unsigned long resp_len = data->resp_size ?
+						 data->resp_size : len;
+
+			if (data->verify)
+				worker_seal(data, resp_len);
+			ret = send_msg(data, resp_len);
 			if (ret < 0)
 				break;
 		}
 	}
+	data->cpu_usec = thread_cpu_usec() - cpu0;
+	if (data->perf) {
+		perf_counters_disable(&pc);
+		perf_counters_read(&pc, &data->perf_stats);
+		perf_counters_close(&pc);
+	}
+	if (data->tcp_info)
+		tcpinfo_final(data->sd, &data->tcpinfo);
 
 	pthread_cleanup_pop(1);
 
@@ -6,6 +6,11 @@
 
 #include "../common.h"
 #include "../stats.h"
+#include "../msgdist.h"
+
+#define SERVICE_TOUCH_MAX	(1U << 30)
+#define SERVICE_TOUCH_TOTAL_MAX	(4ULL << 30)	/* all threads of a test */
+#define SERVICE_SPIN_MAX	1000000000U	/* ns, also exp mean */
 
 struct server_worker_data {
 	unsigned int		id;
@@ -13,9 +18,29 @@ struct server_worker_data {
 	uint16_t		client_port;
 	unsigned char 		*buff;
 	bool			reply;
+	bool			perf;
+	bool			tcp_info;
+	unsigned int		tcp_info_interval;	/* ms, 0 = final only */
 	unsigned long		msg_size;
+	unsigned long		resp_size;	/* 0 = request size */
+	const struct msgdist	*msg_dist;	/* NULL = fixed msg_size */
+	uint32_t		size_seed;
+	bool			verify;
+	uint64_t		verify_errors;
+	uint64_t		verify_nsec;
+	unsigned int		service_type;
+	uint32_t		service_arg1;
+	uint32_t		service_arg2;
+	unsigned char		*service_buff;	/* SERVICE_TOUCH, not owned */
+	uint64_t		service_count;
+	uint64_t		service_nsec;
+	uint64_t		service_max_nsec;
 	pthread_t		tid;
+	bool			started;
 	struct xfer_stats	stats;
+	uint64_t		cpu_usec;
+	struct perf_stats	perf_stats;
+	struct tcpinfo_stats	tcpinfo;
 	int			status;
 } __attribute__ ((__aligned__ (CACHELINE_SIZE)));
 
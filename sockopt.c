@@ -0,0 +1,238 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "sockopt.h"
+#include "common.h"
+
+struct sockopt_level_desc {
+	const char	*name;
+	int		level;
+};
+
+struct sockopt_desc {
+	const char	*name;
+	int		level;
+	int		optname;
+};
+
+static const struct sockopt_level_desc sockopt_levels[] = {
+	{ "socket",	SOL_SOCKET },
+	{ "tcp",	IPPROTO_TCP },
+	{ "ip",		IPPROTO_IP },
+	{ "ipv6",	IPPROTO_IPV6 },
+};
+
+#define SOCKOPT(level, name) { #name, level, name }
+
+/* integer valued options which make sense on a TCP data socket */
+static const struct sockopt_desc sockopt_names[] = {
+	SOCKOPT(SOL_SOCKET, SO_SNDBUF),
+	SOCKOPT(SOL_SOCKET, SO_RCVBUF),
+	SOCKOPT(SOL_SOCKET, SO_SNDBUFFORCE),
+	SOCKOPT(SOL_SOCKET, SO_RCVBUFFORCE),
+	SOCKOPT(SOL_SOCKET, SO_RCVLOWAT),
+	SOCKOPT(SOL_SOCKET, SO_PRIORITY),
+	SOCKOPT(SOL_SOCKET, SO_MARK),
+	SOCKOPT(SOL_SOCKET, SO_KEEPALIVE),
+	SOCKOPT(SOL_SOCKET, SO_INCOMING_CPU),
+#ifdef SO_BUSY_POLL
+	SOCKOPT(SOL_SOCKET, SO_BUSY_POLL),
+#endif
+#ifdef SO_ZEROCOPY
+	SOCKOPT(SOL_SOCKET, SO_ZEROCOPY),
+#endif
+	SOCKOPT(IPPROTO_TCP, TCP_NODELAY),
+	SOCKOPT(IPPROTO_TCP, TCP_MAXSEG),
+	SOCKOPT(IPPROTO_TCP, TCP_CORK),
+	SOCKOPT(IPPROTO_TCP, TCP_QUICKACK),
+	SOCKOPT(IPPROTO_TCP, TCP_WINDOW_CLAMP),
+	SOCKOPT(IPPROTO_TCP, TCP_USER_TIMEOUT),
+	SOCKOPT(IPPROTO_TCP, TCP_KEEPIDLE),
+	SOCKOPT(IPPROTO_TCP, TCP_KEEPINTVL),
+	SOCKOPT(IPPROTO_TCP, TCP_KEEPCNT),
+	SOCKOPT(IPPROTO_TCP, TCP_THIN_LINEAR_TIMEOUTS),
+#ifdef TCP_NOTSENT_LOWAT
+	SOCKOPT(IPPROTO_TCP, TCP_NOTSENT_LOWAT),
+#endif
+#ifdef TCP_TX_DELAY
+	SOCKOPT(IPPROTO_TCP, TCP_TX_DELAY),
+#endif
+	SOCKOPT(IPPROTO_IP, IP_TOS),
+	SOCKOPT(IPPROTO_IP, IP_TTL),
+	SOCKOPT(IPPROTO_IP, IP_MTU_DISCOVER),
+	SOCKOPT(IPPROTO_IPV6, IPV6_TCLASS),
+	SOCKOPT(IPPROTO_IPV6, IPV6_UNICAST_HOPS),
+	SOCKOPT(IPPROTO_IPV6, IPV6_MTU_DISCOVER),
+};
+
+#define N_LEVELS (sizeof(sockopt_levels) / sizeof(sockopt_levels[0]))
+#define N_NAMES (sizeof(sockopt_names) / sizeof(sockopt_names[0]))
+
+/* name or non-negative number, up to delimiter */
+static int lookup_level(const char *str, size_t len)
+{
+	unsigned int i;
+	char *end;
+	long val;
+
+	for (i = 0; i < N_LEVELS; i++)
+		if (strlen(sockopt_levels[i].name) == len &&
+		    !strncasecmp(str, sockopt_levels[i].name, len))
+			return sockopt_levels[i].level;
+	val = strtol(str, &end, 0);
+	if (end != str + len || val < 0 || val > INT_MAX)
+		return -ENOENT;
+	return val;
+}
+
+static int lookup_option(int level, const char *str, size_t len)
+{
+	unsigned int i;
+	char *end;
+	long val;
+
+	for (i = 0; i < N_NAMES; i++)
+		if (sockopt_names[i].level == level &&
+		    strlen(sockopt_names[i].name) == len &&
+		    !strncasecmp(str, sockopt_names[i].name, len))
+			return sockopt_names[i].optname;
+	val = strtol(str, &end, 0);
+	if (end != str + len || val < 0 || val > INT_MAX)
+		return -ENOENT;
+	return val;
+}
+
+/* hexadecimal (e.g. IP_TOS) or decimal with optional size suffix */
+static int parse_value(const char *str, unsigned long *val)
+{
+	char *end;
+
+	if (strncasecmp(str, "0x", 2))
+		return parse_ulong_range("socket option value", str, val, 0,
+					 INT_MAX);
+	*val = strtoul(str + 2, &end, 16);
+	if (end == str + 2 || *end || *val > INT_MAX) {
+		fprintf(stderr, "invalid socket option value '%s'\n", str);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/* <level>:<option>=<value> */
+int sockopt_parse(const char *spec, struct sockopt *opt)
+{
+	const char *colon = strchr(spec, ':');
+	const char *eq;
+	unsigned long val;
+	int ret;
+
+	if (!colon)
+		goto err;
+	eq = strchr(colon + 1, '=');
+	if (!eq)
+		goto err;
+	ret = lookup_level(spec, colon - spec);
+	if (ret < 0) {
+		fprintf(stderr, "unknown socket option level in '%s'\n", spec);
+		return -EINVAL;
+	}
+	opt->level = ret;
+	ret = lookup_option(opt->level, colon + 1, eq - colon - 1);
+	if (ret < 0) {
+		fprintf(stderr, "unknown socket option in '%s'\n", spec);
+		return -EINVAL;
+	}
+	opt->name = ret;
+	ret = parse_value(eq + 1, &val);
+	if (ret < 0)
+		return ret;
+	opt->value = val;
+
+	return 0;
+err:
+	fprintf(stderr, "invalid socket option '%s'\n", spec);
+	return -EINVAL;
+}
+
+/* symbolic name where known, e.g. "tcp:TCP_MAXSEG" or "tcp:42" */
+void sockopt_format(const struct sockopt *opt, char *buff, size_t size)
+{
+	const char *level = NULL;
+	unsigned int i;
+
+	for (i = 0; i < N_LEVELS; i++)
+		if (sockopt_levels[i].level == opt->level)
+			level = sockopt_levels[i].name;
+	for (i = 0; i < N_NAMES; i++)
+		if (sockopt_names[i].level == opt->level &&
+		    sockopt_names[i].optname == opt->name)
+			break;
+
+	if (level && i < N_NAMES)
+		snprintf(buff, size, "%s:%s", level, sockopt_names[i].name);
+	else if (level)
+		snprintf(buff, size, "%s:%d", level, opt->name);
+	else
+		snprintf(buff, size, "%d:%d", opt->level, opt->name);
+}
+
+int sockopt_apply(int sd, const struct sockopt *opt)
+{
+	char name[64];
+	int val = opt->value;
+	int ret;
+
+	ret = setsockopt(sd, opt->level, opt->name, &val, sizeof(val));
+	if (ret < 0) {
+		ret = -errno;
+		sockopt_format(opt, name, sizeof(name));
+		fprintf(stderr, "setsockopt(%s, %d): %s\n", name, val,
+			strerror(-ret));
+		return ret;
+	}
+
+	return 0;
+}
+
+/* effective value which may differ from requested (e.g. SO_RCVBUF) */
+int sockopt_read(int sd, const struct sockopt *opt, int *val)
+{
+	socklen_t len = sizeof(*val);
+
+	*val = 0;
+	if (getsockopt(sd, opt->level, opt->name, val, &len) < 0)
+		return -errno;
+	return 0;
+}
+
+void sockopt_hton(const struct sockopt *src, struct sockopt *dst,
+		  unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		dst[i].level = htonl(src[i].level);
+		dst[i].name = htonl(src[i].name);
+		dst[i].value = htonl(src[i].value);
+	}
+}
+
+void sockopt_ntoh(const struct sockopt *src, struct sockopt *dst,
+		  unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		dst[i].level = ntohl(src[i].level);
+		dst[i].name = ntohl(src[i].name);
+		dst[i].value = ntohl(src[i].value);
+	}
+}
@@ -0,0 +1,30 @@
+#ifndef __NPERF_SOCKOPT_H
+#define __NPERF_SOCKOPT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SOCKOPT_MAX	16
+
+/* Integer socket option set on data sockets, given on command line as
+ * <level>:<option>=<value> where level and option are names (see
+ * sockopt.c) or numbers.
+ *
+ * all entries in network byte order (BE) when sent over control connection
+ */
+struct sockopt {
+	int32_t		level;
+	int32_t		name;
+	int32_t		value;
+};
+
+int sockopt_parse(const char *spec, struct sockopt *opt);
+void sockopt_format(const struct sockopt *opt, char *buff, size_t size);
+int sockopt_apply(int sd, const struct sockopt *opt);
+int sockopt_read(int sd, const struct sockopt *opt, int *val);
+void sockopt_hton(const struct sockopt *src, struct sockopt *dst,
+		  unsigned int n);
+void sockopt_ntoh(const struct sockopt *src, struct sockopt *dst,
+		  unsigned int n);
+
+#endif /* __NPERF_SOCKOPT_H */
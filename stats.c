@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
 #include "stats.h"
@@ -10,11 +11,44 @@ static const char *unit_names[] = {
 	[PRINT_UNIT_TRANS]	= "tr",
 };
 
+static const char *sdem_unit_names[] = {
+	[PRINT_UNIT_BYTE]	= "KB",
+	[PRINT_UNIT_TRANS]	= "tr",
+};
+
 double mdev_n(double sum, double sum_sqr, unsigned int n)
 {
 	return sqrt(n * sum_sqr - sum * sum) / n;
 }
 
+/* track slowest and fastest thread; call for thread ids 0, 1, ... */
+void fairness_add(struct fairness *fair, unsigned int id, double result)
+{
+	if (!id || result < fair->min) {
+		fair->min = result;
+		fair->min_thread = id;
+	}
+	if (!id || result > fair->max) {
+		fair->max = result;
+		fair->max_thread = id;
+	}
+}
+
+/* Jain's fairness index (sum x)^2 / (n * sum x^2) */
+void fairness_finish(struct fairness *fair, double sum, double sum_sqr,
+		     unsigned int n)
+{
+	fair->jain = (n && sum_sqr > 0) ? sum * sum / (n * sum_sqr) : 1.0;
+}
+
+/* max / min, infinite if a thread starved completely */
+double fairness_ratio(const struct fairness *fair)
+{
+	if (fair->min > 0)
+		return fair->max / fair->min;
+	return (fair->max > 0) ? HUGE_VAL : 1.0;
+}
+
 void print_opts_setup(struct print_options *opts, unsigned int test_mode)
 {
 	switch(test_mode) {
@@ -118,6 +152,7 @@ void xfer_stats_print_raw(const struct xfer_stats *stats, unsigned int id)
 }
 
 void xfer_stats_thread_footer(double sum, double sum_sqr, unsigned int n,
+			      const struct fairness *fair,
 			      const struct print_options *opts)
 {
 	double avg, mdev;
@@ -129,6 +164,14 @@ void xfer_stats_thread_footer(double sum, double sum_sqr, unsigned int n,
 	fputs(", mdev ", stdout);
 	print_rate(mdev, opts);
 	printf(" (%.1lf%%)\n", 100 * mdev / avg);
+	if (n < 2)
+		return;
+	printf("fairness       Jain's index %.4lf, min ", fair->jain);
+	print_rate(fair->min, opts);
+	printf(" (thread %u), max ", fair->min_thread);
+	print_rate(fair->max, opts);
+	printf(" (thread %u), max/min %.2lf\n", fair->max_thread,
+	       fairness_ratio(fair));
 }
 
 void xfer_stats_print_thread(const struct xfer_stats *client,
@@ -178,6 +221,8 @@ void xfer_stats_print_thread(const struct xfer_stats *client,
 
 void print_iter_result(unsigned int iter, unsigned int n_iter, double result,
 		       double sum, double sum_sqr, enum confid_level level,
+		       const struct cpu_result *cpu,
+		       const struct fairness *fair,
 		       const struct print_options *opts)
 {
         double avg, mdev, confid;
@@ -211,5 +256,220 @@ void print_iter_result(unsigned int iter, unsigned int n_iter, double result,
 		print_rate(confid, opts);
 		printf(" (%5.1lf%%)", 100.0 * confid / avg);
 	}
+	if (cpu)
+		printf(", cpu %.1lf%%/%.1lf%%, sdem %.3lf/%.3lf us/%s",
+		       100.0 * cpu->client_util, 100.0 * cpu->server_util,
+		       cpu->client_sdem, cpu->server_sdem,
+		       sdem_unit_names[opts->unit]);
+	if (fair)
+		printf(", fairness %.4lf", fair->jain);
 	putchar('\n');
 }
+
+void robust_stats_print(const struct robust_stats *rs, unsigned int level,
+			const struct print_options *opts)
+{
+	double hw = (rs->ci_high - rs->ci_low) / 2;
+
+	fputs("robust          median ", stdout);
+	print_rate(rs->median, opts);
+	fputs(", MAD ", stdout);
+	print_rate(rs->mad, opts);
+	printf(" (%5.1lf%%)\n", rs->median ? 100.0 * rs->mad / rs->median : 0);
+	fputs("                confid. ", stdout);
+	print_rate(rs->ci_low, opts);
+	fputs(" - ", stdout);
+	print_rate(rs->ci_high, opts);
+	printf(" (+/- %.1lf%%) at %u%% (bootstrap)\n",
+	       rs->median ? 100.0 * hw / rs->median : 0, level);
+}
+
+/* amount of work done: KB transferred or number of transactions */
+double xfer_stats_units(const struct xfer_stats *client,
+			const struct xfer_stats *server, unsigned int test_mode)
+{
+	switch(test_mode) {
+	case MODE_TCP_STREAM:
+		return server->rx.bytes / 1024.0;
+	case MODE_TCP_RR:
+		return client->rx.msgs;
+	default:
+		return 0.0;
+	}
+}
+
+/* CPU time (us) per KB transferred or per transaction */
+double service_demand(uint64_t cpu_usec, const struct xfer_stats *client,
+		      const struct xfer_stats *server, unsigned int test_mode)
+{
+	double units = xfer_stats_units(client, server, test_mode);
+
+	return units ? cpu_usec / units : 0.0;
+}
+
+void tcpinfo_stats_header(const char *label)
+{
+	printf("%-8s %9s %9s %9s %9s %8s %8s %8s %12s %12s %12s\n",
+	       label, "srtt", "rttvar", "srtt avg", "srtt max", "cwnd",
+	       "cwnd avg", "retrans", "pacing", "delivery", "dlv avg");
+}
+
+static void print_mbps(uint64_t rate)
+{
+	if (rate == TCPINFO_RATE_UNLIMITED)
+		printf(" %12s", "-");
+	else
+		printf(" %7.1lf MB/s", 1E-6 * rate);
+}
+
+/* For a sum of connections (id == XFER_STATS_TOTAL), rtt values are
+ * averaged while windows and rates are shown as sums.
+ */
+void tcpinfo_stats_print(const struct tcpinfo_stats *stats, unsigned int id)
+{
+	unsigned int n = stats->valid;
+
+	if (id == XFER_STATS_TOTAL)
+		fputs("total   ", stdout);
+	else
+		printf("%-8u", id);
+
+	if (!n) {
+		fputs(" -\n", stdout);
+		return;
+	}
+	printf(" %6u us %6u us", stats->srtt_usec / n, stats->rttvar_usec / n);
+	if (stats->samples)
+		printf(" %6" PRIu64 " us %6u us", stats->srtt_sum / stats->samples,
+		       stats->srtt_max_usec);
+	else
+		printf(" %9s %9s", "-", "-");
+	printf(" %8u", stats->cwnd);
+	/* average of sum = sum of averages (same number of samples) */
+	if (stats->samples)
+		printf(" %8.0lf", (double)stats->cwnd_sum * n / stats->samples);
+	else
+		printf(" %8s", "-");
+	printf(" %8u", stats->total_retrans);
+	print_mbps(stats->pacing_rate);
+	print_mbps(stats->delivery_rate);
+	if (stats->samples)
+		print_mbps(stats->delivery_rate_sum * n / stats->samples);
+	else
+		printf(" %12s", "-");
+	putchar('\n');
+}
+
+void perf_stats_header(const char *label)
+{
+	unsigned int i;
+
+	printf("%-8s", label);
+	for (i = 0; i < PERF_CNT_COUNT; i++)
+		printf(" %14s", perf_counter_names[i]);
+	putchar('\n');
+}
+
+void perf_stats_print(const struct perf_stats *stats, unsigned int id)
+{
+	unsigned int i;
+
+	if (id == XFER_STATS_TOTAL)
+		fputs("total   ", stdout);
+	else
+		printf("%-8u", id);
+
+	for (i = 0; i < PERF_CNT_COUNT; i++) {
+		if (stats->valid & (1U << i))
+			printf(" %14" PRIu64, stats->counters[i]);
+		else
+			printf(" %14s", "-");
+	}
+	putchar('\n');
+}
+
+void perf_stats_print_per_unit(const char *label,
+			       const struct perf_stats *stats, double units,
+			       const struct print_options *opts)
+{
+	const uint64_t *cnt = stats->counters;
+	const char *sep = "";
+	unsigned int i;
+
+	if (!units)
+		return;
+	printf("%s per %s:", label, sdem_unit_names[opts->unit]);
+	for (i = 0; i < PERF_CNT_COUNT; i++) {
+		if (!(stats->valid & (1U << i)))
+			continue;
+		printf("%s %s %.1lf", sep, perf_counter_names[i],
+		       cnt[i] / units);
+		sep = ",";
+	}
+	if ((stats->valid & (1U << PERF_CNT_CYCLES)) &&
+	    (stats->valid & (1U << PERF_CNT_INSTRUCTIONS)) &&
+	    cnt[PERF_CNT_CYCLES])
+		printf(" IPC %.2lf", (double)cnt[PERF_CNT_INSTRUCTIONS] /
+				     cnt[PERF_CNT_CYCLES]);
+	if (stats->user_only)
+		fputs(" (user space only)", stdout);
+	putchar('\n');
+}
+
+void cpu_stats_print_thread(uint64_t client_usec, uint64_t server_usec,
+			    unsigned int id, double elapsed)
+{
+	if (id == XFER_STATS_TOTAL)
+		fputs("total     ", stdout);
+	else
+		printf("thread %-3d", id);
+
+	printf(" cpu client %6.1lf%%, server %6.1lf%%\n",
+	       1E-4 * client_usec / elapsed, 1E-4 * server_usec / elapsed);
+}
+
+void cpu_stats_print_system(const struct cpu_usage *client,
+			    const struct cpu_usage *server)
+{
+	printf("system cpu: client %.1lf%% of %u CPUs, server %.1lf%% of %u CPUs\n",
+	       100.0 * cpu_usage_util(client), client->n_cpus,
+	       100.0 * cpu_usage_util(server), server->n_cpus);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* value at given quantile of sorted array (nearest rank) */
+static double sorted_quantile(const double *vals, unsigned int n, double q)
+{
+	unsigned int idx = ceil(q * n);
+
+	return vals[idx ? idx - 1 : 0];
+}
+
+/* latencies (in seconds) are sorted in place */
+void connect_stats_print(double *latencies, unsigned int n,
+			 uint64_t retries, unsigned int n_retried)
+{
+	double sum = 0.0;
+	unsigned int i;
+
+	if (!n)
+		return;
+	qsort(latencies, n, sizeof(latencies[0]), cmp_double);
+	for (i = 0; i < n; i++)
+		sum += latencies[i];
+
+	printf("connect latency: min %.1lf us, avg %.1lf us, median %.1lf us, p99 %.1lf us, max %.1lf us\n",
+	       1E6 * latencies[0], 1E6 * sum / n,
+	       1E6 * sorted_quantile(latencies, n, 0.5),
+	       1E6 * sorted_quantile(latencies, n, 0.99),
+	       1E6 * latencies[n - 1]);
+	printf("connect retries: %" PRIu64 " (%u of %u connections retried)\n",
+	       retries, n_retried, n);
+}
@@ -5,8 +5,12 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
+#include <arpa/inet.h>
 
 #include "estimate.h"
+#include "cpustat.h"
+#include "perfcnt.h"
+#include "tcpinfo.h"
 
 #define XFER_STATS_TOTAL ((unsigned int)(-1))
 
@@ -33,7 +37,27 @@ struct xfer_stats {
 	struct xfer_stats_1	tx;
 };
 
+/* system wide CPU utilization (fraction of all CPUs) and service demand
+ * (CPU time in microseconds per KB or per transaction)
+ */
+struct cpu_result {
+	double	client_util;
+	double	server_util;
+	double	client_sdem;
+	double	server_sdem;
+};
+
+/* how evenly threads of one iteration share the total result */
+struct fairness {
+	double		jain;		/* Jain's index, 1/n (worst) to 1 */
+	double		min;
+	double		max;
+	unsigned int	min_thread;
+	unsigned int	max_thread;
+};
+
 void print_opts_setup(struct print_options *opts, unsigned int test_mode);
+void print_rate(double val, const struct print_options *opts);
 double xfer_stats_result(const struct xfer_stats *client,
 			 const struct xfer_stats *server,
 			 unsigned int test_mode, double elapsed);
@@ -44,12 +68,39 @@ void xfer_stats_print_thread(const struct xfer_stats *client,
 			     unsigned int test_mode, double elapsed,
 			     const struct print_options *opts);
 void xfer_stats_thread_footer(double sum, double sum_sqr, unsigned int n,
+			      const struct fairness *fair,
 			      const struct print_options *opts);
 void print_iter_result(unsigned int iter, unsigned int n_iter, double result,
 		       double sum, double sum_sqr, enum confid_level level,
+		       const struct cpu_result *cpu,
+		       const struct fairness *fair,
 		       const struct print_options *opts);
+double xfer_stats_units(const struct xfer_stats *client,
+			const struct xfer_stats *server, unsigned int test_mode);
+double service_demand(uint64_t cpu_usec, const struct xfer_stats *client,
+		      const struct xfer_stats *server, unsigned int test_mode);
+void cpu_stats_print_thread(uint64_t client_usec, uint64_t server_usec,
+			    unsigned int id, double elapsed);
+void cpu_stats_print_system(const struct cpu_usage *client,
+			    const struct cpu_usage *server);
+
+void perf_stats_header(const char *label);
+void perf_stats_print(const struct perf_stats *stats, unsigned int id);
+void perf_stats_print_per_unit(const char *label,
+			       const struct perf_stats *stats, double units,
+			       const struct print_options *opts);
+void tcpinfo_stats_header(const char *label);
+void tcpinfo_stats_print(const struct tcpinfo_stats *stats, unsigned int id);
+void robust_stats_print(const struct robust_stats *rs, unsigned int level,
+			const struct print_options *opts);
+void connect_stats_print(double *latencies, unsigned int n,
+			 uint64_t retries, unsigned int n_retried);
 
 double mdev_n(double sum, double sum_sqr, unsigned int n);
+void fairness_add(struct fairness *fair, unsigned int id, double result);
+void fairness_finish(struct fairness *fair, double sum, double sum_sqr,
+		     unsigned int n);
+double fairness_ratio(const struct fairness *fair);
 
 #if __BYTE_ORDER == __LITTLE_ENDIAN
 static inline uint64_t ntoh64(uint64_t x)
@@ -108,6 +159,64 @@ static inline void xfer_stats_hton(const struct xfer_stats *src,
 	xfer_stats_1_hton(&src->tx, &dst->tx);
 }
 
+static inline void perf_stats_ntoh(const struct perf_stats *src,
+				   struct perf_stats *dst)
+{
+	unsigned int i;
+
+	for (i = 0; i < PERF_CNT_COUNT; i++)
+		dst->counters[i] = ntoh64(src->counters[i]);
+	dst->valid = ntohl(src->valid);
+	dst->user_only = ntohl(src->user_only);
+}
+
+static inline void perf_stats_hton(const struct perf_stats *src,
+				   struct perf_stats *dst)
+{
+	unsigned int i;
+
+	for (i = 0; i < PERF_CNT_COUNT; i++)
+		dst->counters[i] = hton64(src->counters[i]);
+	dst->valid = htonl(src->valid);
+	dst->user_only = htonl(src->user_only);
+}
+
+static inline void tcpinfo_stats_ntoh(const struct tcpinfo_stats *src,
+				      struct tcpinfo_stats *dst)
+{
+	dst->valid = ntohl(src->valid);
+	dst->srtt_usec = ntohl(src->srtt_usec);
+	dst->rttvar_usec = ntohl(src->rttvar_usec);
+	dst->cwnd = ntohl(src->cwnd);
+	dst->total_retrans = ntohl(src->total_retrans);
+	dst->_padding = 0;
+	dst->pacing_rate = ntoh64(src->pacing_rate);
+	dst->delivery_rate = ntoh64(src->delivery_rate);
+	dst->samples = ntohl(src->samples);
+	dst->srtt_max_usec = ntohl(src->srtt_max_usec);
+	dst->srtt_sum = ntoh64(src->srtt_sum);
+	dst->cwnd_sum = ntoh64(src->cwnd_sum);
+	dst->delivery_rate_sum = ntoh64(src->delivery_rate_sum);
+}
+
+static inline void tcpinfo_stats_hton(const struct tcpinfo_stats *src,
+				      struct tcpinfo_stats *dst)
+{
+	dst->valid = htonl(src->valid);
+	dst->srtt_usec = htonl(src->srtt_usec);
+	dst->rttvar_usec = htonl(src->rttvar_usec);
+	dst->cwnd = htonl(src->cwnd);
+	dst->total_retrans = htonl(src->total_retrans);
+	dst->_padding = 0;
+	dst->pacing_rate = hton64(src->pacing_rate);
+	dst->delivery_rate = hton64(src->delivery_rate);
+	dst->samples = htonl(src->samples);
+	dst->srtt_max_usec = htonl(src->srtt_max_usec);
+	dst->srtt_sum = hton64(src->srtt_sum);
+	dst->cwnd_sum = hton64(src->cwnd_sum);
+	dst->delivery_rate_sum = hton64(src->delivery_rate_sum);
+}
+
 static inline void xfer_stats_1_add(struct xfer_stats_1 *dst,
 				    const struct xfer_stats_1 *src)
 {
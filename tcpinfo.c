@@ -0,0 +1,53 @@
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+
+#include "tcpinfo.h"
+
+static int tcpinfo_read(int sd, struct tcp_info *info)
+{
+	socklen_t len = sizeof(*info);
+
+	memset(info, '\0', sizeof(*info));
+	if (getsockopt(sd, IPPROTO_TCP, TCP_INFO, info, &len) < 0)
+		return -errno;
+	return 0;
+}
+
+/* Called periodically while the test is running. */
+void tcpinfo_sample(int sd, struct tcpinfo_stats *stats)
+{
+	struct tcp_info info;
+
+	if (tcpinfo_read(sd, &info) < 0)
+		return;
+
+	stats->samples++;
+	stats->srtt_sum += info.tcpi_rtt;
+	if (info.tcpi_rtt > stats->srtt_max_usec)
+		stats->srtt_max_usec = info.tcpi_rtt;
+	stats->cwnd_sum += info.tcpi_snd_cwnd;
+	stats->delivery_rate_sum += info.tcpi_delivery_rate;
+}
+
+/* Called once at the end of the test, before the socket is closed. */
+int tcpinfo_final(int sd, struct tcpinfo_stats *stats)
+{
+	struct tcp_info info;
+	int ret;
+
+	ret = tcpinfo_read(sd, &info);
+	if (ret < 0)
+		return ret;
+
+	stats->valid = 1;
+	stats->srtt_usec = info.tcpi_rtt;
+	stats->rttvar_usec = info.tcpi_rttvar;
+	stats->cwnd = info.tcpi_snd_cwnd;
+	stats->total_retrans = info.tcpi_total_retrans;
+	stats->pacing_rate = info.tcpi_pacing_rate;
+	stats->delivery_rate = info.tcpi_delivery_rate;
+	return 0;
+}
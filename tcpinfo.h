@@ -0,0 +1,67 @@
+#ifndef __NPERF_TCPINFO_H
+#define __NPERF_TCPINFO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TCPINFO_RATE_UNLIMITED	(~(uint64_t)0)
+
+/* TCP_INFO of one connection: the values at the end of the test and
+ * aggregates of the samples taken at regular intervals while it ran
+ *
+ * all entries in network byte order (BE) when sent over control connection
+ */
+struct tcpinfo_stats {
+	/* final sample */
+	uint32_t	valid;
+	uint32_t	srtt_usec;
+	uint32_t	rttvar_usec;
+	uint32_t	cwnd;			/* segments */
+	uint32_t	total_retrans;
+	uint32_t	_padding;
+	uint64_t	pacing_rate;		/* B/s */
+	uint64_t	delivery_rate;		/* B/s */
+	/* interval samples */
+	uint32_t	samples;
+	uint32_t	srtt_max_usec;
+	uint64_t	srtt_sum;
+	uint64_t	cwnd_sum;
+	uint64_t	delivery_rate_sum;
+};
+
+void tcpinfo_sample(int sd, struct tcpinfo_stats *stats);
+int tcpinfo_final(int sd, struct tcpinfo_stats *stats);
+
+static inline void tcpinfo_stats_reset(struct tcpinfo_stats *stats)
+{
+	*stats = (struct tcpinfo_stats){};
+}
+
+/* Sum of connections: rates, windows and retransmits are summed, rtt
+ * values are summed too and divided by the number of connections when
+ * shown.
+ */
+static inline void tcpinfo_stats_add(struct tcpinfo_stats *dst,
+				     const struct tcpinfo_stats *src)
+{
+	dst->valid += src->valid;
+	dst->srtt_usec += src->srtt_usec;
+	dst->rttvar_usec += src->rttvar_usec;
+	dst->cwnd += src->cwnd;
+	dst->total_retrans += src->total_retrans;
+	if (dst->pacing_rate == TCPINFO_RATE_UNLIMITED ||
+	    src->pacing_rate == TCPINFO_RATE_UNLIMITED)
+		dst->pacing_rate = TCPINFO_RATE_UNLIMITED;
+	else
+		dst->pacing_rate += src->pacing_rate;
+	dst->delivery_rate += src->delivery_rate;
+
+	dst->samples += src->samples;
+	if (src->srtt_max_usec > dst->srtt_max_usec)
+		dst->srtt_max_usec = src->srtt_max_usec;
+	dst->srtt_sum += src->srtt_sum;
+	dst->cwnd_sum += src->cwnd_sum;
+	dst->delivery_rate_sum += src->delivery_rate_sum;
+}
+
+#endif /* __NPERF_TCPINFO_H */
@@ -0,0 +1,122 @@
+#include <string.h>
+#include <endian.h>
+#include <pthread.h>
+
+#include "verify.h"
+
+#define CRC32C_POLY	0x82f63b78	/* reflected Castagnoli polynomial */
+
+static uint32_t crc32c_table[256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+static uint32_t (*crc32c_fn)(uint32_t crc, const unsigned char *p,
+			     size_t len);
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	while (len--)
+		crc = crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *p,
+			     size_t len)
+{
+	uint64_t crc64 = crc;
+	uint64_t word;
+
+	while (len && ((uintptr_t)p & 7)) {
+		crc64 = _mm_crc32_u8(crc64, *p++);
+		len--;
+	}
+	while (len >= 8) {
+		memcpy(&word, p, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+		p += 8;
+		len -= 8;
+	}
+	while (len--)
+		crc64 = _mm_crc32_u8(crc64, *p++);
+	return crc64;
+}
+#endif
+
+static void crc32c_init(void)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < 256; i++) {
+		uint32_t crc = i;
+
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+		crc32c_table[i] = crc;
+	}
+	crc32c_fn = crc32c_sw;
+#if defined(__x86_64__)
+	if (__builtin_cpu_supports("sse4.2"))
+		crc32c_fn = crc32c_sse42;
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const void *buff, size_t len)
+{
+	pthread_once(&crc32c_once, crc32c_init);
+	return ~crc32c_fn(~crc, buff, len);
+}
+
+const char *crc32c_impl(void)
+{
+	pthread_once(&crc32c_once, crc32c_init);
+	return (crc32c_fn == crc32c_sw) ? "table" : "sse4.2";
+}
+
+/* fill buffer with pseudorandom pattern (xorshift64*) */
+void verify_fill(unsigned char *buff, unsigned long len, uint64_t seed)
+{
+	uint64_t x = seed ? seed : 1;
+	uint64_t word;
+
+	while (len > 0) {
+		unsigned long chunk = (len < sizeof(word)) ? len : sizeof(word);
+
+		x ^= x >> 12;
+		x ^= x << 25;
+		x ^= x >> 27;
+		word = x * 0x2545f4914f6cdd1dULL;
+		memcpy(buff, &word, chunk);
+		buff += chunk;
+		len -= chunk;
+	}
+}
+
+/* Store sequence number and checksum into a message about to be sent.
+ * Messages shorter than VERIFY_MIN_SIZE are not verified.
+ */
+void verify_seal(unsigned char *buff, unsigned long len, uint64_t seq)
+{
+	uint64_t be_seq = htobe64(seq);
+	uint32_t crc;
+
+	if (len < VERIFY_MIN_SIZE)
+		return;
+	memcpy(buff, &be_seq, sizeof(be_seq));
+	crc = htobe32(crc32c(0, buff, len - VERIFY_CRC_SIZE));
+	memcpy(buff + len - VERIFY_CRC_SIZE, &crc, sizeof(crc));
+}
+
+bool verify_check(const unsigned char *buff, unsigned long len, uint64_t seq)
+{
+	uint64_t be_seq;
+	uint32_t crc;
+
+	if (len < VERIFY_MIN_SIZE)
+		return true;
+	memcpy(&be_seq, buff, sizeof(be_seq));
+	memcpy(&crc, buff + len - VERIFY_CRC_SIZE, sizeof(crc));
+	return be64toh(be_seq) == seq &&
+	       be32toh(crc) == crc32c(0, buff, len - VERIFY_CRC_SIZE);
+}
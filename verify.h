@@ -0,0 +1,21 @@
+#ifndef __NPERF_VERIFY_H
+#define __NPERF_VERIFY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Verified message: 64-bit message sequence number (BE), payload and
+ * CRC32C (BE) of everything before it in the last 4 bytes.
+ */
+#define VERIFY_SEQ_SIZE		8
+#define VERIFY_CRC_SIZE		4
+#define VERIFY_MIN_SIZE		(VERIFY_SEQ_SIZE + VERIFY_CRC_SIZE)
+
+uint32_t crc32c(uint32_t crc, const void *buff, size_t len);
+const char *crc32c_impl(void);
+void verify_fill(unsigned char *buff, unsigned long len, uint64_t seed);
+void verify_seal(unsigned char *buff, unsigned long len, uint64_t seq);
+bool verify_check(const unsigned char *buff, unsigned long len, uint64_t seq);
+
+#endif /* __NPERF_VERIFY_H */